@@ -0,0 +1,362 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <addressindex.h>
+
+#include <algostats.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <init.h>
+#include <primitives/block.h>
+#include <pubkey.h>
+#include <undo.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_SPENTINDEX = 'p';
+static const char DB_BEST_BLOCK = 'B';
+
+std::unique_ptr<CAddressIndexDB> paddressindex;
+std::unique_ptr<CSpentIndexDB> pspentindex;
+
+bool GetAddressIndexKey(const CTxDestination& dest, uint8_t& type, uint160& hashBytes)
+{
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        type = ADDRESSINDEX_P2PKH;
+        hashBytes = *keyID;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        type = ADDRESSINDEX_P2SH;
+        hashBytes = *scriptID;
+        return true;
+    }
+    if (const WitnessV0KeyHash* witnessKeyHash = boost::get<WitnessV0KeyHash>(&dest)) {
+        type = ADDRESSINDEX_P2WPKH;
+        hashBytes = *witnessKeyHash;
+        return true;
+    }
+    return false;
+}
+
+bool GetAddressIndexKey(const CScript& scriptPubKey, uint8_t& type, uint160& hashBytes)
+{
+    // Fast paths for the two templates nearly every output uses
+    if (scriptPubKey.size() == 25 && scriptPubKey[0] == OP_DUP && scriptPubKey[1] == OP_HASH160 && scriptPubKey[2] == 20 &&
+        scriptPubKey[23] == OP_EQUALVERIFY && scriptPubKey[24] == OP_CHECKSIG) {
+        type = ADDRESSINDEX_P2PKH;
+        hashBytes = uint160(std::vector<unsigned char>(scriptPubKey.begin() + 3, scriptPubKey.begin() + 23));
+        return true;
+    }
+    if (scriptPubKey.IsPayToScriptHash()) {
+        type = ADDRESSINDEX_P2SH;
+        hashBytes = uint160(std::vector<unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.begin() + 22));
+        return true;
+    }
+
+    CTxDestination dest;
+    return ExtractDestination(scriptPubKey, dest) && GetAddressIndexKey(dest, type, hashBytes);
+}
+
+CTxDestination GetAddressIndexDestination(uint8_t type, const uint160& hashBytes)
+{
+    switch (type) {
+    case ADDRESSINDEX_P2PKH: return CKeyID(hashBytes);
+    case ADDRESSINDEX_P2SH: return CScriptID(hashBytes);
+    case ADDRESSINDEX_P2WPKH: return WitnessV0KeyHash(hashBytes);
+    }
+    return CNoDestination();
+}
+
+CChainIndexDB::CChainIndexDB(const std::string& strNameIn, const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+    : CDBWrapper(path, nCacheSize, fMemory, fWipe, false, GetDBOptions(strNameIn)), strName(strNameIn), pindexBest(nullptr), fSynced(false)
+{
+}
+
+bool CChainIndexDB::Init()
+{
+    AssertLockHeld(cs_main);
+    pindexBest = nullptr;
+    fSynced = false;
+
+    uint256 hashBest;
+    if (!Read(DB_BEST_BLOCK, hashBest))
+        return true;
+    BlockMap::const_iterator it = mapBlockIndex.find(hashBest);
+    if (it == mapBlockIndex.end())
+        return error("%s: %s index is built up to unknown block %s", __func__, strName, hashBest.ToString());
+    pindexBest = it->second;
+    LogPrintf("%s: %s index is built up to height %d\n", __func__, strName, pindexBest->nHeight);
+    return true;
+}
+
+bool CChainIndexDB::ConnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (pindexBest != pindex->pprev)
+        return true; // still catching up in ThreadSyncIndexes
+
+    CDBBatch batch(*this);
+    // Like ConnectBlock, the genesis block's transactions are not indexed
+    if (pindex->pprev)
+        WriteBlock(batch, block, blockundo, pindex, true);
+    batch.Write(DB_BEST_BLOCK, pindex->GetBlockHash());
+    if (!WriteBatch(batch))
+        return error("%s: failed to write %s index for block %s", __func__, strName, pindex->GetBlockHash().ToString());
+    pindexBest = pindex;
+    BlockWritten(pindex, true);
+    return true;
+}
+
+bool CChainIndexDB::DisconnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (pindexBest != pindex)
+        return true;
+
+    CDBBatch batch(*this);
+    if (pindex->pprev) {
+        WriteBlock(batch, block, blockundo, pindex, false);
+        batch.Write(DB_BEST_BLOCK, pindex->pprev->GetBlockHash());
+    } else {
+        batch.Erase(DB_BEST_BLOCK);
+    }
+    if (!WriteBatch(batch))
+        return error("%s: failed to revert %s index for block %s", __func__, strName, pindex->GetBlockHash().ToString());
+    pindexBest = pindex->pprev;
+    BlockWritten(pindex, false);
+    return true;
+}
+
+CAddressIndexDB::CAddressIndexDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CChainIndexDB("address", GetDataDir() / "indexes" / "address", nCacheSize, fMemory, fWipe)
+{
+}
+
+void CAddressIndexDB::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect)
+{
+    uint8_t type;
+    uint160 hashBytes;
+
+    // Disconnects walk the block backwards so that outputs created and spent
+    // within the block end up absent from the unspent index either way
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        const size_t i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txhash = tx.GetHash();
+
+        if (!tx.IsCoinBase()) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (unsigned int k = 0; k < tx.vin.size(); k++) {
+                const Coin& coin = txundo.vprevout[k];
+                const COutPoint& prevout = tx.vin[k].prevout;
+                if (!GetAddressIndexKey(coin.out.scriptPubKey, type, hashBytes))
+                    continue;
+                const auto keyIndex = std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hashBytes, pindex->nHeight, i, txhash, k, true));
+                const auto keyUnspent = std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hashBytes, prevout.hash, prevout.n));
+                if (fConnect) {
+                    batch.Write(keyIndex, -coin.out.nValue);
+                    batch.Erase(keyUnspent);
+                } else {
+                    batch.Erase(keyIndex);
+                    batch.Write(keyUnspent, CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight));
+                }
+            }
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& txout = tx.vout[k];
+            if (!GetAddressIndexKey(txout.scriptPubKey, type, hashBytes))
+                continue;
+            const auto keyIndex = std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hashBytes, pindex->nHeight, i, txhash, k, false));
+            const auto keyUnspent = std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hashBytes, txhash, k));
+            if (fConnect) {
+                batch.Write(keyIndex, txout.nValue);
+                batch.Write(keyUnspent, CAddressUnspentValue(txout.nValue, txout.scriptPubKey, pindex->nHeight));
+            } else {
+                batch.Erase(keyIndex);
+                batch.Erase(keyUnspent);
+            }
+        }
+    }
+}
+
+bool CAddressIndexDB::ReadAddressIndex(uint8_t type, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex, int nStart, int nEnd)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    // An all-zero tail is the smallest key of the address at that height
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hashBytes, std::max(nStart, 0), 0, uint256(), 0, false)));
+    while (pcursor->Valid()) {
+        std::pair<char, CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX || key.second.type != type || key.second.hashBytes != hashBytes)
+            break;
+        if (nEnd > 0 && key.second.nHeight > nEnd)
+            break;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("%s: failed to read address index value", __func__);
+        vAddressIndex.emplace_back(key.second, nValue);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressUnspentIndex(uint8_t type, const uint160& hashBytes, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vUnspentOutputs)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hashBytes, uint256(), 0)));
+    while (pcursor->Valid()) {
+        std::pair<char, CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX || key.second.type != type || key.second.hashBytes != hashBytes)
+            break;
+        CAddressUnspentValue value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to read address unspent index value", __func__);
+        vUnspentOutputs.emplace_back(key.second, value);
+        pcursor->Next();
+    }
+    return true;
+}
+
+CSpentIndexDB::CSpentIndexDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CChainIndexDB("spent", GetDataDir() / "indexes" / "spent", nCacheSize, fMemory, fWipe)
+{
+}
+
+void CSpentIndexDB::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect)
+{
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        for (unsigned int k = 0; k < tx.vin.size(); k++) {
+            const COutPoint& prevout = tx.vin[k].prevout;
+            const auto key = std::make_pair(DB_SPENTINDEX, CSpentIndexKey(prevout.hash, prevout.n));
+            if (!fConnect) {
+                batch.Erase(key);
+                continue;
+            }
+            const Coin& coin = txundo.vprevout[k];
+            uint8_t type = ADDRESSINDEX_NONE;
+            uint160 hashBytes;
+            if (!GetAddressIndexKey(coin.out.scriptPubKey, type, hashBytes))
+                type = ADDRESSINDEX_NONE;
+            batch.Write(key, CSpentIndexValue(tx.GetHash(), k, pindex->nHeight, coin.out.nValue, type, hashBytes));
+        }
+    }
+}
+
+bool CSpentIndexDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool IndexesConnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (paddressindex && !paddressindex->ConnectBlock(block, blockundo, pindex))
+        return false;
+    if (pspentindex && !pspentindex->ConnectBlock(block, blockundo, pindex))
+        return false;
+    if (palgostatsindex && !palgostatsindex->ConnectBlock(block, blockundo, pindex))
+        return false;
+    return true;
+}
+
+bool IndexesDisconnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (paddressindex && !paddressindex->DisconnectBlock(block, blockundo, pindex))
+        return false;
+    if (pspentindex && !pspentindex->DisconnectBlock(block, blockundo, pindex))
+        return false;
+    if (palgostatsindex && !palgostatsindex->DisconnectBlock(block, blockundo, pindex))
+        return false;
+    return true;
+}
+
+void ThreadSyncIndexes()
+{
+    RenameThread("globaltoken-idxsync");
+
+    std::vector<CChainIndexDB*> vIndexes;
+    {
+        LOCK(cs_main);
+        if (paddressindex)
+            vIndexes.push_back(paddressindex.get());
+        if (pspentindex)
+            vIndexes.push_back(pspentindex.get());
+        if (palgostatsindex)
+            vIndexes.push_back(palgostatsindex.get());
+    }
+
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    int64_t nLastLog = GetTime();
+    while (!ShutdownRequested()) {
+        // Pick the next step of the first index that is behind: revert its
+        // best block if that left the active chain, otherwise connect the
+        // following one. Indexes at the same point share the block read.
+        const CBlockIndex* pindex = nullptr;
+        bool fConnect = true;
+        bool fNeedBlockData = false;
+        {
+            LOCK(cs_main);
+            for (CChainIndexDB* pdb : vIndexes) {
+                if (pdb->IsSynced())
+                    continue;
+                const CBlockIndex* pindexBest = pdb->GetBestBlock();
+                if (pindexBest == chainActive.Tip()) {
+                    pdb->SetSynced();
+                    LogPrintf("%s: %s index is synced at height %d\n", __func__, pdb->GetName(), pindexBest ? pindexBest->nHeight : -1);
+                    continue;
+                }
+                if (!pindex) {
+                    fConnect = !pindexBest || chainActive.Contains(pindexBest);
+                    pindex = fConnect ? (pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis()) : pindexBest;
+                }
+                if (pindexBest == (fConnect ? pindex->pprev : pindex) && pdb->NeedsBlockData())
+                    fNeedBlockData = true;
+            }
+        }
+        if (!pindex)
+            break;
+
+        // Header-only indexes are built from the block index alone
+        CBlock block;
+        CBlockUndo blockundo;
+        if (fNeedBlockData && (!ReadBlockFromDisk(block, pindex, consensusParams, false) || (pindex->pprev && !UndoReadFromDisk(blockundo, pindex)))) {
+            LogPrintf("%s: failed to read block %s, index sync stopped\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+
+        {
+            LOCK(cs_main);
+            for (CChainIndexDB* pdb : vIndexes) {
+                if (pdb->IsSynced() || (pdb->NeedsBlockData() && !fNeedBlockData))
+                    continue;
+                bool fOk = true;
+                if (fConnect && pdb->GetBestBlock() == pindex->pprev && chainActive.Contains(pindex)) {
+                    fOk = pdb->ConnectBlock(block, blockundo, pindex);
+                } else if (!fConnect && pdb->GetBestBlock() == pindex && !chainActive.Contains(pindex)) {
+                    fOk = pdb->DisconnectBlock(block, blockundo, pindex);
+                }
+                if (!fOk) {
+                    LogPrintf("%s: failed to update the %s index, index sync stopped\n", __func__, pdb->GetName());
+                    return;
+                }
+            }
+        }
+
+        if (GetTime() >= nLastLog + 60) {
+            nLastLog = GetTime();
+            LogPrintf("Building indexes. At block %d\n", pindex->nHeight);
+        }
+    }
+}
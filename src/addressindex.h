@@ -0,0 +1,267 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <dbwrapper.h>
+#include <fs.h>
+#include <script/script.h>
+#include <script/standard.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+//! -addressindex default
+static const bool DEFAULT_ADDRESSINDEX = false;
+//! -spentindex default
+static const bool DEFAULT_SPENTINDEX = false;
+//! Max memory allocated to each of the address and spent index databases (MiB)
+static const int64_t nMaxIndexDBCache = 256;
+
+/** Kinds of destinations the address index knows about */
+enum AddressIndexType : uint8_t {
+    ADDRESSINDEX_NONE = 0,
+    ADDRESSINDEX_P2PKH = 1, //!< also used for pay-to-pubkey outputs
+    ADDRESSINDEX_P2SH = 2,
+    ADDRESSINDEX_P2WPKH = 3,
+};
+
+/** Map a scriptPubKey to the (type, hash) pair it is indexed under. Returns false if it is not indexed. */
+bool GetAddressIndexKey(const CScript& scriptPubKey, uint8_t& type, uint160& hashBytes);
+/** Map a destination to the (type, hash) pair it is indexed under. Returns false if it is not indexed. */
+bool GetAddressIndexKey(const CTxDestination& dest, uint8_t& type, uint160& hashBytes);
+/** Inverse of GetAddressIndexKey */
+CTxDestination GetAddressIndexDestination(uint8_t type, const uint160& hashBytes);
+
+/**
+ * Address index entry: a credit (output) or debit (input) of an address. Keys
+ * sort by address and then by height and position in the block, so that the
+ * history of an address is one contiguous range of the database.
+ */
+struct CAddressIndexKey
+{
+    uint8_t type;
+    uint160 hashBytes;
+    int nHeight;
+    unsigned int nTxIndex;
+    uint256 txhash;
+    unsigned int index;
+    bool fSpending;
+
+    CAddressIndexKey() : type(ADDRESSINDEX_NONE), nHeight(0), nTxIndex(0), index(0), fSpending(false) {}
+    CAddressIndexKey(uint8_t typeIn, const uint160& hashBytesIn, int nHeightIn, unsigned int nTxIndexIn, const uint256& txhashIn, unsigned int indexIn, bool fSpendingIn)
+        : type(typeIn), hashBytes(hashBytesIn), nHeight(nHeightIn), nTxIndex(nTxIndexIn), txhash(txhashIn), index(indexIn), fSpending(fSpendingIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ::Serialize(s, type);
+        hashBytes.Serialize(s);
+        // Heights and positions are big endian so that they sort numerically
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxIndex);
+        txhash.Serialize(s);
+        ser_writedata32be(s, index);
+        ::Serialize(s, fSpending);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        ::Unserialize(s, type);
+        hashBytes.Unserialize(s);
+        nHeight = ser_readdata32be(s);
+        nTxIndex = ser_readdata32be(s);
+        txhash.Unserialize(s);
+        index = ser_readdata32be(s);
+        ::Unserialize(s, fSpending);
+    }
+};
+
+/** Address unspent index entry: an output of an address that is still unspent */
+struct CAddressUnspentKey
+{
+    uint8_t type;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int index;
+
+    CAddressUnspentKey() : type(ADDRESSINDEX_NONE), index(0) {}
+    CAddressUnspentKey(uint8_t typeIn, const uint160& hashBytesIn, const uint256& txhashIn, unsigned int indexIn)
+        : type(typeIn), hashBytes(hashBytesIn), txhash(txhashIn), index(indexIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ::Serialize(s, type);
+        hashBytes.Serialize(s);
+        txhash.Serialize(s);
+        ser_writedata32be(s, index);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        ::Unserialize(s, type);
+        hashBytes.Unserialize(s);
+        txhash.Unserialize(s);
+        index = ser_readdata32be(s);
+    }
+};
+
+struct CAddressUnspentValue
+{
+    CAmount nValue;
+    CScript script;
+    int nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nValue);
+        READWRITE(*(CScriptBase*)(&script));
+        READWRITE(nHeight);
+    }
+
+    CAddressUnspentValue() : nValue(-1), nHeight(-1) {}
+    CAddressUnspentValue(CAmount nValueIn, const CScript& scriptIn, int nHeightIn) : nValue(nValueIn), script(scriptIn), nHeight(nHeightIn) {}
+};
+
+/** Spent index entry: which input spends an outpoint */
+struct CSpentIndexKey
+{
+    uint256 txid;
+    unsigned int index;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(index);
+    }
+
+    CSpentIndexKey() : index(0) {}
+    CSpentIndexKey(const uint256& txidIn, unsigned int indexIn) : txid(txidIn), index(indexIn) {}
+};
+
+struct CSpentIndexValue
+{
+    uint256 txid;
+    unsigned int inputIndex;
+    int nHeight;
+    CAmount nValue;
+    uint8_t addressType;
+    uint160 addressHash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(inputIndex);
+        READWRITE(nHeight);
+        READWRITE(nValue);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+
+    CSpentIndexValue() : inputIndex(0), nHeight(-1), nValue(-1), addressType(ADDRESSINDEX_NONE) {}
+    CSpentIndexValue(const uint256& txidIn, unsigned int inputIndexIn, int nHeightIn, CAmount nValueIn, uint8_t addressTypeIn, const uint160& addressHashIn)
+        : txid(txidIn), inputIndex(inputIndexIn), nHeight(nHeightIn), nValue(nValueIn), addressType(addressTypeIn), addressHash(addressHashIn) {}
+};
+
+/**
+ * Base of the optional chain indexes. Each one lives in its own database and
+ * records the block it has been built up to, so it can be enabled on an
+ * existing datadir and catch up with the active chain in the background
+ * (ThreadSyncIndexes) while ConnectBlock/DisconnectTip keep it current once
+ * it has reached the tip.
+ */
+class CChainIndexDB : public CDBWrapper
+{
+public:
+    CChainIndexDB(const std::string& strNameIn, const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe);
+    virtual ~CChainIndexDB() {}
+
+    const std::string& GetName() const { return strName; }
+
+    /** Look up the block the database was built up to. Requires cs_main. */
+    bool Init();
+
+    /** Apply a block connected on top of the index's best block. Requires cs_main. */
+    bool ConnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+    /** Revert the index's best block. Requires cs_main. */
+    bool DisconnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+    /** Block the index has been built up to (nullptr if empty). Requires cs_main. */
+    const CBlockIndex* GetBestBlock() const { return pindexBest; }
+    /** Whether the index has caught up with the active chain */
+    bool IsSynced() const { return fSynced; }
+    void SetSynced() { fSynced = true; }
+
+    /** Whether WriteBlock looks at the transactions of a block, or only at its header */
+    virtual bool NeedsBlockData() const { return true; }
+
+protected:
+    /** Add the entries of a block to (fConnect) or remove them from the batch */
+    virtual void WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect) = 0;
+    /** Called once the batch built by WriteBlock has been written */
+    virtual void BlockWritten(const CBlockIndex* pindex, bool fConnect) {}
+
+private:
+    const std::string strName;
+    const CBlockIndex* pindexBest;
+    std::atomic<bool> fSynced;
+};
+
+/** Access to the address index database (indexes/address/) */
+class CAddressIndexDB : public CChainIndexDB
+{
+public:
+    explicit CAddressIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** History of an address, optionally restricted to blocks nStart..nEnd (0 = unbounded) */
+    bool ReadAddressIndex(uint8_t type, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex, int nStart = 0, int nEnd = 0);
+    /** Unspent outputs of an address */
+    bool ReadAddressUnspentIndex(uint8_t type, const uint160& hashBytes, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vUnspentOutputs);
+
+protected:
+    void WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect) override;
+};
+
+/** Access to the spent index database (indexes/spent/) */
+class CSpentIndexDB : public CChainIndexDB
+{
+public:
+    explicit CSpentIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+
+protected:
+    void WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect) override;
+};
+
+/** Global variable that points to the address index database (protected by cs_main) */
+extern std::unique_ptr<CAddressIndexDB> paddressindex;
+/** Global variable that points to the spent index database (protected by cs_main) */
+extern std::unique_ptr<CSpentIndexDB> pspentindex;
+
+/** Feed a block connected to the active chain to the enabled indexes. Requires cs_main. */
+bool IndexesConnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Feed a block disconnected from the active chain to the enabled indexes. Requires cs_main. */
+bool IndexesDisconnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+/** Build the enabled indexes up to the active chain tip from block and undo data */
+void ThreadSyncIndexes();
+
+#endif // BITCOIN_ADDRESSINDEX_H
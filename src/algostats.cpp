@@ -0,0 +1,138 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algostats.h>
+
+#include <chain.h>
+#include <util.h>
+
+static const char DB_ALGOSTATS = 'h';
+static const char DB_ALGOSTATS_TOTALS = 'T';
+static const char DB_ALGOSTATS_TIP = 'H';
+
+std::unique_ptr<CAlgoStatsIndexDB> palgostatsindex;
+
+namespace {
+
+/** Heights are stored big endian so that records sort in chain order */
+struct CAlgoStatsHeightKey
+{
+    int nHeight;
+
+    explicit CAlgoStatsHeightKey(int nHeightIn = 0) : nHeight(nHeightIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata32be(s, nHeight);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        nHeight = ser_readdata32be(s);
+    }
+};
+
+} // namespace
+
+CAlgoStatsIndexDB::CAlgoStatsIndexDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CChainIndexDB("algostats", GetDataDir() / "indexes" / "algostats", nCacheSize, fMemory, fWipe), nBestHeight(-1)
+{
+    // Written in the same batch as the best block, so always consistent with it
+    std::pair<int, uint256> tip;
+    if (!Read(DB_ALGOSTATS_TOTALS, vTotals) || !Read(DB_ALGOSTATS_TIP, tip)) {
+        vTotals.clear();
+    } else {
+        nBestHeight = tip.first;
+        hashBest = tip.second;
+    }
+    vTotals.resize(NUM_ALGOS_IMPL);
+}
+
+void CAlgoStatsIndexDB::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect)
+{
+    // vTotals is only modified with cs_main held, which the caller has
+    vPendingTotals = vTotals;
+    const uint8_t nAlgo = pindex->GetAlgo();
+    if (nAlgo >= vPendingTotals.size())
+        vPendingTotals.resize(nAlgo + 1);
+    CAlgoStatsTotals& totals = vPendingTotals[nAlgo];
+    const bool fAuxpow = CPureBlockVersion(pindex->nVersion).IsAuxpow();
+
+    if (fConnect) {
+        CAlgoStatsEntry entry;
+        entry.nAlgo = nAlgo;
+        entry.fAuxpow = fAuxpow;
+        entry.nBits = pindex->nBits;
+        entry.nTime = pindex->nTime;
+        entry.nPrevAlgoHeight = totals.nLastHeight;
+        entry.nTimeDelta = totals.nLastHeight >= 0 ? (int64_t)pindex->nTime - totals.nLastTime : 0;
+        batch.Write(std::make_pair(DB_ALGOSTATS, CAlgoStatsHeightKey(pindex->nHeight)), entry);
+
+        totals.nBlocks++;
+        if (fAuxpow)
+            totals.nAuxpowBlocks++;
+        totals.nLastHeight = pindex->nHeight;
+        totals.nLastBits = pindex->nBits;
+        totals.nLastTime = pindex->nTime;
+        batch.Write(DB_ALGOSTATS_TIP, std::make_pair(pindex->nHeight, pindex->GetBlockHash()));
+    } else {
+        // The block's own record links to the previous block of its algo,
+        // whose target and time are still in the block index
+        CAlgoStatsEntry entry;
+        if (!Read(std::make_pair(DB_ALGOSTATS, CAlgoStatsHeightKey(pindex->nHeight)), entry)) {
+            LogPrintf("%s: no algo stats record for block %s at height %d\n", __func__, pindex->GetBlockHash().ToString(), pindex->nHeight);
+            entry.nPrevAlgoHeight = -1;
+        }
+        batch.Erase(std::make_pair(DB_ALGOSTATS, CAlgoStatsHeightKey(pindex->nHeight)));
+
+        if (totals.nBlocks > 0)
+            totals.nBlocks--;
+        if (fAuxpow && totals.nAuxpowBlocks > 0)
+            totals.nAuxpowBlocks--;
+        const CBlockIndex* pindexPrevAlgo = entry.nPrevAlgoHeight >= 0 ? pindex->GetAncestor(entry.nPrevAlgoHeight) : nullptr;
+        totals.nLastHeight = pindexPrevAlgo ? pindexPrevAlgo->nHeight : -1;
+        totals.nLastBits = pindexPrevAlgo ? pindexPrevAlgo->nBits : 0;
+        totals.nLastTime = pindexPrevAlgo ? pindexPrevAlgo->nTime : 0;
+        batch.Write(DB_ALGOSTATS_TIP, std::make_pair(pindex->pprev->nHeight, pindex->pprev->GetBlockHash()));
+    }
+    batch.Write(DB_ALGOSTATS_TOTALS, vPendingTotals);
+}
+
+void CAlgoStatsIndexDB::BlockWritten(const CBlockIndex* pindex, bool fConnect)
+{
+    LOCK(cs_totals);
+    // The genesis block is not passed to WriteBlock and leaves the totals as they are
+    if (!vPendingTotals.empty())
+        vTotals.swap(vPendingTotals);
+    vPendingTotals.clear();
+    const CBlockIndex* pindexTip = fConnect ? pindex : pindex->pprev;
+    nBestHeight = pindexTip ? pindexTip->nHeight : -1;
+    hashBest = pindexTip ? pindexTip->GetBlockHash() : uint256();
+}
+
+void CAlgoStatsIndexDB::GetTotals(std::vector<CAlgoStatsTotals>& vTotalsOut, int& nHeightOut, uint256& hashOut) const
+{
+    LOCK(cs_totals);
+    vTotalsOut = vTotals;
+    nHeightOut = nBestHeight;
+    hashOut = hashBest;
+}
+
+bool CAlgoStatsIndexDB::ReadRange(int nStart, int nEnd, std::vector<std::pair<int, CAlgoStatsEntry> >& vEntries)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_ALGOSTATS, CAlgoStatsHeightKey(std::max(nStart, 0))));
+    while (pcursor->Valid()) {
+        std::pair<char, CAlgoStatsHeightKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ALGOSTATS || key.second.nHeight > nEnd)
+            break;
+        CAlgoStatsEntry entry;
+        if (!pcursor->GetValue(entry))
+            return error("%s: failed to read algo stats record", __func__);
+        vEntries.emplace_back(key.second.nHeight, entry);
+        pcursor->Next();
+    }
+    return true;
+}
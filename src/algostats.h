@@ -0,0 +1,113 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ALGOSTATS_H
+#define BITCOIN_ALGOSTATS_H
+
+#include <addressindex.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <globaltoken/powalgorithm.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! -algostatsindex default
+static const bool DEFAULT_ALGOSTATSINDEX = false;
+//! Number of blocks getalgostats aggregates over by default
+static const int DEFAULT_ALGOSTATS_WINDOW = 120;
+//! Max memory allocated to the algo stats database (MiB)
+static const int64_t nMaxAlgoStatsDBCache = 16;
+
+/** Per-block record of the algo stats index, keyed by height */
+struct CAlgoStatsEntry
+{
+    uint8_t nAlgo;
+    bool fAuxpow;
+    uint32_t nBits;
+    uint32_t nTime;
+    //! Height of the previous block of the same algo (-1 if none)
+    int nPrevAlgoHeight;
+    //! Seconds since the previous block of the same algo (0 if none)
+    int64_t nTimeDelta;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nAlgo);
+        READWRITE(fAuxpow);
+        READWRITE(nBits);
+        READWRITE(nTime);
+        READWRITE(nPrevAlgoHeight);
+        READWRITE(nTimeDelta);
+    }
+
+    CAlgoStatsEntry() : nAlgo(0), fAuxpow(false), nBits(0), nTime(0), nPrevAlgoHeight(-1), nTimeDelta(0) {}
+};
+
+/** Totals of one algo over the whole active chain, kept in memory for the tip */
+struct CAlgoStatsTotals
+{
+    uint32_t nBlocks;
+    uint32_t nAuxpowBlocks;
+    int nLastHeight;
+    uint32_t nLastBits;
+    uint32_t nLastTime;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nBlocks);
+        READWRITE(nAuxpowBlocks);
+        READWRITE(nLastHeight);
+        READWRITE(nLastBits);
+        READWRITE(nLastTime);
+    }
+
+    CAlgoStatsTotals() : nBlocks(0), nAuxpowBlocks(0), nLastHeight(-1), nLastBits(0), nLastTime(0) {}
+};
+
+/**
+ * Access to the algo stats index database (indexes/algostats/). It stores the
+ * algo, target, time and auxpow flag of every block of the active chain, each
+ * linked to the previous block of the same algo, plus running per-algo totals.
+ *
+ * Readers do not need cs_main: the totals are guarded by their own lock and
+ * range queries run on a consistent database snapshot.
+ */
+class CAlgoStatsIndexDB : public CChainIndexDB
+{
+public:
+    explicit CAlgoStatsIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool NeedsBlockData() const override { return false; }
+
+    /** Per-algo totals and the height and hash of the block they are valid at */
+    void GetTotals(std::vector<CAlgoStatsTotals>& vTotalsOut, int& nHeightOut, uint256& hashOut) const;
+    /** Records of blocks nStart..nEnd, in height order */
+    bool ReadRange(int nStart, int nEnd, std::vector<std::pair<int, CAlgoStatsEntry> >& vEntries);
+
+protected:
+    void WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect) override;
+    void BlockWritten(const CBlockIndex* pindex, bool fConnect) override;
+
+private:
+    mutable CCriticalSection cs_totals;
+    //! Totals at nBestHeight (guarded by cs_totals, written with cs_main held as well)
+    std::vector<CAlgoStatsTotals> vTotals;
+    int nBestHeight;
+    uint256 hashBest;
+    //! Totals after the block being written, swapped in by BlockWritten (cs_main)
+    std::vector<CAlgoStatsTotals> vPendingTotals;
+};
+
+/** Global variable that points to the algo stats index database */
+extern std::unique_ptr<CAlgoStatsIndexDB> palgostatsindex;
+
+#endif // BITCOIN_ALGOSTATS_H
@@ -94,6 +94,18 @@ base_uint<BITS>& base_uint<BITS>::operator/=(const base_uint& b)
         throw uint_error("Division by zero");
     if (div_bits > num_bits) // the result is certainly 0.
         return *this;
+    if (div_bits <= 32) {
+        // Single limb divisor, as in the per-algo retarget steps: divide limb by
+        // limb from the top, carrying the remainder. Same result, far fewer steps.
+        const uint64_t d = div.pn[0];
+        uint64_t rem = 0;
+        for (int i = WIDTH - 1; i >= 0; i--) {
+            const uint64_t cur = (rem << 32) | num.pn[i];
+            pn[i] = (uint32_t)(cur / d);
+            rem = cur % d;
+        }
+        return *this;
+    }
     int shift = num_bits - div_bits;
     div <<= shift; // shift so that div and num align.
     while (shift >= 0) {
@@ -44,6 +44,50 @@ void benchmark::ConsolePrinter::result(const State& state)
 }
 
 void benchmark::ConsolePrinter::footer() {}
+
+void benchmark::JsonPrinter::header()
+{
+    std::cout << "[" << std::endl;
+}
+
+void benchmark::JsonPrinter::result(const State& state)
+{
+    auto results = state.m_elapsed_results;
+    std::sort(results.begin(), results.end());
+
+    double median = 0;
+    if (!results.empty()) {
+        size_t mid = results.size() / 2;
+        median = results[mid];
+        if (0 == results.size() % 2) {
+            median = (results[mid - 1] + results[mid]) / 2;
+        }
+    }
+
+    // Times are seconds per iteration; benchmark names are plain identifiers
+    std::cout << std::setprecision(6)
+              << (m_first ? "" : ",\n")
+              << "{\"name\": \"" << state.m_name << "\", \"evals\": " << state.m_num_evals
+              << ", \"iterations\": " << state.m_num_iters
+              << ", \"total\": " << state.m_num_iters * std::accumulate(results.begin(), results.end(), 0.0)
+              << ", \"min\": " << (results.empty() ? 0 : results.front())
+              << ", \"max\": " << (results.empty() ? 0 : results.back())
+              << ", \"median\": " << median
+              << ", \"results\": [";
+    const char* prefix = "";
+    for (const auto& e : state.m_elapsed_results) {
+        std::cout << prefix << e;
+        prefix = ", ";
+    }
+    std::cout << "]}";
+    m_first = false;
+}
+
+void benchmark::JsonPrinter::footer()
+{
+    std::cout << std::endl << "]" << std::endl;
+}
+
 benchmark::PlotlyPrinter::PlotlyPrinter(std::string plotly_url, int64_t width, int64_t height)
     : m_plotly_url(plotly_url), m_width(width), m_height(height)
 {
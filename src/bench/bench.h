@@ -116,6 +116,19 @@ public:
     void footer();
 };
 
+// prints one JSON object per benchmark, for tracking results across builds
+class JsonPrinter : public Printer
+{
+public:
+    JsonPrinter() : m_first(true) {}
+    void header();
+    void result(const State& state);
+    void footer();
+
+private:
+    bool m_first;
+};
+
 // creates box plot with plotly.js
 class PlotlyPrinter : public Printer
 {
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <blockencodings.h>
+#include <consensus/merkle.h>
+#include <streams.h>
+#include <txmempool.h>
+
+// Compact block relay of a merge-mined Equihash block, as sent in reply to a
+// MSG_CMPCT_BLOCK request that followed a headers announcement. With the
+// omitted header data the cmpctblock shrinks by the solution and the auxpow
+// (see OmittedHeaderDataRoundTripTest for the exact byte count).
+
+static const size_t BENCH_BLOCK_TXS = 500;
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool)
+{
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000, 0, 1, false, 4, lp));
+}
+
+static CBlock BuildAuxpowBlock(CTxMemPool& pool)
+{
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    block.vtx.push_back(MakeTransactionRef(tx));
+
+    for (size_t i = 1; i < BENCH_BLOCK_TXS; i++) {
+        tx.vin[0].prevout = COutPoint(block.vtx[i - 1]->GetHash(), 0);
+        block.vtx.push_back(MakeTransactionRef(tx));
+        AddTx(block.vtx.back(), pool);
+    }
+
+    block.SetAlgo(ALGO_EQUIHASH);
+    block.nBits = 0x207fffff;
+    block.nSolution.assign(1344, 0x5a);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    CAuxPow::initAuxPow(block, AUXPOW_EQUIHASH_FLAG);
+    return block;
+}
+
+static void CompactBlockReconstruct(benchmark::State& state, bool fOmitHeaderData)
+{
+    CTxMemPool pool;
+    const CBlock block = BuildAuxpowBlock(pool);
+    const std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+
+    CBlockHeaderAndShortTxIDs cmpctblock(block, true);
+    if (fOmitHeaderData)
+        cmpctblock.OmitKnownHeaderData();
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << cmpctblock;
+    const size_t nSize = stream.size();
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+
+    while (state.KeepRunning()) {
+        CBlockHeaderAndShortTxIDs received;
+        stream >> received;
+        assert(stream.Rewind(nSize));
+        if (fOmitHeaderData)
+            assert(received.FillOmittedHeaderData(&block.nSolution, block.auxpow) == READ_STATUS_OK);
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        assert(partialBlock.InitData(received, extra_txn) == READ_STATUS_OK);
+    }
+}
+
+static void CompactBlockAuxpowFullHeader(benchmark::State& state)
+{
+    CompactBlockReconstruct(state, false);
+}
+
+static void CompactBlockAuxpowOmittedHeader(benchmark::State& state)
+{
+    CompactBlockReconstruct(state, true);
+}
+
+BENCHMARK(CompactBlockAuxpowFullHeader, 150);
+BENCHMARK(CompactBlockAuxpowOmittedHeader, 150);
@@ -0,0 +1,125 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <dbwrapper.h>
+#include <fs.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <assert.h>
+#include <memory>
+#include <vector>
+
+// Random coin reads and a block index scan on LevelDB databases opened with
+// the upstream options (Default) and with the built-in profile of the
+// database (Tuned), which -dbopts on the bench command line can change, e.g.
+// bench_globaltoken -filter=BlockIndexScan.* -dbopts=index:blocksize=65536
+
+static const int BENCH_DB_COINS = 100000;
+static const int BENCH_DB_BLOCK_INDEX = 20000;
+static const size_t BENCH_DB_CACHE = 8 << 20;
+
+namespace {
+
+/** A database in a temporary directory that is removed afterwards */
+class BenchDB
+{
+public:
+    explicit BenchDB(const CDBOptions& dbopts)
+        : path(fs::temp_directory_path() / fs::unique_path("globaltoken_bench_db_%%%%%%%%")),
+          db(new CDBWrapper(path, BENCH_DB_CACHE, false, true, false, dbopts)) {}
+
+    ~BenchDB()
+    {
+        db.reset();
+        fs::remove_all(path);
+    }
+
+    CDBWrapper& operator*() { return *db; }
+    CDBWrapper* operator->() { return db.get(); }
+
+private:
+    fs::path path;
+    std::unique_ptr<CDBWrapper> db;
+};
+
+void CoinsDBRead(benchmark::State& state, const CDBOptions& dbopts)
+{
+    BenchDB db(dbopts);
+    FastRandomContext rng(true);
+    std::vector<COutPoint> vOutpoints;
+    vOutpoints.reserve(BENCH_DB_COINS);
+    CDBBatch batch(*db);
+    for (int i = 0; i < BENCH_DB_COINS; i++) {
+        vOutpoints.emplace_back(rng.rand256(), rng.randrange(4));
+        Coin coin;
+        coin.out.nValue = rng.randrange(100000000);
+        coin.out.scriptPubKey.assign(25, (unsigned char)i);
+        coin.nHeight = i;
+        batch.Write(std::make_pair('C', vOutpoints.back()), coin);
+        if (batch.SizeEstimate() > (1 << 20)) {
+            db->WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    db->WriteBatch(batch);
+
+    // Every other read is of a coin that does not exist, which the bloom
+    // filter answers without reading a block
+    uint64_t n = 0;
+    while (state.KeepRunning()) {
+        Coin coin;
+        if (n++ & 1)
+            db->Read(std::make_pair('C', COutPoint(rng.rand256(), 0)), coin);
+        else
+            db->Read(std::make_pair('C', vOutpoints[rng.randrange(vOutpoints.size())]), coin);
+    }
+}
+
+void BlockIndexScan(benchmark::State& state, const CDBOptions& dbopts)
+{
+    BenchDB db(dbopts);
+    FastRandomContext rng(true);
+    CDBBatch batch(*db);
+    for (int i = 0; i < BENCH_DB_BLOCK_INDEX; i++) {
+        // Sized like block index entries: one in three carries the 1344
+        // byte nSolution of an equihash header
+        std::vector<unsigned char> value(i % 3 ? 90 : 90 + 1344);
+        for (unsigned char& c : value)
+            c = rng.randbits(8);
+        batch.Write(std::make_pair('b', rng.rand256()), value);
+        if (batch.SizeEstimate() > (1 << 20)) {
+            db->WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    db->WriteBatch(batch);
+
+    while (state.KeepRunning()) {
+        std::unique_ptr<CDBIterator> pcursor(db->NewIterator());
+        int nEntries = 0;
+        for (pcursor->Seek(std::make_pair('b', uint256())); pcursor->Valid(); pcursor->Next()) {
+            std::pair<char, uint256> key;
+            std::vector<unsigned char> value;
+            if (!pcursor->GetKey(key) || key.first != 'b' || !pcursor->GetValue(value))
+                break;
+            nEntries++;
+        }
+        assert(nEntries == BENCH_DB_BLOCK_INDEX);
+    }
+}
+
+} // namespace
+
+static void CoinsDBRead_Default(benchmark::State& state) { CoinsDBRead(state, CDBOptions()); }
+static void CoinsDBRead_Tuned(benchmark::State& state) { CoinsDBRead(state, GetDBOptions("chainstate")); }
+static void BlockIndexScan_Default(benchmark::State& state) { BlockIndexScan(state, CDBOptions()); }
+static void BlockIndexScan_Tuned(benchmark::State& state) { BlockIndexScan(state, GetDBOptions("index")); }
+
+BENCHMARK(CoinsDBRead_Default, 200000);
+BENCHMARK(CoinsDBRead_Tuned, 200000);
+BENCHMARK(BlockIndexScan_Default, 50);
+BENCHMARK(BlockIndexScan_Tuned, 50);
@@ -0,0 +1,307 @@
+// Copyright (c) 2019 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <auxpow.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <crypto/algos/equihash/equihash.h>
+#include <globaltoken/multihasher.h>
+#include <globaltoken/powalgorithm.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <script/script.h>
+#include <streams.h>
+
+#include <sodium.h>
+
+#include <assert.h>
+
+// Proof of work costs per algorithm, in the shape validation sees them:
+// hashing a block header, checking an auxpow, checking an Equihash
+// solution and computing chain work / next target on a 60-algo chain.
+// Run with -printer=json to compare builds.
+
+/** A header of the given algo, serialized as 80 bytes or as 140 bytes plus solution for Equihash based algos */
+static CBlockHeader SyntheticHeader(const CChainParams& chainParams, uint8_t nAlgo)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.SetAlgo(nAlgo);
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    header.nTime = chainParams.GetConsensus().Hardfork3.GetActivationTime() + 600;
+    header.nBits = chainParams.GetConsensus().aPOWAlgos[nAlgo].GetArithPowLimit().GetCompact();
+    header.nNonce = GetRand(std::numeric_limits<uint32_t>::max());
+    if (IsEquihashBasedAlgo(nAlgo)) {
+        header.nBigNonce = GetRandHash();
+        header.nSolution.resize(chainParams.EquihashSolutionWidth(nAlgo));
+        GetRandBytes(header.nSolution.data(), header.nSolution.size());
+    }
+    return header;
+}
+
+static void HashHeader(benchmark::State& state, uint8_t nAlgo)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    CBlockHeader header = SyntheticHeader(*chainParams, nAlgo);
+    const int nHashVersion = LoadMultiHasherVersionFlags(true);
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetPoWHash(nAlgo, SER_GETHASH, nHashVersion);
+    }
+}
+
+// Iterations are chosen so that each benchmark takes roughly a second
+#define POW_ALGO_BENCHMARK(algo, iters) \
+    static void PoWHash_##algo(benchmark::State& state) { HashHeader(state, ALGO_##algo); } \
+    BENCHMARK(PoWHash_##algo, iters);
+
+POW_ALGO_BENCHMARK(SHA256D, 400000)
+POW_ALGO_BENCHMARK(SCRYPT, 2000)
+POW_ALGO_BENCHMARK(X11, 30000)
+POW_ALGO_BENCHMARK(NEOSCRYPT, 2000)
+POW_ALGO_BENCHMARK(EQUIHASH, 30000)
+POW_ALGO_BENCHMARK(YESCRYPT, 500)
+POW_ALGO_BENCHMARK(HMQ1725, 10000)
+POW_ALGO_BENCHMARK(XEVAN, 6000)
+POW_ALGO_BENCHMARK(NIST5, 100000)
+POW_ALGO_BENCHMARK(TIMETRAVEL10, 30000)
+POW_ALGO_BENCHMARK(PAWELHASH, 20000)
+POW_ALGO_BENCHMARK(X13, 30000)
+POW_ALGO_BENCHMARK(X14, 30000)
+POW_ALGO_BENCHMARK(X15, 20000)
+POW_ALGO_BENCHMARK(X17, 20000)
+POW_ALGO_BENCHMARK(LYRA2REV2, 60000)
+POW_ALGO_BENCHMARK(BLAKE2S, 1000000)
+POW_ALGO_BENCHMARK(BLAKE2B, 1000000)
+POW_ALGO_BENCHMARK(ASTRALHASH, 30000)
+POW_ALGO_BENCHMARK(PADIHASH, 20000)
+POW_ALGO_BENCHMARK(JEONGHASH, 20000)
+POW_ALGO_BENCHMARK(KECCAKC, 1000000)
+POW_ALGO_BENCHMARK(ZHASH, 200000)
+POW_ALGO_BENCHMARK(GLOBALHASH, 100000)
+POW_ALGO_BENCHMARK(SKEIN, 400000)
+POW_ALGO_BENCHMARK(GROESTL, 200000)
+POW_ALGO_BENCHMARK(QUBIT, 50000)
+POW_ALGO_BENCHMARK(SKUNKHASH, 50000)
+POW_ALGO_BENCHMARK(QUARK, 70000)
+POW_ALGO_BENCHMARK(X16R, 30000)
+POW_ALGO_BENCHMARK(LYRA2REV3, 100000)
+POW_ALGO_BENCHMARK(YESCRYPT_R16V2, 30)
+POW_ALGO_BENCHMARK(YESCRYPT_R24, 70)
+POW_ALGO_BENCHMARK(YESCRYPT_R8, 50)
+POW_ALGO_BENCHMARK(YESCRYPT_R32, 60)
+POW_ALGO_BENCHMARK(X25X, 9000)
+POW_ALGO_BENCHMARK(ARGON2D, 1000)
+POW_ALGO_BENCHMARK(ARGON2I, 1000)
+POW_ALGO_BENCHMARK(CPU23R, 10000)
+POW_ALGO_BENCHMARK(YESPOWER, 100)
+POW_ALGO_BENCHMARK(X21S, 20000)
+POW_ALGO_BENCHMARK(X16S, 20000)
+POW_ALGO_BENCHMARK(X22I, 20000)
+POW_ALGO_BENCHMARK(LYRA2Z, 40000)
+POW_ALGO_BENCHMARK(HONEYCOMB, 50000)
+POW_ALGO_BENCHMARK(EH192, 80000)
+POW_ALGO_BENCHMARK(MARS, 200000)
+POW_ALGO_BENCHMARK(X12, 30000)
+POW_ALGO_BENCHMARK(HEX, 20000)
+POW_ALGO_BENCHMARK(DEDAL, 20000)
+POW_ALGO_BENCHMARK(C11, 30000)
+POW_ALGO_BENCHMARK(PHI1612, 40000)
+POW_ALGO_BENCHMARK(PHI2, 30000)
+POW_ALGO_BENCHMARK(X16RT, 20000)
+POW_ALGO_BENCHMARK(TRIBUS, 90000)
+POW_ALGO_BENCHMARK(ALLIUM, 30000)
+POW_ALGO_BENCHMARK(ARCTICHASH, 9000)
+POW_ALGO_BENCHMARK(DESERTHASH, 10000)
+POW_ALGO_BENCHMARK(CRYPTOANDCOFFEE, 9000)
+POW_ALGO_BENCHMARK(RICKHASH, 10000)
+
+static_assert(NUM_ALGOS_IMPL == 60, "add a PoWHash benchmark for the new algorithm");
+
+/** Nonce scan as done by the miner, compare with PoWHash_<ALGO> */
+static void ScanNonces(benchmark::State& state, uint8_t nAlgo)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const CBlockHeader header = SyntheticHeader(*chainParams, nAlgo);
+    const int nHashVersion = LoadMultiHasherVersionFlags(true);
+    std::vector<unsigned char> vHeader;
+    CVectorWriter(SER_GETHASH, nHashVersion, vHeader, 0, header.GetDefaultBlockHeader());
+    CHeaderNonceHasher hasher(vHeader.data(), nAlgo, nHashVersion);
+    uint32_t nNonce = header.nNonce;
+    while (state.KeepRunning()) {
+        hasher.GetHash(nNonce++);
+    }
+}
+
+static void NonceScan_SHA256D(benchmark::State& state) { ScanNonces(state, ALGO_SHA256D); }
+static void NonceScan_X11(benchmark::State& state) { ScanNonces(state, ALGO_X11); }
+
+BENCHMARK(NonceScan_SHA256D, 400000);
+BENCHMARK(NonceScan_X11, 30000);
+
+/** Merge-mined header whose parent block has 1024 transactions and that commits to 4 chains */
+static void AuxpowCheck(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    const uint256 hashAux = GetRandHash();
+    const unsigned int nChainHeight = 2;
+    const int nNonce = 7;
+
+    std::vector<uint256> vChainMerkleBranch;
+    for (unsigned int i = 0; i < nChainHeight; i++)
+        vChainMerkleBranch.push_back(GetRandHash());
+    const int nChainIndex = CAuxPow::getExpectedIndex(nNonce, params.nAuxpowChainId, nChainHeight);
+    const uint256 hashChainRoot = CAuxPow::CheckMerkleBranch(hashAux, vChainMerkleBranch, nChainIndex);
+    std::vector<unsigned char> vchRoot(hashChainRoot.begin(), hashChainRoot.end());
+    std::reverse(vchRoot.begin(), vchRoot.end());
+
+    std::vector<unsigned char> vchData(UBEGIN(pchMergedMiningHeader), UEND(pchMergedMiningHeader));
+    vchData.insert(vchData.end(), vchRoot.begin(), vchRoot.end());
+    const int nSize = 1 << nChainHeight;
+    vchData.insert(vchData.end(), UBEGIN(nSize), UEND(nSize));
+    vchData.insert(vchData.end(), UBEGIN(nNonce), UEND(nNonce));
+
+    CBlock parent;
+    parent.SetBaseVersion(5, params.nAuxpowChainId + 1);
+    for (int i = 0; i < 1024; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        if (i == 0) {
+            mtx.vin[0].prevout.SetNull();
+            mtx.vin[0].scriptSig = CScript() << 2809 << 2013 << vchData;
+        } else {
+            mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        }
+        parent.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+    parent.hashMerkleRoot = BlockMerkleRoot(parent);
+
+    CAuxPow auxpow(parent.vtx[0]);
+    auxpow.nVersion = 0;
+    auxpow.coinbaseTx.InitMerkleBranch(parent, 0);
+    auxpow.vChainMerkleBranch = vChainMerkleBranch;
+    auxpow.nChainIndex = nChainIndex;
+    auxpow.defaultparentBlock = parent.GetDefaultBlockHeader();
+    assert(auxpow.check(hashAux, params.nAuxpowChainId, params, ALGO_SHA256D));
+
+    while (state.KeepRunning()) {
+        auxpow.check(hashAux, params.nAuxpowChainId, params, ALGO_SHA256D);
+    }
+}
+
+/**
+ * Small parameter sets are solved up front so that a valid solution is
+ * checked. Solving 200,9, 144,5 and 192,7 takes too long here, so those
+ * check a well-formed solution with random indices: every leaf hash is
+ * computed, which is most of the work, but the first pair of leaves fails
+ * the collision check, so the tree is never merged and the final XOR check
+ * is not reached. These numbers are those of rejecting a bad solution.
+ */
+static void VerifyEquihash(benchmark::State& state, uint8_t nAlgo)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const unsigned int n = chainParams->GetEquihashAlgoN(nAlgo);
+    const unsigned int k = chainParams->GetEquihashAlgoK(nAlgo);
+    const std::string strPersonalize = GetEquihashBasedDefaultPersonalize(nAlgo);
+    CEquihashBlockHeader header = SyntheticHeader(*chainParams, nAlgo).GetEquihashBlockHeader();
+
+    const size_t nBitLen = n / (k + 1);
+    bool fValid = false;
+    if (nBitLen <= 16) {
+        while (!fValid) {
+            header.nNonce = GetRandHash();
+            crypto_generichash_blake2b_state eh_state;
+            EhInitialiseState(n, k, eh_state, strPersonalize);
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss << CEquihashInput(header) << header.nNonce;
+            crypto_generichash_blake2b_update(&eh_state, (unsigned char*)&ss[0], ss.size());
+            EhOptimisedSolveUncancellable(n, k, eh_state, [&](std::vector<unsigned char> soln) {
+                header.nSolution = soln;
+                fValid = true;
+                return true;
+            });
+        }
+    } else {
+        std::vector<eh_index> vIndices;
+        for (int i = 0; i < (1 << k); i++)
+            vIndices.push_back(GetRand(1ULL << (nBitLen + 1)));
+        header.nSolution = GetMinimalFromIndices(vIndices, nBitLen);
+    }
+    assert(CheckEquihashSolution(&header, *chainParams, nAlgo, strPersonalize) == fValid);
+
+    while (state.KeepRunning()) {
+        CheckEquihashSolution(&header, *chainParams, nAlgo, strPersonalize);
+    }
+}
+
+static void EquihashVerify_200_9(benchmark::State& state) { VerifyEquihash(state, ALGO_EQUIHASH); }
+static void EquihashVerify_144_5(benchmark::State& state) { VerifyEquihash(state, ALGO_ZHASH); }
+static void EquihashVerify_192_7(benchmark::State& state) { VerifyEquihash(state, ALGO_EH192); }
+static void EquihashVerify_96_5(benchmark::State& state) { VerifyEquihash(state, ALGO_MARS); }
+
+/** A chain after Hardfork 3 that cycles through all algorithms */
+class CSyntheticChain
+{
+public:
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vBlocks;
+
+    CSyntheticChain(const Consensus::Params& params, int nBlocks) : vHashes(nBlocks), vBlocks(nBlocks)
+    {
+        for (int i = 0; i < nBlocks; i++) {
+            const uint8_t nAlgo = i % NUM_ALGOS;
+            CBlockHeader header;
+            header.nVersion = 4;
+            header.SetAlgo(nAlgo);
+            vHashes[i] = GetRandHash();
+            vBlocks[i].phashBlock = &vHashes[i];
+            vBlocks[i].pprev = i ? &vBlocks[i - 1] : nullptr;
+            vBlocks[i].nHeight = i;
+            vBlocks[i].nVersion = header.nVersion;
+            vBlocks[i].nTime = params.Hardfork3.GetActivationTime() + i * params.nPowTargetSpacing;
+            vBlocks[i].nBits = arith_uint256(params.aPOWAlgos[nAlgo].GetArithPowLimit() >> 12).GetCompact();
+            vBlocks[i].BuildSkip();
+        }
+    }
+};
+
+static void GetBlockProofMultiAlgo(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    CSyntheticChain chain(params, 4 * NUM_ALGOS);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        GetBlockProof(chain.vBlocks[chain.vBlocks.size() - 1 - (i++ % NUM_ALGOS)], params);
+    }
+}
+
+static void GetNextWorkRequiredMultiAlgo(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    CSyntheticChain chain(params, 2 * NUM_ALGOS * params.nAveragingInterval);
+    const CBlockIndex* pindexTip = &chain.vBlocks.back();
+    CBlockHeader header;
+    header.nTime = pindexTip->nTime + params.nPowTargetSpacing;
+    uint8_t nAlgo = 0;
+    while (state.KeepRunning()) {
+        GetNextWorkRequired(pindexTip, &header, params, nAlgo);
+        nAlgo = (nAlgo + 1) % NUM_ALGOS;
+    }
+}
+
+BENCHMARK(AuxpowCheck, 70000);
+BENCHMARK(EquihashVerify_200_9, 2000);
+BENCHMARK(EquihashVerify_144_5, 30000);
+BENCHMARK(EquihashVerify_192_7, 8000);
+BENCHMARK(EquihashVerify_96_5, 30000);
+BENCHMARK(GetBlockProofMultiAlgo, 3000);
+BENCHMARK(GetNextWorkRequiredMultiAlgo, 2000);
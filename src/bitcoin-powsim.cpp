@@ -0,0 +1,317 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <chainparamsbase.h>
+#include <clientversion.h>
+#include <globaltoken/powalgorithm.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <rpc/blockchain.h>
+#include <util.h>
+#include <utilstrencodings.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdio.h>
+
+#include <boost/algorithm/string.hpp>
+
+static const int DEFAULT_SIM_BLOCKS = 100000;
+
+/** A change of the hashrate of one algo (or all of them) from a given height on */
+struct HashrateChange
+{
+    int nHeight;
+    int nAlgo; // -1 for all active algos
+    double dFactor;
+};
+
+struct AlgoSimStats
+{
+    uint64_t nBlocks = 0;
+    int64_t nBlockTimeSum = 0;
+    uint32_t nLastTime = 0;
+    double dDiffSum = 0;
+    double dDiffMin = 0;
+    double dDiffMax = 0;
+    uint32_t nLastBits = 0;
+};
+
+static bool ParseHashrateChange(const std::string& strChange, HashrateChange& change)
+{
+    // <algo|all>:<factor>[@<height>]
+    std::string str = strChange;
+    change.nHeight = 0;
+    size_t pos = str.find('@');
+    if (pos != std::string::npos) {
+        if (!ParseInt32(str.substr(pos + 1), &change.nHeight) || change.nHeight < 0)
+            return false;
+        str = str.substr(0, pos);
+    }
+    pos = str.find(':');
+    if (pos == std::string::npos)
+        return false;
+    if (!ParseDouble(str.substr(pos + 1), &change.dFactor) || change.dFactor < 0)
+        return false;
+    const std::string strAlgo = str.substr(0, pos);
+    if (strAlgo == "all") {
+        change.nAlgo = -1;
+        return true;
+    }
+    bool fFound;
+    change.nAlgo = GetAlgoByName(strAlgo, ALGO_SHA256D, fFound);
+    return fFound;
+}
+
+/** Draw from an exponential distribution with the given rate */
+static double RandExponential(FastRandomContext& rng, double dRate)
+{
+    // 53 random bits, shifted away from zero so that log() stays finite
+    const double u = ((double)rng.randbits(53) + 0.5) / 9007199254740992.0;
+    return -std::log(u) / dRate;
+}
+
+static int AppInitPowSim(int argc, char* argv[])
+{
+    gArgs.ParseParameters(argc, argv);
+
+    try {
+        SelectParams(ChainNameFromCommandLine());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    if (gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help")) {
+        std::string strUsage = strprintf(_("%s globaltoken-powsim utility version"), _(PACKAGE_NAME)) + " " + FormatFullVersion() + "\n\n" +
+            _("Usage:") + "\n" +
+              "  globaltoken-powsim [options]  " + _("Simulate multi-algo mining against the consensus difficulty retargeting") + "\n" +
+              "\n";
+        fprintf(stdout, "%s", strUsage.c_str());
+
+        strUsage = HelpMessageGroup(_("Options:"));
+        strUsage += HelpMessageOpt("-?", _("This help message"));
+        strUsage += HelpMessageOpt("-algos=<list>", _("Comma separated list of algos that are mined (default: all)"));
+        strUsage += HelpMessageOpt("-blocks=<n>", strprintf(_("Number of blocks to simulate (default: %u)"), DEFAULT_SIM_BLOCKS));
+        strUsage += HelpMessageOpt("-hashrate=<algo|all>:<factor>[@<height>]", _("Set the hashrate of an algo from the given height on. "
+            "A factor of 1 finds one block at the algo's minimum difficulty per target block time of that algo (default: 1 for every mined algo). "
+            "Can be specified multiple times"));
+        strUsage += HelpMessageOpt("-seed=<n>", _("Seed for the block time generator (default: random)"));
+        strUsage += HelpMessageOpt("-trace=<file>", _("Write height, time, algo, bits, difficulty and block times of every block as CSV to <file> (\"-\" for stdout)"));
+        AppendParamsHelpMessages(strUsage);
+        fprintf(stdout, "%s", strUsage.c_str());
+        return EXIT_SUCCESS;
+    }
+    return -1;
+}
+
+static int CommandLinePowSim()
+{
+    const Consensus::Params& params = Params().GetConsensus();
+
+    const int nBlocks = gArgs.GetArg("-blocks", DEFAULT_SIM_BLOCKS);
+    if (nBlocks <= 0)
+        throw std::runtime_error("-blocks must be positive");
+
+    std::vector<bool> vActive(NUM_ALGOS, true);
+    const std::string strAlgos = gArgs.GetArg("-algos", "all");
+    if (strAlgos != "all") {
+        std::vector<std::string> vNames;
+        boost::split(vNames, strAlgos, boost::is_any_of(","));
+        std::fill(vActive.begin(), vActive.end(), false);
+        for (const std::string& strName : vNames) {
+            bool fFound;
+            const uint8_t nAlgo = GetAlgoByName(strName, ALGO_SHA256D, fFound);
+            if (!fFound)
+                throw std::runtime_error(strprintf("Unknown algo '%s'", strName));
+            vActive[nAlgo] = true;
+        }
+    }
+
+    std::vector<HashrateChange> vChanges;
+    for (const std::string& strChange : gArgs.GetArgs("-hashrate")) {
+        HashrateChange change;
+        if (!ParseHashrateChange(strChange, change))
+            throw std::runtime_error(strprintf("Invalid -hashrate '%s'", strChange));
+        vChanges.push_back(change);
+    }
+    std::stable_sort(vChanges.begin(), vChanges.end(), [](const HashrateChange& a, const HashrateChange& b) { return a.nHeight < b.nHeight; });
+
+    uint256 seed = GetRandHash();
+    if (gArgs.IsArgSet("-seed"))
+        seed = ArithToUint256(arith_uint256(gArgs.GetArg("-seed", 0)));
+    FastRandomContext rng(seed);
+
+    FILE* traceFile = nullptr;
+    const std::string strTrace = gArgs.GetArg("-trace", "");
+    if (strTrace == "-") {
+        traceFile = stdout;
+    } else if (!strTrace.empty()) {
+        traceFile = fopen(strTrace.c_str(), "w");
+        if (!traceFile)
+            throw std::runtime_error(strprintf("Cannot open trace file %s", strTrace));
+    }
+    if (traceFile)
+        fprintf(traceFile, "height,time,algo,bits,difficulty,blocktime,algoblocktime\n");
+
+    // Hashes per second that find one powLimit block per algo target spacing
+    std::vector<double> vBaseHashrate(NUM_ALGOS), vHashrate(NUM_ALGOS);
+    for (int i = 0; i < NUM_ALGOS; i++) {
+        const uint32_t nLimitBits = params.aPOWAlgos[i].GetArithPowLimit().GetCompact();
+        vBaseHashrate[i] = GetBlockProofBase(nLimitBits).getdouble() / params.nPowTargetSpacingMultiAlgoV2;
+        vHashrate[i] = vActive[i] ? vBaseHashrate[i] : 0;
+    }
+
+    // Start after all hardforks, so the current retargeting rules apply from the first block
+    const uint32_t nStartTime = std::max({params.Hardfork1.GetActivationTime(), params.Hardfork2.GetActivationTime(), params.Hardfork3.GetActivationTime()}) + 1;
+
+    // A deque keeps pprev pointers valid while the chain grows
+    std::deque<CBlockIndex> chain;
+    {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.SetAlgo(ALGO_SHA256D);
+        chain.emplace_back();
+        CBlockIndex& genesis = chain.back();
+        genesis.nHeight = 0;
+        genesis.nVersion = header.nVersion;
+        genesis.nTime = nStartTime;
+        genesis.nBits = params.aPOWAlgos[ALGO_SHA256D].GetArithPowLimit().GetCompact();
+    }
+
+    std::vector<AlgoSimStats> vStats(NUM_ALGOS);
+    std::vector<uint32_t> vBits(NUM_ALGOS);
+    std::vector<double> vRate(NUM_ALGOS);
+    double dClock = nStartTime;
+    size_t nNextChange = 0;
+
+    for (int nHeight = 1; nHeight <= nBlocks; nHeight++) {
+        for (; nNextChange < vChanges.size() && vChanges[nNextChange].nHeight <= nHeight; nNextChange++) {
+            const HashrateChange& change = vChanges[nNextChange];
+            for (int i = 0; i < NUM_ALGOS; i++) {
+                if (change.nAlgo == i || (change.nAlgo == -1 && vActive[i]))
+                    vHashrate[i] = change.dFactor * vBaseHashrate[i];
+            }
+        }
+
+        const CBlockIndex* pindexTip = &chain.back();
+        CBlockHeader header;
+        header.nTime = pindexTip->nTime + 1;
+
+        double dTotalRate = 0;
+        for (int i = 0; i < NUM_ALGOS; i++) {
+            vRate[i] = 0;
+            if (vHashrate[i] <= 0)
+                continue;
+            vBits[i] = GetNextWorkRequired(pindexTip, &header, params, i);
+            vRate[i] = vHashrate[i] / GetBlockProofBase(vBits[i]).getdouble();
+            dTotalRate += vRate[i];
+        }
+        if (dTotalRate <= 0)
+            throw std::runtime_error(strprintf("No hashrate left at height %d", nHeight));
+
+        // Each algo finds blocks as an independent Poisson process, so the next
+        // block arrives after an exponential delay and comes from an algo with
+        // probability proportional to its rate.
+        dClock += RandExponential(rng, dTotalRate);
+        if (dClock >= std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error(strprintf("Block time overflow at height %d, the difficulty ran away", nHeight));
+        double dPick = ((double)rng.randbits(53) / 9007199254740992.0) * dTotalRate;
+        int nAlgo = -1;
+        for (int i = 0; i < NUM_ALGOS; i++) {
+            if (vRate[i] <= 0)
+                continue;
+            nAlgo = i;
+            if (dPick < vRate[i])
+                break;
+            dPick -= vRate[i];
+        }
+
+        header.nVersion = 4;
+        header.SetAlgo(nAlgo);
+        chain.emplace_back();
+        CBlockIndex& block = chain.back();
+        block.pprev = const_cast<CBlockIndex*>(pindexTip);
+        block.nHeight = nHeight;
+        block.nVersion = header.nVersion;
+        block.nTime = std::max((int64_t)dClock, pindexTip->GetMedianTimePast() + 1);
+        block.nBits = vBits[nAlgo];
+        block.BuildSkip();
+
+        const double dDiff = GetDifficultyFromBits(block.nBits);
+        AlgoSimStats& stats = vStats[nAlgo];
+        const int64_t nAlgoBlockTime = stats.nBlocks ? (int64_t)block.nTime - stats.nLastTime : 0;
+        if (stats.nBlocks) {
+            stats.nBlockTimeSum += nAlgoBlockTime;
+            stats.dDiffMin = std::min(stats.dDiffMin, dDiff);
+            stats.dDiffMax = std::max(stats.dDiffMax, dDiff);
+        } else {
+            stats.dDiffMin = stats.dDiffMax = dDiff;
+        }
+        stats.nBlocks++;
+        stats.nLastTime = block.nTime;
+        stats.dDiffSum += dDiff;
+        stats.nLastBits = block.nBits;
+
+        if (traceFile)
+            fprintf(traceFile, "%d,%u,%s,%08x,%.8f,%d,%d\n", nHeight, block.nTime, GetAlgoName(nAlgo).c_str(), block.nBits, dDiff,
+                (int)((int64_t)block.nTime - pindexTip->nTime), (int)nAlgoBlockTime);
+    }
+
+    if (traceFile && traceFile != stdout)
+        fclose(traceFile);
+    if (traceFile == stdout)
+        return EXIT_SUCCESS;
+
+    const int64_t nElapsed = (int64_t)chain.back().nTime - nStartTime;
+    fprintf(stdout, "blocks: %d, mean block time: %.2fs (target %ds)\n", nBlocks, (double)nElapsed / nBlocks, (int)params.nPowTargetSpacing);
+    fprintf(stdout, "%-20s %8s %7s %10s %14s %14s %14s %14s\n", "algo", "blocks", "share", "blocktime", "diff-mean", "diff-min", "diff-max", "diff-final");
+    for (int i = 0; i < NUM_ALGOS; i++) {
+        const AlgoSimStats& stats = vStats[i];
+        if (!stats.nBlocks && vHashrate[i] <= 0)
+            continue;
+        fprintf(stdout, "%-20s %8u %6.2f%% %9.1fs %14.6g %14.6g %14.6g %14.6g\n", GetAlgoName(i).c_str(), (unsigned int)stats.nBlocks,
+            100.0 * stats.nBlocks / nBlocks, stats.nBlocks > 1 ? (double)stats.nBlockTimeSum / (stats.nBlocks - 1) : 0.0,
+            stats.nBlocks ? stats.dDiffSum / stats.nBlocks : 0.0, stats.dDiffMin, stats.dDiffMax,
+            stats.nBlocks ? GetDifficultyFromBits(stats.nLastBits) : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+    SetupEnvironment();
+
+    try {
+        int ret = AppInitPowSim(argc, argv);
+        if (ret != -1)
+            return ret;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "AppInitPowSim()");
+        return EXIT_FAILURE;
+    } catch (...) {
+        PrintExceptionContinue(nullptr, "AppInitPowSim()");
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_FAILURE;
+    try {
+        ret = CommandLinePowSim();
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "CommandLinePowSim()");
+    } catch (...) {
+        PrintExceptionContinue(nullptr, "CommandLinePowSim()");
+    }
+    return ret;
+}
@@ -43,11 +43,50 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
     return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
 }
 
+void CBlockHeaderAndShortTxIDs::OmitKnownHeaderData() {
+    uint8_t flags = 0;
+    if (IsEquihashBasedAlgo(header.GetAlgo()) && !header.nSolution.empty())
+        flags |= CMPCT_HEADER_NO_SOLUTION;
+    if (header.IsAuxpow() && header.auxpow)
+        flags |= CMPCT_HEADER_NO_AUXPOW;
+    if (flags == 0)
+        return;
+    hashHeader = header.GetHash();
+    nHeaderFlags = flags;
+}
+
+ReadStatus CBlockHeaderAndShortTxIDs::FillOmittedHeaderData(const std::vector<unsigned char>* pSolution, const boost::shared_ptr<CAuxPow>& auxpow) {
+    if (IsHeaderComplete())
+        return READ_STATUS_OK;
+
+    CBlockHeader restored(header);
+    if (IsSolutionOmitted()) {
+        if (!pSolution || pSolution->empty())
+            return READ_STATUS_FAILED;
+        restored.nSolution = *pSolution;
+    }
+    if (IsAuxpowOmitted()) {
+        if (!auxpow)
+            return READ_STATUS_FAILED;
+        restored.auxpow = auxpow;
+    }
+    if (restored.GetHash() != hashHeader)
+        return READ_STATUS_FAILED;
+
+    header = restored;
+    nHeaderFlags = 0;
+    hashHeader.SetNull();
+    FillShortTxIDSelector();
+    return READ_STATUS_OK;
+}
+
 
 
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
         return READ_STATUS_INVALID;
+    if (!cmpctblock.IsHeaderComplete())
+        return READ_STATUS_FAILED; // Caller must restore omitted header data first
     if (cmpctblock.shorttxids.size() + cmpctblock.prefilledtxn.size() > MAX_BLOCK_WEIGHT / MIN_SERIALIZABLE_TRANSACTION_WEIGHT)
         return READ_STATUS_INVALID;
 
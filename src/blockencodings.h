@@ -6,6 +6,7 @@
 #define BITCOIN_BLOCK_ENCODINGS_H
 
 #include <primitives/block.h>
+#include <version.h>
 
 #include <memory>
 
@@ -128,11 +129,26 @@ typedef enum ReadStatus_t
                                    // failure in CheckBlock.
 } ReadStatus;
 
+/**
+ * Header fields a cmpctblock may leave out (from COMPACT_HEADER_VERSION on)
+ * because the receiving peer already got them through a headers announcement.
+ */
+enum CompactHeaderFlags : uint8_t {
+    CMPCT_HEADER_NO_SOLUTION = (1 << 0), //!< Equihash nSolution omitted, restored from the block index
+    CMPCT_HEADER_NO_AUXPOW   = (1 << 1), //!< auxpow omitted, restored from the announced header
+    CMPCT_HEADER_KNOWN_FLAGS = CMPCT_HEADER_NO_SOLUTION | CMPCT_HEADER_NO_AUXPOW,
+};
+
 class CBlockHeaderAndShortTxIDs {
 private:
     mutable uint64_t shorttxidk0, shorttxidk1;
     uint64_t nonce;
 
+    //! Combination of CompactHeaderFlags, zero when the header is complete
+    uint8_t nHeaderFlags = 0;
+    //! Hash of the full header, only sent when nHeaderFlags is non-zero
+    uint256 hashHeader;
+
     void FillShortTxIDSelector() const;
 
     friend class PartiallyDownloadedBlock;
@@ -154,11 +170,62 @@ public:
 
     size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
 
+    /**
+     * Leave the Equihash solution and the auxpow out of the serialized header.
+     * Only use this for peers known to have the header already; peers that
+     * did not negotiate COMPACT_HEADER_VERSION still get the full header.
+     */
+    void OmitKnownHeaderData();
+
+    bool IsHeaderComplete() const { return nHeaderFlags == 0; }
+    bool IsSolutionOmitted() const { return nHeaderFlags & CMPCT_HEADER_NO_SOLUTION; }
+    bool IsAuxpowOmitted() const { return nHeaderFlags & CMPCT_HEADER_NO_AUXPOW; }
+    const uint256& GetOmittedHeaderHash() const { return hashHeader; }
+
+    /**
+     * Restore the header fields left out by the sender. pSolution and auxpow
+     * are only consulted for the fields that were actually omitted.
+     * @return READ_STATUS_FAILED if a field is unavailable or the restored
+     *         header does not match the announced hash.
+     */
+    ReadStatus FillOmittedHeaderData(const std::vector<unsigned char>* pSolution, const boost::shared_ptr<CAuxPow>& auxpow);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(header);
+        if (s.GetVersion() >= COMPACT_HEADER_VERSION) {
+            READWRITE(nHeaderFlags);
+            if (nHeaderFlags & ~CMPCT_HEADER_KNOWN_FLAGS)
+                throw std::ios_base::failure("unknown compact header flags");
+            if (nHeaderFlags)
+                READWRITE(hashHeader);
+
+            if (!ser_action.ForRead() && IsSolutionOmitted()) {
+                CPureBlockHeader pureheader(header);
+                pureheader.nSolution.clear();
+                READWRITE(pureheader);
+            } else {
+                READWRITE(*static_cast<CPureBlockHeader*>(&header));
+            }
+            if (IsSolutionOmitted() && !IsEquihashBasedAlgo(header.GetAlgo()))
+                throw std::ios_base::failure("solution omitted from non-equihash header");
+            if (IsAuxpowOmitted() && !header.IsAuxpow())
+                throw std::ios_base::failure("auxpow omitted from non-auxpow header");
+
+            if (header.IsAuxpow() && !IsAuxpowOmitted()) {
+                if (ser_action.ForRead())
+                    header.auxpow.reset(new CAuxPow());
+                assert(header.auxpow);
+                READWRITE(*header.auxpow);
+            } else if (ser_action.ForRead()) {
+                header.auxpow.reset();
+            }
+        } else {
+            if (!IsHeaderComplete())
+                throw std::ios_base::failure("compact header not supported by stream version");
+            READWRITE(header);
+        }
         READWRITE(nonce);
 
         uint64_t shorttxids_size = (uint64_t)shorttxids.size();
@@ -186,7 +253,9 @@ public:
 
         READWRITE(prefilledtxn);
 
-        if (ser_action.ForRead())
+        // The short ID keys commit to the full header, so they can only be
+        // derived once any omitted header data has been filled back in.
+        if (ser_action.ForRead() && IsHeaderComplete())
             FillShortTxIDSelector();
     }
 };
@@ -145,12 +145,12 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
-arith_uint256 GetBlockProofBase(const CBlockIndex& block)
+arith_uint256 GetBlockProofBase(uint32_t nBits)
 {
     arith_uint256 bnTarget;
     bool fNegative;
     bool fOverflow;
-    bnTarget.SetCompact(block.nBits, &fNegative, &fOverflow);
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
     if (fNegative || fOverflow || bnTarget == 0)
         return 0;
     // We need to compute 2**256 / (bnTarget+1), but we can't represent 2**256
@@ -160,6 +160,11 @@ arith_uint256 GetBlockProofBase(const CBlockIndex& block)
     return (~bnTarget / (bnTarget + 1)) + 1;
 }
 
+arith_uint256 GetBlockProofBase(const CBlockIndex& block)
+{
+    return GetBlockProofBase(block.nBits);
+}
+
 double CalculateAlgoHashrate(const CBlockIndex& block, int algo, int lookup, const Consensus::Params& params)
 {
     arith_uint256 totalAlgoWork;
@@ -162,6 +162,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_SEPARATE_SOLUTION  =   256, //!< the block index record has no nSolution, it was written once in a record of its own
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -303,14 +305,11 @@ public:
 
     uint8_t GetAlgo() const
     {
-        /* create a dummy blockheader and set the nVersion known from CBlockIndex into the block version.
-         * nVersion is required because we need the block algo, which is calculated through nVersion.
-         * So we don't need the full GetBlockHeader Command, because it will fail while linking and 
-         * the LoadBlockIndex will fail if it tries to get a BlockHeader with consensusParams.
-         */ 
-        CBlockHeader block;
-        block.nVersion = nVersion;
-        return block.GetAlgo();
+        /* The algo is encoded in nVersion alone, so decode it directly instead of
+         * building a full CBlockHeader. This is called for every block walked back
+         * over while retargeting, and GetBlockHeader would need consensusParams.
+         */
+        return CPureBlockHeader::GetAlgoFromVersion(nVersion);
     }
     
     int32_t GetAuxpowVersion() const
@@ -385,6 +384,8 @@ public:
     const CBlockIndex* GetAncestor(int height) const;
 };
 
+/** Work represented by a single block at the given compact target, before any multi-algo weighting */
+arith_uint256 GetBlockProofBase(uint32_t nBits);
 arith_uint256 GetBlockProof(const CBlockIndex& block);
 arith_uint256 GetBlockProof(const CBlockIndex& block, const Consensus::Params&);
 double CalculateAlgoHashrate(const CBlockIndex& block, int algo, int lookup, const Consensus::Params&);
@@ -438,7 +439,8 @@ public:
         if (IsEquihashBasedAlgo(GetAlgo()))
         {
             READWRITE(nBigNonce);
-            READWRITE(nSolution);
+            if (!(nStatus & BLOCK_SEPARATE_SOLUTION))
+                READWRITE(nSolution);
         }
         if(!IsEquihashBasedAlgo(GetAlgo()))
         {
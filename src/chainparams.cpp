@@ -75,6 +75,20 @@ void CChainParams::UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64
     consensus.vDeployments[d].nTimeout = nTimeout;
 }
 
+const CSnapshotCommitment* CChainParams::SnapshotCommitment(const uint256& hashBlock) const
+{
+    for (const CSnapshotCommitment& commitment : vSnapshotCommitments) {
+        if (commitment.hashBlock == hashBlock)
+            return &commitment;
+    }
+    return nullptr;
+}
+
+void CChainParams::AddSnapshotCommitment(const CSnapshotCommitment& commitment)
+{
+    vSnapshotCommitments.push_back(commitment);
+}
+
 /**
  * Main network
  */
@@ -1651,3 +1665,8 @@ void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime,
 {
     globalChainParams->UpdateVersionBitsParameters(d, nStartTime, nTimeout);
 }
+
+void AddSnapshotCommitment(const CSnapshotCommitment& commitment)
+{
+    globalChainParams->AddSnapshotCommitment(commitment);
+}
@@ -36,6 +36,16 @@ struct ChainTxData {
     double dTxRate;
 };
 
+/** A UTXO set that nodes may start from (-loadsnapshot) instead of validating the chain up to its base block */
+struct CSnapshotCommitment {
+    int nHeight;
+    uint256 hashBlock;
+    //! hash_serialized_2 of gettxoutsetinfo at hashBlock
+    uint256 hashSerialized;
+    //! Number of transactions up to and including hashBlock
+    unsigned int nChainTx;
+};
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Bitcoin system. There are three: the main network on which people trade goods
@@ -91,6 +101,9 @@ public:
     const std::vector<CScript>& BannedAddresses() const { return vAttackersAddressScripts; }
     void InitAttackersAddressScriptVector();
     const ChainTxData& TxData() const { return chainTxData; }
+    /** Return the snapshot commitment for a base block, or nullptr if there is none */
+    const CSnapshotCommitment* SnapshotCommitment(const uint256& hashBlock) const;
+    void AddSnapshotCommitment(const CSnapshotCommitment& commitment);
     int FulfilledRequestExpireTime() const { return nFulfilledRequestExpireTime; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
     const std::string& SporkAddress() const { return strSporkAddress; }
@@ -121,6 +134,7 @@ protected:
     bool fAllowMultiplePorts;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    std::vector<CSnapshotCommitment> vSnapshotCommitments;
     int nFulfilledRequestExpireTime;
     std::string strSporkAddress;
     std::vector<std::string> vFoundersRewardAddress;
@@ -160,6 +174,11 @@ void SelectParams(const std::string& chain);
  */
 void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
 
+/**
+ * Allows adding UTXO snapshot commitments on regtest.
+ */
+void AddSnapshotCommitment(const CSnapshotCommitment& commitment);
+
 /**
  * Initializes the attackers address vector with CScripts.
  */
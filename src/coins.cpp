@@ -6,6 +6,9 @@
 
 #include <consensus/consensus.h>
 #include <random.h>
+#include <util.h>
+
+#include <memory>
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
@@ -31,16 +34,24 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0), fFlushDone(false), fFlushOk(true), cachedFlushingUsage(0) {}
+
+CCoinsViewCache::~CCoinsViewCache()
+{
+    if (flushThread.joinable())
+        flushThread.join();
+}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage + cachedFlushingUsage;
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.accessed = true;
         return it;
+    }
     Coin tmp;
     if (!base->GetCoin(outpoint, tmp))
         return cacheCoins.end();
@@ -102,7 +113,7 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     if (moveout) {
         *moveout = std::move(it->second.coin);
     }
-    if (it->second.flags & CCoinsCacheEntry::FRESH) {
+    if ((it->second.flags & CCoinsCacheEntry::FRESH) && !(it->second.flags & CCoinsCacheEntry::FLUSHING)) {
         cacheCoins.erase(it);
     } else {
         it->second.flags |= CCoinsCacheEntry::DIRTY;
@@ -176,7 +187,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
             }
 
             // Found the entry in the parent cache
-            if ((itUs->second.flags & CCoinsCacheEntry::FRESH) && it->second.coin.IsSpent()) {
+            if ((itUs->second.flags & CCoinsCacheEntry::FRESH) && !(itUs->second.flags & CCoinsCacheEntry::FLUSHING) && it->second.coin.IsSpent()) {
                 // The grandparent does not have an entry, and the child is
                 // modified and being pruned. This means we can just delete
                 // it from the parent.
@@ -201,12 +212,122 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 }
 
 bool CCoinsViewCache::Flush() {
+    if (!FinishFlush(true))
+        return false;
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+bool CCoinsViewCache::FlushInBackground() {
+    if (!FinishFlush(true))
+        return false;
+
+    // The cached entries become the authoritative version until the write
+    // is done: they are marked FLUSHING so that they are neither evicted nor
+    // erased, which would expose the outdated version in the base.
+    std::shared_ptr<CCoinsMap> mapFlush = std::make_shared<CCoinsMap>();
+    for (auto& entry : cacheCoins) {
+        if (!(entry.second.flags & CCoinsCacheEntry::DIRTY))
+            continue;
+        CCoinsCacheEntry& copy = (*mapFlush)[entry.first];
+        copy.coin = entry.second.coin;
+        copy.flags = CCoinsCacheEntry::DIRTY;
+        cachedFlushingUsage += copy.coin.DynamicMemoryUsage();
+        entry.second.flags = CCoinsCacheEntry::FLUSHING;
+    }
+    cachedFlushingUsage += memusage::DynamicUsage(*mapFlush);
+
+    CCoinsView* baseFlush = base;
+    const uint256 hashBlockFlush = GetBestBlock();
+    fFlushDone = false;
+    flushThread = std::thread([this, baseFlush, mapFlush, hashBlockFlush]() {
+        RenameThread("globaltoken-coinsflush");
+        bool fOk = false;
+        try {
+            fOk = baseFlush->BatchWrite(*mapFlush, hashBlockFlush);
+        } catch (const std::exception& e) {
+            LogPrintf("CCoinsViewCache::FlushInBackground: %s\n", e.what());
+        }
+        if (!fOk)
+            fFlushOk = false;
+        fFlushDone = true;
+    });
+    return true;
+}
+
+size_t CCoinsViewCache::EstimateFlushCopyUsage() const {
+    size_t nCount = 0;
+    size_t nUsage = 0;
+    for (const auto& entry : cacheCoins) {
+        if (entry.second.flags & CCoinsCacheEntry::DIRTY) {
+            nCount++;
+            nUsage += entry.second.coin.DynamicMemoryUsage();
+        }
+    }
+    return nUsage + memusage::MallocUsage(sizeof(memusage::unordered_node<CCoinsMap::value_type>)) * nCount + memusage::MallocUsage(sizeof(void*) * nCount);
+}
+
+bool CCoinsViewCache::FlushModified() {
+    if (!FinishFlush(true))
+        return false;
+
+    // Moving the entries one at a time keeps memory use flat: each one is
+    // erased from the cache right after it was added to mapFlush.
+    CCoinsMap mapFlush;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            ++it;
+            continue;
+        }
+        cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+        CCoinsCacheEntry& entry = mapFlush[it->first];
+        entry.coin = std::move(it->second.coin);
+        entry.flags = it->second.flags;
+        it = cacheCoins.erase(it);
+    }
+    return base->BatchWrite(mapFlush, hashBlock);
+}
+
+bool CCoinsViewCache::FinishFlush(bool fWait) {
+    if (!flushThread.joinable() || (!fWait && !fFlushDone))
+        return fFlushOk;
+    flushThread.join();
+
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::FLUSHING) {
+            it->second.flags &= ~CCoinsCacheEntry::FLUSHING;
+            // A spent entry that was not touched again is gone from the base now
+            if (it->second.flags == 0 && it->second.coin.IsSpent()) {
+                it = cacheCoins.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+    cachedFlushingUsage = 0;
+    return fFlushOk;
+}
+
+void CCoinsViewCache::Evict(size_t nTargetUsage, const COutPointSet& setPinned) {
+    // A clock sweep: the first pass gives accessed entries a second chance
+    // and removes the others, the second pass removes what is still needed.
+    for (int nPass = 0; nPass < 2 && DynamicMemoryUsage() > nTargetUsage; nPass++) {
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end() && DynamicMemoryUsage() > nTargetUsage;) {
+            if (it->second.flags != 0 || setPinned.count(it->first)) {
+                ++it;
+            } else if (it->second.accessed) {
+                it->second.accessed = false;
+                ++it;
+            } else {
+                cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+                it = cacheCoins.erase(it);
+            }
+        }
+    }
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -17,7 +17,10 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <atomic>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 /**
  * A UTXO entry.
@@ -104,6 +107,7 @@ struct CCoinsCacheEntry
 {
     Coin coin; // The actual cached data.
     unsigned char flags;
+    bool accessed; // Used since the last eviction pass went by, see CCoinsViewCache::Evict.
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -113,13 +117,15 @@ struct CCoinsCacheEntry
          * flush the changes to the parent cache.  It is always safe to
          * not mark FRESH if that condition is not guaranteed.
          */
+        FLUSHING = (1 << 2), // A copy is being written to the parent view in the background; the entry must stay until that is done.
     };
 
-    CCoinsCacheEntry() : flags(0) {}
-    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
+    CCoinsCacheEntry() : flags(0), accessed(true) {}
+    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0), accessed(true) {}
 };
 
 typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+typedef std::unordered_set<COutPoint, SaltedOutpointHasher> COutPointSet;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -211,8 +217,15 @@ protected:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Background flush, see FlushInBackground. */
+    std::thread flushThread;
+    std::atomic<bool> fFlushDone;
+    std::atomic<bool> fFlushOk;
+    size_t cachedFlushingUsage;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
+    ~CCoinsViewCache();
 
     /**
      * By deleting the copy constructor, we prevent accidentally using it when one intends to create a cache on top of a base cache.
@@ -268,6 +281,46 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base from a
+     * background thread, keeping all entries cached. Only copying the dirty
+     * entries happens in the caller; the cache can be used and modified while
+     * the write is running. Waits for a previous background flush first.
+     * The base must be safe to read from while it is written to.
+     */
+    bool FlushInBackground();
+
+    /**
+     * Memory the copy made by FlushInBackground would take right now, on top
+     * of the cache itself.
+     */
+    size_t EstimateFlushCopyUsage() const;
+
+    /**
+     * Push the modified entries to the base and drop them from the cache,
+     * keeping the unmodified ones. Nothing is copied, unlike with
+     * FlushInBackground, so memory use does not grow while writing. Waits
+     * for a background flush first.
+     */
+    bool FlushModified();
+
+    //! Whether a background flush was started and not finished yet
+    bool IsFlushing() const { return flushThread.joinable(); }
+
+    /**
+     * Finish a background flush once its write is done, or wait for it if
+     * fWait is set. Returns false if a background write has ever failed, the
+     * base is then missing modifications that are no longer marked dirty.
+     */
+    bool FinishFlush(bool fWait);
+
+    /**
+     * Remove unmodified entries until the cache uses at most nTargetUsage
+     * bytes. Entries that were not accessed since the last pass go first,
+     * outpoints in setPinned are never removed.
+     */
+    void Evict(size_t nTargetUsage, const COutPointSet& setPinned);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -0,0 +1,211 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2017 The Bitcoin Core developers
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinstats.h>
+
+#include <chain.h>
+#include <serialize.h>
+#include <sync.h>
+#include <txdb.h>
+#include <util.h>
+#include <validation.h>
+#include <version.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/thread/thread.hpp> // boost::this_thread::interruption_point
+
+/** Number of txid ranges GetUTXOStats splits the coins database into */
+static const int UTXO_STATS_RANGES = 1024;
+/** Maximum number of threads reading the coins database in GetUTXOStats */
+static const int MAX_UTXO_STATS_THREADS = 8;
+
+CCoinsStatsHasher::CCoinsStatsHasher(CCoinsStats& statsIn) : stats(statsIn), ss(SER_GETHASH, PROTOCOL_VERSION), writer(ss, statsIn)
+{
+    ss << stats.hashBlock;
+}
+
+void CCoinsStatsHasher::Append(const CCoinsStats& statsRange, const CDataStream& data)
+{
+    writer.Flush();
+    ss.write(data.data(), data.size());
+    stats.nTransactions += statsRange.nTransactions;
+    stats.nTransactionOutputs += statsRange.nTransactionOutputs;
+    stats.nBogoSize += statsRange.nBogoSize;
+    stats.nTotalAmount += statsRange.nTotalAmount;
+}
+
+void CCoinsStatsHasher::Finalize()
+{
+    writer.Flush();
+    stats.hashSerialized = ss.GetHash();
+}
+
+namespace {
+
+/** First txid of a range, ranges are split on the two leading bytes of the key */
+uint256 RangeStart(int nRange)
+{
+    const unsigned int nPrefix = nRange * (0x10000 / UTXO_STATS_RANGES);
+    uint256 hash;
+    hash.begin()[0] = nPrefix >> 8;
+    hash.begin()[1] = nPrefix & 0xff;
+    return hash;
+}
+
+/** The serialized transactions of one range and their statistics */
+struct CoinsStatsRange
+{
+    CCoinsStats stats;
+    CDataStream data;
+
+    CoinsStatsRange() : data(SER_GETHASH, PROTOCOL_VERSION) {}
+};
+
+/**
+ * Ranges are claimed by the workers in order and hashed by the caller in
+ * order. Workers stay at most nWindow ranges ahead, which bounds the memory
+ * held by ranges waiting to be hashed.
+ */
+struct CoinsStatsWork
+{
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    std::atomic<bool> fStop;
+    bool fError;
+    int nNext;
+    int nHashed;
+    const int nWindow;
+    std::vector<std::unique_ptr<CoinsStatsRange> > vRanges;
+
+    explicit CoinsStatsWork(int nWindowIn) : fStop(false), fError(false), nNext(0), nHashed(0), nWindow(nWindowIn), vRanges(UTXO_STATS_RANGES) {}
+};
+
+void CoinsStatsWorker(CoinsStatsWork& work, CCoinsViewDBCursor* pcursor)
+{
+    try {
+        while (true) {
+            int nRange;
+            {
+                WaitableLock lock(work.cs);
+                work.cond.wait(lock, [&work]() { return work.fStop || work.nNext >= UTXO_STATS_RANGES || work.nNext < work.nHashed + work.nWindow; });
+                if (work.fStop || work.nNext >= UTXO_STATS_RANGES)
+                    return;
+                nRange = work.nNext++;
+            }
+
+            std::unique_ptr<CoinsStatsRange> range(new CoinsStatsRange());
+            CCoinsStatsWriter<CDataStream> writer(range->data, range->stats);
+            const bool fLast = nRange + 1 == UTXO_STATS_RANGES;
+            const uint256 hashEnd = fLast ? uint256() : RangeStart(nRange + 1);
+            for (pcursor->Seek(RangeStart(nRange)); pcursor->Valid(); pcursor->Next()) {
+                if (work.fStop)
+                    return;
+                COutPoint key;
+                Coin coin;
+                if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                    throw std::runtime_error("unable to read value");
+                if (!fLast && !(key.hash < hashEnd))
+                    break;
+                if (!writer.Add(key, coin))
+                    throw std::runtime_error("coins database is not in outpoint order");
+            }
+            writer.Flush();
+
+            {
+                WaitableLock lock(work.cs);
+                work.vRanges[nRange] = std::move(range);
+            }
+            work.cond.notify_all();
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        {
+            WaitableLock lock(work.cs);
+            work.fError = true;
+        }
+        work.cond.notify_all();
+    }
+}
+
+} // namespace
+
+bool GetUTXOStats(CCoinsViewDB* view, CCoinsStats& stats)
+{
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_UTXO_STATS_THREADS));
+
+    // Every cursor reads the database state of when it was created, so create
+    // them all before the next flush.
+    std::vector<std::unique_ptr<CCoinsViewDBCursor> > vCursors;
+    {
+        LOCK(cs_main);
+        // A background chainstate flush may be half written
+        if (pcoinsTip && !pcoinsTip->FinishFlush(true))
+            return error("%s: failed to write to coin database", __func__);
+        for (int i = 0; i < nThreads; i++)
+            vCursors.emplace_back(view->Cursor());
+        stats.hashBlock = vCursors[0]->GetBestBlock();
+        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
+    }
+
+    CoinsStatsWork work(2 * nThreads);
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        CCoinsViewDBCursor* pcursor = vCursors[i].get();
+        threads.emplace_back([&work, pcursor]() {
+            RenameThread("globaltoken-utxostats");
+            CoinsStatsWorker(work, pcursor);
+        });
+    }
+    auto stopWorkers = [&work, &threads]() {
+        {
+            WaitableLock lock(work.cs);
+            work.fStop = true;
+        }
+        work.cond.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    };
+
+    CCoinsStatsHasher hasher(stats);
+    try {
+        for (int i = 0; i < UTXO_STATS_RANGES; i++) {
+            std::unique_ptr<CoinsStatsRange> range;
+            {
+                WaitableLock lock(work.cs);
+                while (!work.vRanges[i] && !work.fError) {
+                    if (work.cond.wait_for(lock, std::chrono::milliseconds(100)) == std::cv_status::timeout) {
+                        lock.unlock();
+                        boost::this_thread::interruption_point();
+                        lock.lock();
+                    }
+                }
+                if (work.fError)
+                    break;
+                range = std::move(work.vRanges[i]);
+                work.nHashed++;
+            }
+            work.cond.notify_all();
+            hasher.Append(range->stats, range->data);
+        }
+    } catch (...) {
+        stopWorkers();
+        throw;
+    }
+    stopWorkers();
+    if (work.fError)
+        return error("%s: unable to read value", __func__);
+
+    hasher.Finalize();
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
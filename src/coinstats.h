@@ -0,0 +1,122 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2017 The Bitcoin Core developers
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATS_H
+#define BITCOIN_COINSTATS_H
+
+#include <amount.h>
+#include <coins.h>
+#include <hash.h>
+#include <serialize.h>
+#include <streams.h>
+#include <uint256.h>
+
+#include <map>
+#include <stdint.h>
+
+class CCoinsViewDB;
+
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    uint256 hashSerialized;
+    uint64_t nDiskSize;
+    CAmount nTotalAmount;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
+};
+
+/**
+ * Serializes coins in the hash_serialized_2 format into a stream and tallies
+ * their statistics. Coins must be passed in txid order, as the coins database
+ * returns them; the outputs of a transaction may come in any order (the
+ * database key holds the output index as a VARINT, which does not sort
+ * numerically) and are sorted here. A transaction is written once all its
+ * outputs are known.
+ */
+template <typename Stream>
+class CCoinsStatsWriter
+{
+public:
+    CCoinsStatsWriter(Stream& sIn, CCoinsStats& statsIn) : s(sIn), stats(statsIn) {}
+
+    /** Add the next coin. Returns false if its txid comes before the previous one, or it was added already. */
+    bool Add(const COutPoint& outpoint, const Coin& coin)
+    {
+        if (!outputs.empty() && outpoint.hash != prevout.hash) {
+            if (outpoint.hash < prevout.hash)
+                return false;
+            Flush();
+        }
+        if (!outputs.emplace(outpoint.n, coin).second)
+            return false;
+        prevout = outpoint;
+        return true;
+    }
+
+    /** Write the transaction of the last coin added */
+    void Flush()
+    {
+        if (outputs.empty())
+            return;
+        s << prevout.hash;
+        s << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+        stats.nTransactions++;
+        for (const auto& output : outputs) {
+            s << VARINT(output.first + 1);
+            s << output.second.out.scriptPubKey;
+            s << VARINT(output.second.out.nValue);
+            stats.nTransactionOutputs++;
+            stats.nTotalAmount += output.second.out.nValue;
+            stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+                               2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        }
+        s << VARINT(0);
+        outputs.clear();
+    }
+
+private:
+    Stream& s;
+    CCoinsStats& stats;
+    COutPoint prevout;
+    std::map<uint32_t, Coin> outputs;
+};
+
+/** Computes the statistics and hash_serialized_2 of a UTXO set */
+class CCoinsStatsHasher
+{
+public:
+    //! stats.hashBlock must be set, it is the first thing hashed
+    explicit CCoinsStatsHasher(CCoinsStats& statsIn);
+
+    /** Add the next coin. Returns false if its txid comes before the previous one, or it was added already. */
+    bool Add(const COutPoint& outpoint, const Coin& coin) { return writer.Add(outpoint, coin); }
+    /**
+     * Add whole transactions serialized by a CCoinsStatsWriter, with their
+     * statistics. They must all come after the coins added so far.
+     */
+    void Append(const CCoinsStats& statsRange, const CDataStream& data);
+    /** Hash the last transaction and set stats.hashSerialized */
+    void Finalize();
+
+private:
+    CCoinsStats& stats;
+    CHashWriter ss;
+    CCoinsStatsWriter<CHashWriter> writer;
+};
+
+/**
+ * Calculate statistics about the unspent transaction output set. The coins
+ * database is read by several threads over disjoint txid ranges, the results
+ * are hashed in key order.
+ */
+bool GetUTXOStats(CCoinsViewDB* view, CCoinsStats& stats);
+
+#endif // BITCOIN_COINSTATS_H
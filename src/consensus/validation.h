@@ -36,8 +36,9 @@ private:
     unsigned int chRejectCode;
     bool corruptionPossible;
     std::string strDebugMessage;
+    int64_t nPowCheckTime; //!< microseconds spent checking proof of work
 public:
-    CValidationState() : mode(MODE_VALID), nDoS(0), chRejectCode(0), corruptionPossible(false) {}
+    CValidationState() : mode(MODE_VALID), nDoS(0), chRejectCode(0), corruptionPossible(false), nPowCheckTime(0) {}
     bool DoS(int level, bool ret = false,
              unsigned int chRejectCodeIn=0, const std::string &strRejectReasonIn="",
              bool corruptionIn=false,
@@ -88,6 +89,8 @@ public:
     unsigned int GetRejectCode() const { return chRejectCode; }
     std::string GetRejectReason() const { return strRejectReason; }
     std::string GetDebugMessage() const { return strDebugMessage; }
+    void AddPowCheckTime(int64_t nTime) { nPowCheckTime += nTime; }
+    int64_t GetPowCheckTime() const { return nPowCheckTime; }
 };
 
 // These implement the weight = (stripped_size * 4) + witness_size formula,
@@ -11,6 +11,7 @@
 #include <vector>
 
 class CBlock;
+class CJSONStreamWriter;
 class CScript;
 class CTransaction;
 class CPOSTransaction;
@@ -34,5 +35,8 @@ std::string EncodeHexTx(const CTransaction& tx, const int serializeFlags = 0);
 void ScriptPubKeyToUniv(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 void TxToUniv(const CTransaction& tx, const uint256& hashBlock, UniValue& entry, bool include_hex = true, int serialize_flags = 0);
 void POSTxToUniv(const CPOSTransaction& tx, const uint256& hashBlock, UniValue& entry, int serialize_flags = 0);
+/** Same output as ScriptPubKeyToUniv/TxToUniv, written as a complete object without building a UniValue */
+void ScriptPubKeyToJSONWriter(CJSONStreamWriter& writer, const CScript& scriptPubKey, bool fIncludeHex);
+void TxToJSONWriter(CJSONStreamWriter& writer, const CTransaction& tx, const uint256& hashBlock, bool include_hex = true, int serialize_flags = 0);
 
 #endif // BITCOIN_CORE_IO_H
@@ -13,6 +13,8 @@
 #include <stdint.h>
 #include <algorithm>
 
+#include <boost/algorithm/string.hpp>
+
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
     // This code is adapted from posix_logger.h, which is why it is using vsprintf.
@@ -71,12 +73,102 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static const char* const DB_OPTIONS_NAMES[] = {"chainstate", "index", "address", "spent", "algostats"};
+
+static CDBOptions GetDefaultDBOptions(const std::string& strName)
+{
+    CDBOptions dbopts;
+    if (strName == "chainstate" || strName == "index") {
+        // Both grow to gigabytes, far more than max_open_files tables of the
+        // upstream 2 MiB. Random coin reads are fastest with the upstream
+        // 4 KiB blocks and the filter (bench CoinsDBRead). The block index
+        // entries, which carry an equihash nSolution, are read in one scan
+        // that larger blocks do not speed up (bench BlockIndexScan), and the
+        // txindex entries in the same database are point reads.
+        dbopts.nMaxFileSize = 32 << 20;
+    }
+    return dbopts;
+}
+
+/** Apply "<option>=<n>[,<option>=<n>...]" to dbopts */
+static bool ParseDBOptions(const std::string& strOptions, CDBOptions& dbopts, std::string& strError)
+{
+    std::vector<std::string> vOptions;
+    boost::split(vOptions, strOptions, boost::is_any_of(","));
+    for (const std::string& strOption : vOptions) {
+        size_t nPos = strOption.find('=');
+        int64_t nValue;
+        if (nPos == std::string::npos || !ParseInt64(strOption.substr(nPos + 1), &nValue) || nValue < 0) {
+            strError = strprintf("Invalid database option %s, expecting <option>=<n>", strOption);
+            return false;
+        }
+        const std::string strKey = strOption.substr(0, nPos);
+        if (strKey == "blocksize" && nValue >= 1024 && nValue <= (4 << 20)) {
+            dbopts.nBlockSize = nValue;
+        } else if (strKey == "bloombits" && nValue <= 64) {
+            dbopts.nBloomBits = nValue;
+        } else if (strKey == "writebuffer" && (nValue == 0 || (nValue >= (64 << 10) && nValue <= (1 << 30)))) {
+            dbopts.nWriteBufferSize = nValue;
+        } else if (strKey == "filesize" && nValue >= (1 << 20) && nValue <= (1 << 30)) {
+            dbopts.nMaxFileSize = nValue;
+        } else {
+            strError = strprintf("Invalid database option %s (blocksize 1024 to %d, bloombits 0 to 64, writebuffer 0 or %d to %d, filesize %d to %d)",
+                strOption, 4 << 20, 64 << 10, 1 << 30, 1 << 20, 1 << 30);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Split a -dbopts value into the database name and its options */
+static bool SplitDBOptionsArg(const std::string& strArg, std::string& strName, std::string& strOptions)
+{
+    size_t nPos = strArg.find(':');
+    if (nPos == std::string::npos)
+        return false;
+    strName = strArg.substr(0, nPos);
+    strOptions = strArg.substr(nPos + 1);
+    return true;
+}
+
+CDBOptions GetDBOptions(const std::string& strName)
+{
+    CDBOptions dbopts = GetDefaultDBOptions(strName);
+    for (const std::string& strArg : gArgs.GetArgs("-dbopts")) {
+        std::string strArgName, strOptions, strError;
+        if (SplitDBOptionsArg(strArg, strArgName, strOptions) && strArgName == strName)
+            ParseDBOptions(strOptions, dbopts, strError);
+    }
+    return dbopts;
+}
+
+bool CheckDBOptions(std::string& strError)
+{
+    for (const std::string& strArg : gArgs.GetArgs("-dbopts")) {
+        std::string strName, strOptions;
+        if (!SplitDBOptionsArg(strArg, strName, strOptions)) {
+            strError = strprintf("Database options %s malformed, expecting <db>:<option>=<n>[,<option>=<n>...]", strArg);
+            return false;
+        }
+        if (std::find(std::begin(DB_OPTIONS_NAMES), std::end(DB_OPTIONS_NAMES), strName) == std::end(DB_OPTIONS_NAMES)) {
+            strError = strprintf("Unknown database %s in -dbopts, expecting one of %s", strName, boost::algorithm::join(std::vector<std::string>(std::begin(DB_OPTIONS_NAMES), std::end(DB_OPTIONS_NAMES)), ", "));
+            return false;
+        }
+        CDBOptions dbopts;
+        if (!ParseDBOptions(strOptions, dbopts, strError))
+            return false;
+    }
+    return true;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBOptions& dbopts)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.write_buffer_size = dbopts.nWriteBufferSize ? dbopts.nWriteBufferSize : nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    options.block_size = dbopts.nBlockSize;
+    options.max_file_size = dbopts.nMaxFileSize;
+    options.filter_policy = dbopts.nBloomBits ? leveldb::NewBloomFilterPolicy(dbopts.nBloomBits) : nullptr;
     options.compression = leveldb::kNoCompression;
     options.max_open_files = 64;
     options.info_log = new CBitcoinLevelDBLogger();
@@ -88,14 +180,14 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBOptions& dbopts)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dbopts);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -109,6 +201,8 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
         TryCreateDirectories(path);
         LogPrintf("Opening LevelDB in %s\n", path.string());
     }
+    LogPrint(BCLog::LEVELDB, "LevelDB options: block size %u, bloom bits %d, write buffer %u, file size %u\n",
+        options.block_size, dbopts.nBloomBits, options.write_buffer_size, options.max_file_size);
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
@@ -27,6 +27,36 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB table and compaction settings of one database. Each database has
+ * a built-in profile, see GetDBOptions; a default constructed CDBOptions is
+ * the upstream configuration.
+ */
+struct CDBOptions
+{
+    //! Uncompressed size of a table block in bytes. Point reads decode a
+    //! whole block, sequential scans pay the per-block overhead.
+    size_t nBlockSize;
+    //! Bloom filter bits per key, 0 for no filter
+    int nBloomBits;
+    //! Memtable size in bytes, 0 for a quarter of the cache size
+    size_t nWriteBufferSize;
+    //! Table file size in bytes. Compactions work on whole files, so larger
+    //! files mean fewer and longer compactions and fewer open files.
+    size_t nMaxFileSize;
+
+    CDBOptions() : nBlockSize(4096), nBloomBits(10), nWriteBufferSize(0), nMaxFileSize(2 << 20) {}
+};
+
+/**
+ * The options of database strName ("chainstate", "index", "address", "spent"
+ * or "algostats"): its built-in profile with the -dbopts values for it applied.
+ */
+CDBOptions GetDBOptions(const std::string& strName);
+
+/** Check the -dbopts values, "<db>:<option>=<n>[,<option>=<n>...]" */
+bool CheckDBOptions(std::string& strError);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -217,8 +247,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] dbopts      LevelDB table and compaction settings.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBOptions& dbopts = CDBOptions());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -29,16 +29,16 @@
 #include <crypto/algos/honeycomb/hash_honeycomb.h>
 #include <crypto/algos/allium/allium.h>
 #include <uint256.h>
+#include <crypto/common.h>
 #include <hash.h>
 #include <version.h>
 
 
 uint256 CMultihasher::GetSHA256Hash() const
 {
-    CHashWriter ss(nType, nVersion);
-    for(size_t i = 0; i < buf.size(); i++)
-        ss << buf[i];
-    return ss.GetHash();
+    uint256 result;
+    CHash256().Write(buf.data(), buf.size()).Finalize(result.begin());
+    return result;
 }
 
 uint256 CMultihasher::GetHash() const 
@@ -360,4 +360,29 @@ uint256 CMultihasher::GetHash() const
 int LoadMultiHasherVersionFlags(bool fHardfork3Activated)
 {
     return fHardfork3Activated ? PROTOCOL_VERSION | MULTIHASHER_YESCRYPT_R8_NEW : PROTOCOL_VERSION;
-}
\ No newline at end of file
+}
+
+CHeaderNonceHasher::CHeaderNonceHasher(const unsigned char* pHeader, uint8_t nAlgoIn, int nVersionIn)
+    : nAlgo(nAlgoIn), hasher(SER_GETHASH, nVersionIn, nAlgoIn)
+{
+    memcpy(header, pHeader, HEADER_SIZE);
+    if (nAlgo == ALGO_SHA256D)
+        midstate.Write(header, NONCE_OFFSET);
+}
+
+uint256 CHeaderNonceHasher::GetHash(uint32_t nNonce)
+{
+    unsigned char vchNonce[4];
+    WriteLE32(vchNonce, nNonce);
+
+    uint256 result;
+    if (nAlgo == ALGO_SHA256D) {
+        CHash256(midstate).Write(vchNonce, sizeof(vchNonce)).Finalize(result.begin());
+        return result;
+    }
+
+    memcpy(header + NONCE_OFFSET, vchNonce, sizeof(vchNonce));
+    hasher.clear();
+    hasher.write((const char*)header, HEADER_SIZE);
+    return hasher.GetHash();
+}
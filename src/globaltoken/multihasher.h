@@ -8,6 +8,7 @@
 #define GLOBALTOKEN_MULTIHASHER_H
 
 #include <globaltoken/powalgorithm.h>
+#include <hash.h>
 #include <serialize.h>
 #include <version.h>
 #include <uint256.h>
@@ -37,6 +38,11 @@ public:
         buf.insert(buf.end(), pch, pch + size);
     }
 
+    /** Drop the written data but keep the buffer, so one hasher can be reused for many headers */
+    void clear() {
+        buf.clear();
+    }
+
     uint256 GetHash() const;
 
     template<typename T>
@@ -58,4 +64,30 @@ uint256 SerializeMultiAlgoHash(const T& obj, uint8_t nAlgo, int nType=SER_GETHAS
 
 int LoadMultiHasherVersionFlags(bool fHardfork3Activated);
 
+/**
+ * Computes the proof of work hash of an 80 byte header for many nonces.
+ * The nonce is the last field of the header, so for sha256d the first 64 byte
+ * block is compressed once up front and every nonce only costs the second
+ * block and the outer hash. The sph based algos use 128 byte blocks and
+ * cannot start compressing before the nonce is known; they hash the patched
+ * header without reserializing it.
+ */
+class CHeaderNonceHasher
+{
+public:
+    static const size_t HEADER_SIZE = 80;
+    static const size_t NONCE_OFFSET = 76;
+
+    CHeaderNonceHasher(const unsigned char* pHeader, uint8_t nAlgoIn, int nVersionIn);
+
+    uint256 GetHash(uint32_t nNonce);
+
+private:
+    const uint8_t nAlgo;
+    unsigned char header[HEADER_SIZE];
+    //! sha256d state after the constant part of the header
+    CHash256 midstate;
+    CMultihasher hasher;
+};
+
 #endif // GLOBALTOKEN_MULTIHASHER_H
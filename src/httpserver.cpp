@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <atomic>
 #include <future>
 
 #include <event2/thread.h>
@@ -437,6 +438,72 @@ bool StartHTTPServer()
     return true;
 }
 
+namespace {
+
+/** Shared between the caller of HTTPParallelFor and its helper work items */
+struct HTTPParallelJob
+{
+    std::function<void(size_t)> func;
+    size_t nCount;
+    std::atomic<size_t> nNext;
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nDone;
+
+    HTTPParallelJob(const std::function<void(size_t)>& funcIn, size_t nCountIn) : func(funcIn), nCount(nCountIn), nNext(0), nDone(0) {}
+
+    /** Run items until none are left; returns once this thread has nothing more to do */
+    void Work()
+    {
+        size_t i;
+        while ((i = nNext++) < nCount) {
+            func(i);
+            std::lock_guard<std::mutex> lock(cs);
+            if (++nDone == nCount)
+                cond.notify_all();
+        }
+    }
+};
+
+class HTTPParallelWorkItem final : public HTTPClosure
+{
+public:
+    explicit HTTPParallelWorkItem(std::shared_ptr<HTTPParallelJob> _job) : job(std::move(_job)) {}
+    void operator()() override
+    {
+        job->Work();
+    }
+
+private:
+    std::shared_ptr<HTTPParallelJob> job;
+};
+
+} // namespace
+
+void HTTPParallelFor(size_t nCount, const std::function<void(size_t)>& func)
+{
+    if (nCount == 0)
+        return;
+    std::shared_ptr<HTTPParallelJob> job = std::make_shared<HTTPParallelJob>(func, nCount);
+
+    // The calling thread works on the job as well, so it finishes even when
+    // every other worker is busy or the queue is full. Helpers that start
+    // after the last item was claimed return straight away.
+    if (workQueue) {
+        const size_t nHelpers = std::min(nCount, g_thread_http_workers.size()) - 1;
+        for (size_t i = 0; i < nHelpers; i++) {
+            std::unique_ptr<HTTPParallelWorkItem> item(new HTTPParallelWorkItem(job));
+            if (!workQueue->Enqueue(item.get()))
+                break;
+            item.release();
+        }
+    }
+
+    job->Work();
+    std::unique_lock<std::mutex> lock(job->cs);
+    job->cond.wait(lock, [&job]{ return job->nDone == job->nCount; });
+}
+
 void InterruptHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Interrupting HTTP server\n");
@@ -574,6 +641,15 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+void HTTPRequest::WriteReplyData(const char* data, size_t size)
+{
+    assert(!replySent && req);
+    // The output buffer is not touched by the main thread until WriteReply
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    evbuffer_add(evb, data, size);
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
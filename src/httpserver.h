@@ -46,6 +46,12 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Run func(0) .. func(nCount - 1) on the HTTP worker threads, including the
+ * calling one, and return when all calls have finished. Meant to be called
+ * from a request handler; func must not throw.
+ */
+void HTTPParallelFor(size_t nCount, const std::function<void(size_t)>& func);
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -105,6 +111,15 @@ public:
      */
     void WriteHeader(const std::string& hdr, const std::string& value);
 
+    /**
+     * Append data to the body of the reply, ahead of anything passed to
+     * WriteReply. Lets large replies be produced piecewise instead of being
+     * built up in a single string first.
+     *
+     * @note call this before calling WriteReply.
+     */
+    void WriteReplyData(const char* data, size_t size);
+
     /**
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
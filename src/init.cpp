@@ -12,7 +12,9 @@
 
 #include <init.h>
 
+#include <addressindex.h>
 #include <addrman.h>
+#include <algostats.h>
 #include <amount.h>
 #include <base58.h>
 #include <chain.h>
@@ -46,6 +48,7 @@
 #include <ui_interface.h>
 #include <util.h>
 #include <utilmoneystr.h>
+#include <utxosnapshot.h>
 #include <validationinterface.h>
 #ifdef ENABLE_TREASURY
 #include <globaltoken/treasury.h>
@@ -225,6 +228,8 @@ void Shutdown()
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    // Queued messages keep references to nodes, which CConnman::Stop() deletes
+    StopMessageWorkers();
     if (g_connman) g_connman->Stop();
     peerLogic.reset();
     g_connman.reset();
@@ -295,6 +300,9 @@ void Shutdown()
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
+        paddressindex.reset();
+        pspentindex.reset();
+        palgostatsindex.reset();
     }
 #ifdef ENABLE_WALLET
     StopWallets();
@@ -361,12 +369,15 @@ static void registerSignalHandler(int signal, void(*handler)(int))
 void OnRPCStarted()
 {
     uiInterface.NotifyBlockTip.connect(&RPCNotifyBlockChange);
+    uiInterface.NotifyHeaderTip.connect(&RPCNotifyHeaderChange);
 }
 
 void OnRPCStopped()
 {
     uiInterface.NotifyBlockTip.disconnect(&RPCNotifyBlockChange);
+    uiInterface.NotifyHeaderTip.disconnect(&RPCNotifyHeaderChange);
     RPCNotifyBlockChange(false, nullptr);
+    RPCNotifyHeaderChange(false, nullptr);
     cvBlockChange.notify_all();
     LogPrint(BCLog::RPC, "RPC stopped.\n");
 }
@@ -384,6 +395,8 @@ std::string HelpMessage(HelpMessageMode mode)
     std::string strUsage = HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-?", _("Print this help message and exit"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an address index and an index of unspent outputs by address, used by the getaddressutxos and getaddressdeltas rpc calls. Built in the background when enabled on an existing datadir (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-algostatsindex", strprintf(_("Maintain per-algorithm block statistics, used by the getalgostats rpc call. Built in the background when enabled on an existing datadir (default: %u)"), DEFAULT_ALGOSTATSINDEX));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
@@ -402,10 +415,16 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
     }
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-dbopts=<db>:<option>=<n>[,...]", "Tune the LevelDB tables of database <db> (chainstate, index, address, spent or algostats). "
+            "Options are blocksize and writebuffer and filesize in bytes, and bloombits per key. Can be specified multiple times");
+    }
     strUsage += HelpMessageOpt("-debuglogfile=<file>", strprintf(_("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)"), DEFAULT_DEBUGLOGFILE));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-loadsnapshot=<file>", _("Start a new node from a UTXO set snapshot written by dumptxoutset and committed to in the chain parameters. "
+        "Headers are synced and checked as usual, blocks are only downloaded and validated after the snapshot base block. Incompatible with -txindex and the optional indexes"));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
@@ -423,6 +442,7 @@ std::string HelpMessage(HelpMessageMode mode)
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
+    strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain an index of the inputs spending each output, used by the getspentinfo rpc call. Built in the background when enabled on an existing datadir (default: %u)"), DEFAULT_SPENTINDEX));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -454,6 +474,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: %s (default: %s)"), GetSupportedSocketEventsModes(), DEFAULT_SOCKETEVENTS));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -480,6 +501,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashblockalgo=<address>", _("Enable publish hash block with its mining algorithm in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubmasternodestate=<address>", _("Enable publish masternode state changes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubpaymentvote=<address>", _("Enable publish masternode payment votes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubspork=<address>", _("Enable publish spork updates in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -503,6 +528,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-vbparams=deployment:start:end", "Use given start/end times for specified version bits deployment (regtest-only)");
+        strUsage += HelpMessageOpt("-snapshotcommitment=height:blockhash:utxohash:chaintx", "Accept UTXO snapshots at the given block with the given gettxoutsetinfo hash_serialized_2 (regtest-only)");
     }
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
         _("If <category> is not supplied or if <category> = 1, output all debugging information.") + " " + _("<category> can be:") + " " + ListLogCategories() + ".");
@@ -568,6 +594,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
+    strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads generate and generatetoaddress use to search for a proof of work (-1 = all cores, default: %d)"), DEFAULT_GENERATE_THREADS));
 		
     strUsage += HelpMessageOpt("-coinbasetxnaddress=<address>", _("If you mine with getblocktemplate coinbasetxn, you need to paste an address here. It will be used to generate the coinbasetxn"));
     strUsage += HelpMessageOpt("-enableequihash", _("Activate this option, to mine equihash based algorithms in this wallet. (default: disabled)"));
@@ -577,6 +604,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcauth=<userpw>", _("Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcuser. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcbind=<addr>[:port]", _("Bind to given address to listen for JSON-RPC connections. This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)"));
+    strUsage += HelpMessageOpt("-rpcmethodlimit=<method>:<n>", _("Allow at most <n> concurrent calls of <method>, further calls fail until one finishes; 0 removes the built-in limit. This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort()));
     strUsage += HelpMessageOpt("-rpcserialversion", strprintf(_("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"), DEFAULT_RPC_SERIALIZE_VERSION));
@@ -925,6 +953,7 @@ namespace { // Variables internal to initialization process only
 int nMaxConnections;
 int nUserMaxConnections;
 int nFD;
+SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
 ServiceFlags nLocalServices = ServiceFlags(NODE_NETWORK | NODE_NETWORK_LIMITED);
 
 } // namespace
@@ -1001,6 +1030,8 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex and -spentindex."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1009,13 +1040,21 @@ bool AppInitParameterInteraction()
         return InitError("Cannot set -bind or -whitebind together with -listen=0");
     }
 
+    std::string strSocketEventsMode = gArgs.GetArg("-socketevents", DEFAULT_SOCKETEVENTS);
+    if (!ParseSocketEventsMode(strSocketEventsMode, socketEventsMode)) {
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEventsMode, GetSupportedSocketEventsModes()));
+    }
+
     // Make sure enough file descriptors are available
     int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections = gArgs.GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    // (select() can not wait on descriptors beyond FD_SETSIZE, epoll can)
+    if (socketEventsMode == SOCKETEVENTS_SELECT) {
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    }
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1247,6 +1286,35 @@ bool AppInitParameterInteraction()
             }
         }
     }
+
+    if (gArgs.IsArgSet("-snapshotcommitment")) {
+        // Allow committing to UTXO snapshots for testing
+        if (!chainparams.MineBlocksOnDemand()) {
+            return InitError("UTXO snapshot commitments may only be added on regtest.");
+        }
+        for (const std::string& strCommitment : gArgs.GetArgs("-snapshotcommitment")) {
+            std::vector<std::string> vCommitmentParams;
+            boost::split(vCommitmentParams, strCommitment, boost::is_any_of(":"));
+            CSnapshotCommitment commitment;
+            if (vCommitmentParams.size() != 4 || !ParseInt32(vCommitmentParams[0], &commitment.nHeight) ||
+                !IsHex(vCommitmentParams[1]) || !IsHex(vCommitmentParams[2]) || !ParseUInt32(vCommitmentParams[3], &commitment.nChainTx)) {
+                return InitError("UTXO snapshot commitment malformed, expecting height:blockhash:utxohash:chaintx");
+            }
+            commitment.hashBlock = uint256S(vCommitmentParams[1]);
+            commitment.hashSerialized = uint256S(vCommitmentParams[2]);
+            AddSnapshotCommitment(commitment);
+        }
+    }
+
+    std::string strDBOptionsError;
+    if (!CheckDBOptions(strDBOptionsError))
+        return InitError(strDBOptionsError);
+
+    if (gArgs.IsArgSet("-loadsnapshot")) {
+        if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) || gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
+            gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) || gArgs.GetBoolArg("-algostatsindex", DEFAULT_ALGOSTATSINDEX))
+            return InitError(_("-loadsnapshot is incompatible with -txindex, -addressindex, -spentindex and -algostatsindex."));
+    }
     return true;
 }
 
@@ -1351,6 +1419,11 @@ bool AppInitMain()
 #ifdef ENABLE_WALLET
     RegisterWalletRPC(tableRPC);
 #endif
+    {
+        std::string strError;
+        if (!InitRPCMethodLimits(strError))
+            return InitError(strError);
+    }
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1515,6 +1588,16 @@ bool AppInitMain()
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nIndexDBCache = std::min(nTotalCache / 8, nMaxIndexDBCache << 20);
+    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+        nTotalCache -= nIndexDBCache;
+    if (gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+        nTotalCache -= nIndexDBCache;
+    int64_t nAlgoStatsDBCache = 0;
+    if (gArgs.GetBoolArg("-algostatsindex", DEFAULT_ALGOSTATSINDEX)) {
+        nAlgoStatsDBCache = std::min(nTotalCache / 16, nMaxAlgoStatsDBCache << 20);
+        nTotalCache -= nAlgoStatsDBCache;
+    }
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1523,6 +1606,10 @@ bool AppInitMain()
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+        LogPrintf("* Using %.1fMiB for each address/spent index database\n", nIndexDBCache * (1.0 / 1024 / 1024));
+    if (nAlgoStatsDBCache > 0)
+        LogPrintf("* Using %.1fMiB for algo stats index database\n", nAlgoStatsDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
@@ -1536,6 +1623,9 @@ bool AppInitMain()
         do {
             try {
                 UnloadBlockIndex();
+                // The RPC tip snapshots point into the index that was just unloaded
+                RPCNotifyBlockChange(true, nullptr);
+                RPCNotifyHeaderChange(true, nullptr);
                 pcoinsTip.reset();
                 pcoinsdbview.reset();
                 pcoinscatcher.reset();
@@ -1544,6 +1634,24 @@ bool AppInitMain()
                 pblocktree.reset();
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
 
+                // A UTXO snapshot that was being loaded when we stopped left a partial
+                // chainstate behind. Wipe it, so that the snapshot is loaded again.
+                bool fSnapshotInterrupted = false;
+                pblocktree->ReadFlag("snapshotloading", fSnapshotInterrupted);
+                if (fSnapshotInterrupted) {
+                    LogPrintf("Loading the UTXO snapshot did not complete, wiping the chainstate\n");
+                    pblocktree->EraseSnapshotBase();
+                }
+                paddressindex.reset();
+                pspentindex.reset();
+                if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+                    paddressindex.reset(new CAddressIndexDB(nIndexDBCache, false, fReset));
+                if (gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+                    pspentindex.reset(new CSpentIndexDB(nIndexDBCache, false, fReset));
+                palgostatsindex.reset();
+                if (gArgs.GetBoolArg("-algostatsindex", DEFAULT_ALGOSTATSINDEX))
+                    palgostatsindex.reset(new CAlgoStatsIndexDB(nAlgoStatsDBCache, false, fReset));
+
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
                     //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
@@ -1568,6 +1676,14 @@ bool AppInitMain()
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
                     return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
+                {
+                    LOCK(cs_main);
+                    if ((paddressindex && !paddressindex->Init()) || (pspentindex && !pspentindex->Init()) || (palgostatsindex && !palgostatsindex->Init())) {
+                        strLoadError = _("Error loading the address, spent or algo stats index database");
+                        break;
+                    }
+                }
+
                 // Check for changed -txindex state
                 if (fTxIndex != gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
                     strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
@@ -1593,7 +1709,9 @@ bool AppInitMain()
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
-                pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
+                pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState || fSnapshotInterrupted));
+                if (fSnapshotInterrupted)
+                    pblocktree->WriteFlag("snapshotloading", false);
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
 
                 // If necessary, upgrade from older database format.
@@ -1746,6 +1864,22 @@ bool AppInitMain()
         }
     }
 
+    // A node started from a UTXO snapshot cannot serve the blocks below it
+    bool fLoadSnapshot = false;
+    {
+        LOCK(cs_main);
+        if (gArgs.IsArgSet("-loadsnapshot")) {
+            if (pindexSnapshotBase || chainActive.Height() > 0)
+                LogPrintf("Ignoring -loadsnapshot, the chainstate is already past genesis\n");
+            else
+                fLoadSnapshot = true;
+        }
+        if (pindexSnapshotBase || fLoadSnapshot) {
+            LogPrintf("Unsetting NODE_NETWORK when started from a UTXO snapshot\n");
+            nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+        }
+    }
+
     if (chainparams.GetConsensus().vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout != 0) {
         // Only advertise witness capabilities if they have a reasonable start time.
         // This allows us to have the code merged without a defined softfork, by setting its
@@ -1778,6 +1912,13 @@ bool AppInitMain()
 
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
+    if (fLoadSnapshot)
+        StartLoadUTXOSnapshot(threadGroup, fs::path(gArgs.GetArg("-loadsnapshot", "")));
+
+    // Indexes enabled on an existing datadir catch up in the background
+    if (paddressindex || pspentindex || palgostatsindex)
+        threadGroup.create_thread(&ThreadSyncIndexes);
+
     // Wait for genesis block to be processed
     {
         WaitableLock lock(cs_GenesisWait);
@@ -1951,6 +2092,7 @@ bool AppInitMain()
     connOptions.m_msgproc = peerLogic.get();
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.socketEventsMode = socketEventsMode;
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
@@ -1992,6 +2134,7 @@ bool AppInitMain()
             connOptions.m_specified_outgoing = connect;
         }
     }
+    StartMessageWorkers(connman);
     if (!connman.Start(scheduler, connOptions)) {
         return false;
     }
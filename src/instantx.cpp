@@ -21,11 +21,7 @@
 #include <consensus/validation.h>
 #include <validationinterface.h>
 #include <warnings.h>
-#ifdef ENABLE_WALLET
-#include <wallet/wallet.h>
-#endif // ENABLE_WALLET
 
-#include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 
 extern CTxMemPool mempool;
@@ -69,7 +65,7 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
         uint256 nVoteHash = vote.GetHash();
 
-        pfrom->setAskFor.erase(nVoteHash);
+        pfrom->RemoveAskFor(nVoteHash);
 
         // Ignore any InstantSend messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) return;
@@ -88,15 +84,10 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman)
 {
-    LOCK(cs_main);
-            
-#ifdef ENABLE_WALLET
-    for (CWalletRef pwallet : vpwallets) {
-        LOCK(pwallet->cs_wallet);
-#endif
-        LOCK2(mempool.cs, cs_instantsend);
+    uint256 txHash = txLockRequest.GetHash();
 
-        uint256 txHash = txLockRequest.GetHash();
+    {
+        LOCK(cs_instantsend);
 
         // Check to see if we conflict with existing completed lock
         for (const auto& txin : txLockRequest.tx->vin) {
@@ -133,20 +124,10 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
         // Masternodes will sometimes propagate votes before the transaction is known to the client.
         // If this just happened - process orphan votes, lock inputs, resolve conflicting locks,
         // update transaction status forcing external script/zmq notifications.
-#ifdef ENABLE_WALLET
-        ProcessOrphanTxLockVotes(pwallet);
-#else
         ProcessOrphanTxLockVotes();
-#endif
-        std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-#ifdef ENABLE_WALLET
-        TryToFinalizeLockCandidate(itLockCandidate->second, pwallet);
-#else
-        TryToFinalizeLockCandidate(itLockCandidate->second);
-#endif
-#ifdef ENABLE_WALLET
     }
-#endif
+
+    TryToFinalizeLockCandidate(txHash);
     return true;
 }
 
@@ -200,32 +181,16 @@ void CInstantSend::CreateEmptyTxLockCandidate(const uint256& txHash)
 void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
 {
     AssertLockHeld(cs_main);
-#ifdef ENABLE_WALLET
-    for (CWalletRef pwallet : vpwallets) {
-        LOCK(pwallet->cs_wallet);
-#endif
-
-        CTxLockRequest dummyRequest;
-        CTxLockCandidate txLockCandidate(dummyRequest);
-        {
-            LOCK(cs_instantsend);
-            auto itLockCandidate = mapTxLockCandidates.find(txHash);
-            if (itLockCandidate == mapTxLockCandidates.end()) return;
-            txLockCandidate = itLockCandidate->second;
-            Vote(txLockCandidate, connman);
-        }
 
-        // Let's see if our vote changed smth
-        LOCK2(mempool.cs, cs_instantsend);
-#ifdef ENABLE_WALLET
-        TryToFinalizeLockCandidate(txLockCandidate, pwallet);
-#else
-        TryToFinalizeLockCandidate(txLockCandidate);
-#endif
-    
-#ifdef ENABLE_WALLET
+    {
+        LOCK(cs_instantsend);
+        auto itLockCandidate = mapTxLockCandidates.find(txHash);
+        if (itLockCandidate == mapTxLockCandidates.end()) return;
+        Vote(itLockCandidate->second, connman);
     }
-#endif
+
+    // Let's see if our vote changed smth
+    TryToFinalizeLockCandidate(txHash);
 }
 
 void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
@@ -345,12 +310,10 @@ bool CInstantSend::ProcessNewTxLockVote(CNode* pfrom, const CTxLockVote& vote, C
     // relay valid vote asap
     vote.Relay(connman);
 
-    LOCK(cs_main);
-#ifdef ENABLE_WALLET
-    for (CWalletRef pwallet : vpwallets) {
-        LOCK(pwallet->cs_wallet);
-#endif
-        LOCK2(mempool.cs, cs_instantsend);
+    {
+        // Votes are accumulated under cs_instantsend alone, cs_main and
+        // mempool.cs are only needed once a lock is ready to complete.
+        LOCK(cs_instantsend);
 
         // Masternodes will sometimes propagate votes before the transaction is known to the client,
         // will actually process only after the lock request itself has arrived
@@ -408,30 +371,14 @@ bool CInstantSend::ProcessNewTxLockVote(CNode* pfrom, const CTxLockVote& vote, C
         int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
         LogPrint(BCLog::INSTANTSEND, "CInstantSend::%s -- Transaction Lock signatures count: %d/%d, vote hash=%s\n", __func__,
                 nSignatures, nSignaturesMax, nVoteHash.ToString());
-
-#ifdef ENABLE_WALLET
-        TryToFinalizeLockCandidate(txLockCandidate, pwallet);
-#else
-        TryToFinalizeLockCandidate(txLockCandidate);
-#endif
-#ifdef ENABLE_WALLET
     }
-#endif
+
+    TryToFinalizeLockCandidate(txHash);
     return true;
 }
 
-#ifdef ENABLE_WALLET
-bool CInstantSend::ProcessOrphanTxLockVote(const CTxLockVote& vote, CWallet *wallet)
-#else
 bool CInstantSend::ProcessOrphanTxLockVote(const CTxLockVote& vote)
-#endif
 {
-    // cs_main, cs_wallet and cs_instantsend should be already locked
-    AssertLockHeld(cs_main);
-#ifdef ENABLE_WALLET
-    if(wallet)
-        AssertLockHeld(wallet->cs_wallet);
-#endif
     AssertLockHeld(cs_instantsend);
 
     uint256 txHash = vote.GetTxHash();
@@ -502,22 +449,13 @@ void CInstantSend::UpdateVotedOutpoints(const CTxLockVote& vote, CTxLockCandidat
     }
 }
 
-#ifdef ENABLE_WALLET
-void CInstantSend::ProcessOrphanTxLockVotes(CWallet *wallet)
-#else
 void CInstantSend::ProcessOrphanTxLockVotes()
-#endif
 {
-    AssertLockHeld(cs_main);
     AssertLockHeld(cs_instantsend);
 
     std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
     while(it != mapTxLockVotesOrphan.end()) {
-#ifdef ENABLE_WALLET
-        if(ProcessOrphanTxLockVote(it->second, wallet)) {
-#else
         if(ProcessOrphanTxLockVote(it->second)) {
-#endif
             mapTxLockVotesOrphan.erase(it++);
         } else {
             ++it;
@@ -525,78 +463,44 @@ void CInstantSend::ProcessOrphanTxLockVotes()
     }
 }
 
-#ifdef ENABLE_WALLET
-void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate, CWallet *wallet)
-#else
-void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate)
-#endif
+void CInstantSend::TryToFinalizeLockCandidate(const uint256& txHash)
 {
     if(!sporkManager.IsSporkActive(SPORK_1_INSTANTSEND_ENABLED)) return;
 
-    AssertLockHeld(cs_main);
-    AssertLockHeld(cs_instantsend);
+    AssertLockNotHeld(cs_instantsend);
 
-    uint256 txHash = txLockCandidate.txLockRequest.tx->GetHash();
-    if(txLockCandidate.IsAllOutPointsReady() && !IsLockedInstantSendTransaction(txHash)) {
-        // we have enough votes now
-        LogPrint(BCLog::INSTANTSEND, "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
-        if(ResolveConflicts(txLockCandidate)) {
-            LockTransactionInputs(txLockCandidate);
-#ifdef ENABLE_WALLET
-            UpdateLockedTransaction(txLockCandidate, wallet);
-#else
-            UpdateLockedTransaction(txLockCandidate);
-#endif
-        }
-    }
-}
+    auto fnReadyToComplete = [this, &txHash]() -> const CTxLockCandidate* {
+        AssertLockHeld(cs_instantsend);
+        std::map<uint256, CTxLockCandidate>::const_iterator it = mapTxLockCandidates.find(txHash);
+        if(it == mapTxLockCandidates.end() || !it->second.txLockRequest) return nullptr;
+        if(!it->second.IsAllOutPointsReady() || IsLockedInstantSendTransaction(txHash)) return nullptr;
+        return &it->second;
+    };
 
-#ifdef ENABLE_WALLET
-void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate, CWallet *wallet)
-#else
-void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate)
-#endif
-{
-    // cs_main, cs_wallet and cs_instantsend should be already locked
-    AssertLockHeld(cs_main);
-    bool fIsWalletTX = false;
-#ifdef ENABLE_WALLET
-    if(wallet)
-        AssertLockHeld(wallet->cs_wallet);
-#endif
-    AssertLockHeld(cs_instantsend);
-
-    uint256 txHash = txLockCandidate.GetHash();
-
-    if(!IsLockedInstantSendTransaction(txHash)) return; // not a locked tx, do not update/notify
+    {
+        LOCK(cs_instantsend);
+        if(!fnReadyToComplete()) return;
+    }
 
-#ifdef ENABLE_WALLET
-        if(wallet) {
-        {
-            // Only notify UI if this transaction is in this wallet
-            std::map<uint256, CWalletTx>::const_iterator mi = wallet->mapWallet.find(txHash);
-            if (mi != wallet->mapWallet.end()){
-                wallet->NotifyTransactionChanged(wallet, txHash, CT_UPDATED);
-                fIsWalletTX = true;
-            }
-        }
-        if(fIsWalletTX)
-        {
-            // bumping this to update UI
-            nCompleteTXLocks++;
-            // notify an external script once threshold is reached
-            std::string strCmd = gArgs.GetArg("-instantsendnotify", "");
-            if(!strCmd.empty()) {
-                boost::replace_all(strCmd, "%s", txHash.GetHex());
-                boost::thread t(runCommand, strCmd); // thread runs free
-            }
-        }
+    // We have enough votes now. Checking for conflicts needs the chain and the mempool,
+    // so re-check under their locks, taken in the usual cs_main, mempool.cs, cs_instantsend order.
+    CTransactionRef txLocked;
+    {
+        LOCK2(cs_main, mempool.cs);
+        LOCK(cs_instantsend);
+        const CTxLockCandidate* pTxLockCandidate = fnReadyToComplete();
+        if(!pTxLockCandidate) return;
+        LogPrint(BCLog::INSTANTSEND, "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
+        if(!ResolveConflicts(*pTxLockCandidate)) return;
+        LockTransactionInputs(*pTxLockCandidate);
+        if(!IsLockedInstantSendTransaction(txHash)) return; // not a locked tx, do not notify
+        txLocked = pTxLockCandidate->txLockRequest.tx;
     }
-#endif
 
-    GetMainSignals().NotifyTransactionLock(MakeTransactionRef(std::move(*txLockCandidate.txLockRequest.tx)));
+    // Wallets, ZMQ and UI pick the lock up from the validation interface queue
+    GetMainSignals().NotifyTransactionLock(txLocked);
 
-    LogPrint(BCLog::INSTANTSEND, "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
+    LogPrint(BCLog::INSTANTSEND, "CInstantSend::TryToFinalizeLockCandidate -- done, txid=%s\n", txHash.ToString());
 }
 
 void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate)
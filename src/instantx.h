@@ -56,6 +56,8 @@ extern int nCompleteTXLocks;
  */
 class CInstantSend
 {
+    friend class CInstantSendTest; // for test access to mapTxLockCandidates and TryToFinalizeLockCandidate
+
 private:
     // Keep track of current block height
     int nCachedBlockHeight;
@@ -82,27 +84,13 @@ private:
     bool ProcessNewTxLockVote(CNode* pfrom, const CTxLockVote& vote, CConnman& connman);
 
     void UpdateVotedOutpoints(const CTxLockVote& vote, CTxLockCandidate& txLockCandidate);
-#ifdef ENABLE_WALLET
-    bool ProcessOrphanTxLockVote(const CTxLockVote& vote, CWallet *wallet);
-    void ProcessOrphanTxLockVotes(CWallet *wallet);
-#else
     bool ProcessOrphanTxLockVote(const CTxLockVote& vote);
     void ProcessOrphanTxLockVotes();
-#endif
     int64_t GetAverageMasternodeOrphanVoteTime();
 
-#ifdef ENABLE_WALLET
-    void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate, CWallet *wallet);
-#else
-    void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate);
-#endif
+    /// Complete the lock once all outpoints have enough votes. Must not be called with cs_instantsend held.
+    void TryToFinalizeLockCandidate(const uint256& txHash);
     void LockTransactionInputs(const CTxLockCandidate& txLockCandidate);
-    /// Update UI and notify external script if any
-#ifdef ENABLE_WALLET
-    void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate, CWallet *wallet);
-#else
-    void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate);
-#endif
     bool ResolveConflicts(const CTxLockCandidate& txLockCandidate);
 
     bool IsInstantSendReadyToLock(const uint256 &txHash);
@@ -0,0 +1,138 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <jsonwriter.h>
+
+#include <tinyformat.h>
+
+#include <univalue.h>
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(Sink sinkIn, size_t nFlushSizeIn)
+    : sink(sinkIn), nFlushSize(nFlushSizeIn), fAfterKey(false)
+{
+    buffer.reserve(nFlushSize + 256);
+}
+
+void CJSONStreamWriter::BeginValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vHasElement.empty()) {
+        if (vHasElement.back())
+            buffer += ',';
+        vHasElement.back() = true;
+    }
+}
+
+void CJSONStreamWriter::Append(const std::string& str)
+{
+    buffer += str;
+    if (buffer.size() >= nFlushSize)
+        Flush();
+}
+
+void CJSONStreamWriter::AppendString(const std::string& str)
+{
+    // Same escaping as UniValue (see univalue_escapes.h)
+    buffer += '"';
+    for (const char c : str) {
+        const unsigned char ch = c;
+        switch (ch) {
+        case '"': buffer += "\\\""; break;
+        case '\\': buffer += "\\\\"; break;
+        case '\b': buffer += "\\b"; break;
+        case '\t': buffer += "\\t"; break;
+        case '\n': buffer += "\\n"; break;
+        case '\f': buffer += "\\f"; break;
+        case '\r': buffer += "\\r"; break;
+        default:
+            if (ch < 0x20 || ch == 0x7f)
+                buffer += strprintf("\\u%04x", ch);
+            else
+                buffer += c;
+        }
+    }
+    buffer += '"';
+    if (buffer.size() >= nFlushSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    buffer += '{';
+    vHasElement.push_back(false);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vHasElement.empty() && !fAfterKey);
+    vHasElement.pop_back();
+    Append("}");
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    buffer += '[';
+    vHasElement.push_back(false);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vHasElement.empty() && !fAfterKey);
+    vHasElement.pop_back();
+    Append("]");
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    assert(!fAfterKey);
+    BeginValue();
+    AppendString(key);
+    buffer += ':';
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const std::string& str)
+{
+    BeginValue();
+    AppendString(str);
+}
+
+void CJSONStreamWriter::Value(int64_t n)
+{
+    BeginValue();
+    Append(strprintf("%d", n));
+}
+
+void CJSONStreamWriter::Value(uint64_t n)
+{
+    BeginValue();
+    Append(strprintf("%d", n));
+}
+
+void CJSONStreamWriter::Value(bool f)
+{
+    BeginValue();
+    Append(f ? "true" : "false");
+}
+
+void CJSONStreamWriter::Value(const UniValue& val)
+{
+    BeginValue();
+    Append(val.write());
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (buffer.empty())
+        return;
+    sink(buffer.data(), buffer.size());
+    buffer.clear();
+}
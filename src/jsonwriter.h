@@ -0,0 +1,71 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONWRITER_H
+#define BITCOIN_JSONWRITER_H
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class UniValue;
+
+/**
+ * Writes JSON piecewise to a sink instead of building a UniValue tree first.
+ * Output is identical to UniValue::write() without indentation, so the two
+ * can be mixed: small subtrees may still be passed in as UniValue.
+ *
+ * The caller is responsible for well-formedness: every value inside an
+ * object must be preceded by Key().
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef std::function<void(const char* data, size_t size)> Sink;
+
+    //! Output is buffered and handed to the sink in chunks of about this size
+    static const size_t DEFAULT_FLUSH_SIZE = 1 << 16;
+
+    explicit CJSONStreamWriter(Sink sinkIn, size_t nFlushSizeIn = DEFAULT_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const std::string& key);
+
+    void Value(const std::string& str);
+    void Value(const char* str) { Value(std::string(str)); }
+    void Value(int64_t n);
+    void Value(int n) { Value((int64_t)n); }
+    void Value(uint64_t n);
+    void Value(bool f);
+    void Value(const UniValue& val);
+
+    //! Shorthand for Key() followed by Value()
+    template <typename T>
+    void KV(const std::string& key, const T& val)
+    {
+        Key(key);
+        Value(val);
+    }
+
+    /** Hand everything written so far to the sink */
+    void Flush();
+
+private:
+    void BeginValue();
+    void Append(const std::string& str);
+    void AppendString(const std::string& str);
+
+    Sink sink;
+    const size_t nFlushSize;
+    std::string buffer;
+    //! One entry per open object or array: whether it already has an element
+    std::vector<bool> vHasElement;
+    bool fAfterKey;
+};
+
+#endif // BITCOIN_JSONWRITER_H
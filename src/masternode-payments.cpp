@@ -14,6 +14,7 @@
 #include <netmessagemaker.h>
 #include <spork.h>
 #include <util.h>
+#include <validationinterface.h>
 
 #include <boost/lexical_cast.hpp>
 
@@ -24,7 +25,7 @@ CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapMasternodeBlocks;
 CCriticalSection cs_mapMasternodePaymentVotes;
 
-bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward)
+bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, const CCoinbasePayees& payees, bool fMasternodePaid)
 {
     if(!masternodeSync.IsSynced() || fLiteMode) {
         //there is no budget data to use to check anything, let's just accept the longest chain
@@ -32,11 +33,15 @@ bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount bloc
         return true;
     }
 
-    if(mnpayments.IsTransactionValid(txNew, nBlockHeight)) {
+    // if we don't have at least MNPAYMENTS_SIGNATURES_REQUIRED signatures on a payee, approve whichever is the longest chain
+    if(!payees.fMasternodeRequired || fMasternodePaid) {
         LogPrint(BCLog::MNPAYMENTS, "IsBlockPayeeValid -- Valid masternode payment at height %d: %s", nBlockHeight, txNew.ToString());
         return true;
     }
 
+    LogPrintf("IsBlockPayeeValid -- ERROR: Missing required payment, possible payees: '%s', amount: %f GLT\n",
+                payees.GetMasternodePayeesString(), (float)GetMasternodePayment(nBlockHeight, txNew.GetValueOut())/COIN);
+
     if(sporkManager.IsSporkActive(SPORK_5_MASTERNODE_PAYMENT_ENFORCEMENT)) {
         LogPrintf("IsBlockPayeeValid -- ERROR: Invalid masternode payment detected at height %d: %s", nBlockHeight, txNew.ToString());
         return false;
@@ -46,9 +51,9 @@ bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount bloc
     return true;
 }
 
-void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutMasternodeRet)
+void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, const CCoinbasePayees& payees, CTxOut& txoutMasternodeRet)
 {
-    mnpayments.FillBlockPayee(txNew, nBlockHeight, blockReward, txoutMasternodeRet);
+    mnpayments.FillBlockPayee(txNew, nBlockHeight, blockReward, payees, txoutMasternodeRet);
     LogPrint(BCLog::MNPAYMENTS, "FillBlockPayments -- nBlockHeight %d blockReward %lld txoutMasternodeRet %s txNew %s",
                             nBlockHeight, blockReward, txoutMasternodeRet.ToString(), txNew.ToString());
 }
@@ -58,11 +63,57 @@ std::string GetRequiredPaymentsString(int nBlockHeight)
     return mnpayments.GetRequiredPaymentsString(nBlockHeight);
 }
 
+SaltedScriptHasher::SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+CCoinbasePayees::CCoinbasePayees(int nHeightIn) :
+    nHeight(nHeightIn),
+    scriptTreasury(Params().GetFoundersRewardScriptAtHeight(nHeightIn, false)),
+    scriptTreasuryBridge(Params().GetFoundersRewardScriptAtHeight(nHeightIn, true)),
+    fMasternodeRequired(false)
+{
+    AddPayee(scriptTreasury, PAYEE_TREASURY);
+    AddPayee(scriptTreasuryBridge, PAYEE_TREASURY_BRIDGE);
+}
+
+void CCoinbasePayees::CheckCoinbase(const CTransaction& txCoinbase, CAmount nTreasuryAmount, bool fUseBridgeAddress, bool& fTreasuryPaidRet, bool& fMasternodePaidRet) const
+{
+    const int nTreasuryFlag = fUseBridgeAddress ? PAYEE_TREASURY_BRIDGE : PAYEE_TREASURY;
+    const CAmount nMasternodePayment = GetMasternodePayment(nHeight, txCoinbase.GetValueOut());
+
+    fTreasuryPaidRet = false;
+    fMasternodePaidRet = false;
+    for (const auto& txout : txCoinbase.vout) {
+        const auto it = mapPayees.find(txout.scriptPubKey);
+        if (it == mapPayees.end())
+            continue;
+        if ((it->second & nTreasuryFlag) && txout.nValue == nTreasuryAmount)
+            fTreasuryPaidRet = true;
+        if ((it->second & PAYEE_MASTERNODE) && txout.nValue == nMasternodePayment)
+            fMasternodePaidRet = true;
+    }
+}
+
+std::string CCoinbasePayees::GetMasternodePayeesString() const
+{
+    std::string strPayees;
+    for (const auto& payee : mapPayees) {
+        if (!(payee.second & PAYEE_MASTERNODE))
+            continue;
+        CTxDestination address;
+        ExtractDestination(payee.first, address);
+        if (!strPayees.empty())
+            strPayees += ",";
+        strPayees += EncodeDestination(address);
+    }
+    return strPayees;
+}
+
 void CMasternodePayments::Clear()
 {
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+    coinbasePayeesCache.reset();
 }
 
 bool CMasternodePayments::UpdateLastVote(const CMasternodePaymentVote& vote)
@@ -88,14 +139,14 @@ bool CMasternodePayments::UpdateLastVote(const CMasternodePaymentVote& vote)
 *   Fill Masternode ONLY payment block
 */
 
-void CMasternodePayments::FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutMasternodeRet) const
+void CMasternodePayments::FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, const CCoinbasePayees& payees, CTxOut& txoutMasternodeRet) const
 {
     // make sure it's not filled yet
     txoutMasternodeRet = CTxOut();
 
-    CScript payee;
+    CScript payee = payees.scriptBestPayee;
 
-    if(!GetBlockPayee(nBlockHeight, payee)) {
+    if(payee.empty()) {
         // no masternode detected...
         int nCount = 0;
         masternode_info_t mnInfo;
@@ -179,7 +230,7 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, const std::string& strCom
 
         uint256 nHash = vote.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        pfrom->RemoveAskFor(nHash);
 
         // TODO: clear setAskFor for MSG_MASTERNODE_PAYMENT_BLOCK too
 
@@ -357,7 +408,12 @@ bool CMasternodePayments::AddOrUpdatePaymentVote(const CMasternodePaymentVote& v
     auto it = mapMasternodeBlocks.emplace(vote.nBlockHeight, CMasternodeBlockPayees(vote.nBlockHeight)).first;
     it->second.AddPayee(vote);
 
+    if(coinbasePayeesCache && coinbasePayeesCache->nHeight == vote.nBlockHeight) {
+        coinbasePayeesCache.reset();
+    }
+
     LogPrint(BCLog::MNPAYMENTS, "CMasternodePayments::AddOrUpdatePaymentVote -- added, hash=%s\n", nVoteHash.ToString());
+    GetMainSignals().NotifyPaymentVote(vote);
 
     return true;
 }
@@ -463,6 +519,24 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew) const
     return false;
 }
 
+void CMasternodeBlockPayees::FillCoinbasePayees(CCoinbasePayees& payees) const
+{
+    LOCK(cs_vecPayees);
+
+    // Same selection as GetBestPayee() and IsTransactionValid()
+    int nVotes = -1;
+    for (const auto& payee : vecPayees) {
+        if (payee.GetVoteCount() > nVotes) {
+            payees.scriptBestPayee = payee.GetPayee();
+            nVotes = payee.GetVoteCount();
+        }
+        if (payee.GetVoteCount() >= MNPAYMENTS_SIGNATURES_REQUIRED) {
+            payees.AddPayee(payee.GetPayee(), CCoinbasePayees::PAYEE_MASTERNODE);
+            payees.fMasternodeRequired = true;
+        }
+    }
+}
+
 std::string CMasternodeBlockPayees::GetRequiredPaymentsString() const
 {
     LOCK(cs_vecPayees);
@@ -502,6 +576,23 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
     return it == mapMasternodeBlocks.end() ? true : it->second.IsTransactionValid(txNew);
 }
 
+CCoinbasePayeesRef CMasternodePayments::GetCoinbasePayees(int nBlockHeight) const
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    if(coinbasePayeesCache && coinbasePayeesCache->nHeight == nBlockHeight) {
+        return coinbasePayeesCache;
+    }
+
+    std::shared_ptr<CCoinbasePayees> payees = std::make_shared<CCoinbasePayees>(nBlockHeight);
+    const auto it = mapMasternodeBlocks.find(nBlockHeight);
+    if(it != mapMasternodeBlocks.end()) {
+        it->second.FillCoinbasePayees(*payees);
+    }
+    coinbasePayeesCache = payees;
+    return coinbasePayeesCache;
+}
+
 void CMasternodePayments::CheckAndRemove()
 {
     if(!masternodeSync.IsBlockchainSynced()) return;
@@ -522,6 +613,7 @@ void CMasternodePayments::CheckAndRemove()
             ++it;
         }
     }
+    coinbasePayeesCache.reset();
     LogPrintf("CMasternodePayments::CheckAndRemove -- %s\n", ToString());
 }
 
@@ -928,4 +1020,7 @@ void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& c
 
     CheckBlockVotes(nFutureBlock - 1);
     ProcessBlock(nFutureBlock, connman);
+
+    // Precompute the expected payees of the next block for CreateNewBlock and ConnectBlock
+    GetCoinbasePayees(nCachedBlockHeight + 1);
 }
@@ -7,14 +7,19 @@
 
 #include <util.h>
 #include <core_io.h>
+#include <hash.h>
 #include <key.h>
 #include <masternode.h>
 #include <net_processing.h>
 #include <utilstrencodings.h>
 
+#include <memory>
+#include <unordered_map>
+
 class CMasternodePayments;
 class CMasternodePaymentVote;
 class CMasternodeBlockPayees;
+class CCoinbasePayees;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
@@ -28,15 +33,68 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_2 = 80002;
 
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
-extern CCriticalSection cs_mapMasternodePayeeVotes;
+extern CCriticalSection cs_mapMasternodePaymentVotes;
 
 extern CMasternodePayments mnpayments;
 
 /// TODO: all 4 functions do not belong here really, they should be refactored/moved somewhere (main.cpp ?)
-bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward);
-void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutMasternodeRet);
+bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, const CCoinbasePayees& payees, bool fMasternodePaid);
+void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, const CCoinbasePayees& payees, CTxOut& txoutMasternodeRet);
 std::string GetRequiredPaymentsString(int nBlockHeight);
 
+class SaltedScriptHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher();
+
+    size_t operator()(const CScript& script) const {
+        return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+    }
+};
+
+/**
+ * The coinbase payees expected at one height: the treasury scripts and the
+ * masternode payees that have enough votes to be enforced. Built once per
+ * height and shared by block assembly and ConnectBlock, so that checking a
+ * coinbase takes a single hash lookup per output.
+ */
+class CCoinbasePayees
+{
+public:
+    enum PayeeFlags {
+        PAYEE_TREASURY        = (1 << 0),
+        PAYEE_TREASURY_BRIDGE = (1 << 1),
+        PAYEE_MASTERNODE      = (1 << 2),
+    };
+
+    int nHeight;
+    CScript scriptTreasury;
+    CScript scriptTreasuryBridge;
+    //! Payee with the most votes, empty if there are no votes for this height
+    CScript scriptBestPayee;
+    //! Whether some payee has MNPAYMENTS_SIGNATURES_REQUIRED votes
+    bool fMasternodeRequired;
+    std::unordered_map<CScript, int, SaltedScriptHasher> mapPayees;
+
+    explicit CCoinbasePayees(int nHeightIn);
+
+    const CScript& GetTreasuryScript(bool fUseBridgeAddress) const {
+        return fUseBridgeAddress ? scriptTreasuryBridge : scriptTreasury;
+    }
+
+    void AddPayee(const CScript& script, int nFlags) { mapPayees[script] |= nFlags; }
+
+    /** Look for the treasury and the required masternode payment in a coinbase */
+    void CheckCoinbase(const CTransaction& txCoinbase, CAmount nTreasuryAmount, bool fUseBridgeAddress, bool& fTreasuryPaidRet, bool& fMasternodePaidRet) const;
+    std::string GetMasternodePayeesString() const;
+};
+
+typedef std::shared_ptr<const CCoinbasePayees> CCoinbasePayeesRef;
+
 class CMasternodePayee
 {
 private:
@@ -100,6 +158,7 @@ public:
     bool HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq) const;
 
     bool IsTransactionValid(const CTransaction& txNew) const;
+    void FillCoinbasePayees(CCoinbasePayees& payees) const;
 
     std::string GetRequiredPaymentsString() const;
 };
@@ -185,6 +244,9 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // Expected coinbase payees for the most recently requested height, protected by cs_mapMasternodeBlocks
+    mutable CCoinbasePayeesRef coinbasePayeesCache;
+
 public:
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -214,6 +276,7 @@ public:
 
     bool GetBlockPayee(int nBlockHeight, CScript& payeeRet) const;
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight) const;
+    CCoinbasePayeesRef GetCoinbasePayees(int nBlockHeight) const;
     bool IsScheduled(const masternode_info_t& mnInfo, int nNotBlockHeight) const;
 
     bool UpdateLastVote(const CMasternodePaymentVote& vote);
@@ -221,7 +284,7 @@ public:
     int GetMinMasternodePaymentsProto() const;
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
     std::string GetRequiredPaymentsString(int nBlockHeight) const;
-    void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutMasternodeRet) const;
+    void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, const CCoinbasePayees& payees, CTxOut& txoutMasternodeRet) const;
     std::string ToString() const;
 
     int GetBlockCount() const { return mapMasternodeBlocks.size(); }
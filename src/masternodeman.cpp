@@ -15,6 +15,8 @@
 #include <script/standard.h>
 #include <ui_interface.h>
 #include <util.h>
+#include <validation.h>
+#include <validationinterface.h>
 #include <warnings.h>
 
 /** Masternode manager */
@@ -76,6 +78,8 @@ bool CMasternodeMan::Add(CMasternode &mn)
 
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.outpoint] = mn;
+    // Collaterals are checked all the time, keep them in the coins cache
+    PinCoin(mn.outpoint);
     fMasternodesAdded = true;
     return true;
 }
@@ -138,6 +142,32 @@ void CMasternodeMan::Check()
         // since the last time, so expect some MNs to skip this
         mnpair.second.Check();
     }
+
+    NotifyStateChanges();
+}
+
+void CMasternodeMan::NotifyStateChanges()
+{
+    AssertLockHeld(cs);
+
+    for (const auto& mnpair : mapMasternodes) {
+        auto it = mapNotifiedStates.find(mnpair.first);
+        if (it != mapNotifiedStates.end() && it->second == mnpair.second.nActiveState)
+            continue;
+        mapNotifiedStates[mnpair.first] = mnpair.second.nActiveState;
+        GetMainSignals().NotifyMasternodeState(mnpair.first, mnpair.second.nActiveState);
+    }
+
+    // Removed masternodes are reported with a negative state
+    auto it = mapNotifiedStates.begin();
+    while (it != mapNotifiedStates.end()) {
+        if (mapMasternodes.count(it->first)) {
+            ++it;
+            continue;
+        }
+        GetMainSignals().NotifyMasternodeState(it->first, -1);
+        mapNotifiedStates.erase(it++);
+    }
 }
 
 void CMasternodeMan::CheckAndRemove(CConnman& connman)
@@ -315,6 +345,13 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
             }
         }
 
+        // Stop keeping the collaterals of removed masternodes in the coins cache
+        std::vector<COutPoint> vCollaterals;
+        vCollaterals.reserve(mapMasternodes.size());
+        for (const auto& mnpair : mapMasternodes)
+            vCollaterals.push_back(mnpair.first);
+        SetPinnedCoins(vCollaterals);
+
         LogPrintf("CMasternodeMan::CheckAndRemove -- %s\n", ToString());
     }
 
@@ -426,6 +463,46 @@ bool CMasternodeMan::Get(const COutPoint& outpoint, CMasternode& masternodeRet)
     return true;
 }
 
+bool CMasternodeMan::AlreadyHaveMasternodeBroadcast(const uint256& hash)
+{
+    LOCK(cs);
+    return mapSeenMasternodeBroadcast.count(hash) && !IsMnbRecoveryRequested(hash);
+}
+
+bool CMasternodeMan::GetSeenMasternodeBroadcast(const uint256& hash, CMasternodeBroadcast& mnbRet)
+{
+    LOCK(cs);
+    auto it = mapSeenMasternodeBroadcast.find(hash);
+    if (it == mapSeenMasternodeBroadcast.end()) {
+        return false;
+    }
+    mnbRet = it->second.second;
+    return true;
+}
+
+void CMasternodeMan::EraseSeenMasternodeBroadcast(const uint256& hash)
+{
+    LOCK(cs);
+    mapSeenMasternodeBroadcast.erase(hash);
+}
+
+bool CMasternodeMan::HasSeenMasternodePing(const uint256& hash)
+{
+    LOCK(cs);
+    return mapSeenMasternodePing.count(hash);
+}
+
+bool CMasternodeMan::GetSeenMasternodePing(const uint256& hash, CMasternodePing& mnpRet)
+{
+    LOCK(cs);
+    auto it = mapSeenMasternodePing.find(hash);
+    if (it == mapSeenMasternodePing.end()) {
+        return false;
+    }
+    mnpRet = it->second;
+    return true;
+}
+
 bool CMasternodeMan::GetMasternodeInfo(const COutPoint& outpoint, masternode_info_t& mnInfoRet)
 {
     LOCK(cs);
@@ -771,7 +848,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         CMasternodeBroadcast mnb;
         vRecv >> mnb;
 
-        pfrom->setAskFor.erase(mnb.GetHash());
+        pfrom->RemoveAskFor(mnb.GetHash());
 
         if(!masternodeSync.IsBlockchainSynced()) return;
 
@@ -797,7 +874,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
 
         uint256 nHash = mnp.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        pfrom->RemoveAskFor(nHash);
 
         if(!masternodeSync.IsBlockchainSynced()) return;
 
@@ -864,7 +941,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         CMasternodeVerification mnv;
         vRecv >> mnv;
 
-        pfrom->setAskFor.erase(mnv.GetHash());
+        pfrom->RemoveAskFor(mnv.GetHash());
 
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
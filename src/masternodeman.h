@@ -72,6 +72,9 @@ private:
     /// Set when masternodes are removed, cleared when CGovernanceManager is notified
     bool fMasternodesRemoved;
 
+    /// States last sent to the validation interface, not serialized
+    std::map<COutPoint, int> mapNotifiedStates;
+
     friend class CMasternodeSync;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
@@ -83,6 +86,9 @@ private:
 
     void PushDsegInvs(CNode* pnode, const CMasternode& mn);
 
+    /// Notify listeners of masternodes that were added, removed or changed state since the last call
+    void NotifyStateChanges();
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
@@ -198,6 +204,13 @@ public:
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos, CConnman& connman);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    /// Access the seen broadcast and ping maps from outside CMasternodeMan, under cs
+    bool AlreadyHaveMasternodeBroadcast(const uint256& hash);
+    bool GetSeenMasternodeBroadcast(const uint256& hash, CMasternodeBroadcast& mnbRet);
+    void EraseSeenMasternodeBroadcast(const uint256& hash);
+    bool HasSeenMasternodePing(const uint256& hash);
+    bool GetSeenMasternodePing(const uint256& hash, CMasternodePing& mnpRet);
+
     void UpdateLastPaid(const CBlockIndex* pindex);
 
     void CheckMasternode(const CPubKey& pubKeyMasternode, bool fForce);
@@ -14,8 +14,11 @@
 #include <consensus/tx_verify.h>
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
+#include <crypto/algos/equihash/equihash.h>
 #include <globaltoken/hardfork.h>
+#include <globaltoken/multihasher.h>
 #include <hash.h>
+#include <init.h>
 #include <validation.h>
 #include <net.h>
 #include <policy/feerate.h>
@@ -23,6 +26,7 @@
 #include <pow.h>
 #include <primitives/transaction.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <timedata.h>
 #include <util.h>
 #include <utilmoneystr.h>
@@ -31,7 +35,11 @@
 #include <validationinterface.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <queue>
+#include <thread>
 #include <utility>
 #include <inttypes.h>
 
@@ -192,13 +200,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     
     if(chainparams.GetConsensus().Hardfork1.IsActivated(pblock->nTime))
     {
+        // Same payee set ConnectBlock checks the coinbase against
+        CCoinbasePayeesRef payees = mnpayments.GetCoinbasePayees(nHeight);
         CAmount nTreasuryAmount = chainparams.GetTreasuryAmount(blockReward);
         coinbaseTx.vout[0].nValue -= nTreasuryAmount;
-        coinbaseTx.vout.push_back(CTxOut(nTreasuryAmount, chainparams.GetFoundersRewardScriptAtHeight(nHeight, chainparams.GetConsensus().Hardfork3.IsActivated(pblock->nTime))));
+        coinbaseTx.vout.push_back(CTxOut(nTreasuryAmount, payees->GetTreasuryScript(chainparams.GetConsensus().Hardfork3.IsActivated(pblock->nTime))));
         
         // Update coinbase transaction with additional info about masternode payments,
         // get some info back to pass to getblocktemplate
-        FillBlockPayments(coinbaseTx, nHeight, blockReward, pblock->txoutMasternode);
+        FillBlockPayments(coinbaseTx, nHeight, blockReward, *payees, pblock->txoutMasternode);
         // LogPrintf("CreateNewBlock -- nBlockHeight %d blockReward %lld txoutMasternode %s coinbaseTx %s",
         //             nHeight, GetBlockSubsidy(nHeight, chainparams.GetConsensus()), pblock->txoutMasternode.ToString(), coinbaseTx.ToString());
     }
@@ -508,3 +518,179 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+namespace {
+
+/** State shared by the worker threads of one SearchProofOfWork call */
+struct PoWSearchState
+{
+    std::atomic<bool> fStop;
+    std::atomic<int64_t> nTriesLeft;
+
+    CWaitableCriticalSection cs;
+    CConditionVariable condDone;
+    int nRunning;
+    bool fFound;
+    uint32_t nNonce;
+    uint256 nBigNonce;
+    std::vector<unsigned char> nSolution;
+
+    PoWSearchState(uint64_t nMaxTries, int nThreads)
+        : fStop(false), nTriesLeft(std::min<uint64_t>(nMaxTries, std::numeric_limits<int64_t>::max())),
+          nRunning(nThreads), fFound(false), nNonce(0) {}
+
+    /** Claim one try of the budget; false once the search should end */
+    bool NextTry()
+    {
+        return !fStop.load(std::memory_order_relaxed) && nTriesLeft.fetch_sub(1, std::memory_order_relaxed) > 0;
+    }
+
+    void SetFound(uint32_t nNonceIn, const uint256& nBigNonceIn, const std::vector<unsigned char>& nSolutionIn)
+    {
+        WaitableLock lock(cs);
+        if (fFound)
+            return;
+        fFound = true;
+        nNonce = nNonceIn;
+        nBigNonce = nBigNonceIn;
+        nSolution = nSolutionIn;
+        fStop = true;
+    }
+
+    void ThreadDone()
+    {
+        {
+            WaitableLock lock(cs);
+            --nRunning;
+        }
+        condDone.notify_all();
+    }
+};
+
+void SearchDefaultHeader(PoWSearchState& state, const CBlock& block, uint8_t nAlgo, int nHashVersion,
+                         const Consensus::Params& params, uint32_t nFirst, uint32_t nStride, uint32_t nNonceCount)
+{
+    // The nonce is the last field of the 80 byte header, serialize the rest once
+    std::vector<unsigned char> vHeader;
+    CVectorWriter(SER_GETHASH, nHashVersion, vHeader, 0, block.GetDefaultBlockHeader());
+    assert(vHeader.size() == CHeaderNonceHasher::HEADER_SIZE);
+    CHeaderNonceHasher hasher(vHeader.data(), nAlgo, nHashVersion);
+
+    for (uint64_t nNonce = nFirst; nNonce < nNonceCount && state.NextTry(); nNonce += nStride) {
+        if (CheckProofOfWork(hasher.GetHash(nNonce), block.nBits, params, nAlgo)) {
+            state.SetFound(nNonce, uint256(), std::vector<unsigned char>());
+            return;
+        }
+    }
+}
+
+void SearchEquihashHeader(PoWSearchState& state, const CBlock& block, uint8_t nAlgo, const CChainParams& chainparams,
+                          uint32_t nFirst, uint32_t nStride, uint32_t nNonceCount)
+{
+    const unsigned int n = chainparams.GetEquihashAlgoN(nAlgo);
+    const unsigned int k = chainparams.GetEquihashAlgoK(nAlgo);
+    CEquihashBlockHeader header = block.GetEquihashBlockHeader();
+
+    // H(I||... is the same for every nonce
+    eh_HashState eh_state;
+    EhInitialiseState(n, k, eh_state, GetEquihashBasedDefaultPersonalize(nAlgo));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << CEquihashInput{header};
+    crypto_generichash_blake2b_update(&eh_state, (unsigned char*)&ss[0], ss.size());
+
+    std::function<bool(std::vector<unsigned char>)> validBlock =
+            [&header, nAlgo, &chainparams](std::vector<unsigned char> soln) {
+        header.nSolution = soln;
+        return CheckProofOfWork(header.GetHash(), header.nBits, chainparams.GetConsensus(), nAlgo);
+    };
+    std::function<bool(EhSolverCancelCheck)> cancelled = [&state](EhSolverCancelCheck pos) {
+        return state.fStop.load(std::memory_order_relaxed);
+    };
+
+    // The template leaves the low 16 bits of the nonce clear for use as a counter
+    const arith_uint256 nBase = UintToArith256(header.nNonce);
+    for (uint64_t nCounter = nFirst; nCounter < nNonceCount && state.NextTry(); nCounter += nStride) {
+        header.nNonce = ArithToUint256(nBase + nCounter + 1);
+
+        // H(I||V||...
+        eh_HashState curr_state = eh_state;
+        crypto_generichash_blake2b_update(&curr_state, header.nNonce.begin(), header.nNonce.size());
+
+        try {
+            if (EhOptimisedSolve(n, k, curr_state, validBlock, cancelled)) {
+                state.SetFound(0, header.nNonce, header.nSolution);
+                return;
+            }
+        } catch (const EhSolverCancelledException&) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+PoWSearchResult SearchProofOfWork(CBlock& block, const CBlockIndex* pindexPrev, const CChainParams& chainparams, int nThreads, uint32_t nNonceCount, uint64_t& nMaxTries)
+{
+    const Consensus::Params& params = chainparams.GetConsensus();
+    // Before the first hardfork every block is sha256d
+    const bool fMultiAlgo = params.Hardfork1.IsActivated(block.nTime);
+    const uint8_t nAlgo = fMultiAlgo ? block.GetAlgo() : ALGO_SHA256D;
+    const bool fEquihash = fMultiAlgo && IsEquihashBasedAlgo(nAlgo);
+    const int nHashVersion = LoadMultiHasherVersionFlags(params.Hardfork3.IsActivated(block.nTime));
+    nThreads = std::max(1, nThreads);
+
+    PoWSearchState state(nMaxTries, nThreads);
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back([&, i]() {
+            RenameThread("globaltoken-pow");
+            if (fEquihash)
+                SearchEquihashHeader(state, block, nAlgo, chainparams, i, nThreads, nNonceCount);
+            else
+                SearchDefaultHeader(state, block, nAlgo, nHashVersion, params, i, nThreads, nNonceCount);
+            state.ThreadDone();
+        });
+    }
+
+    // Wait for the workers, cancelling them if the tip moves or the node shuts down
+    PoWSearchResult result = PoWSearchResult::EXHAUSTED;
+    {
+        WaitableLock lock(state.cs);
+        while (state.nRunning > 0) {
+            if (state.condDone.wait_for(lock, std::chrono::milliseconds(100)) != std::cv_status::timeout)
+                continue;
+            lock.unlock();
+            bool fStale;
+            {
+                LOCK(cs_main);
+                fStale = chainActive.Tip() != pindexPrev;
+            }
+            if (fStale || ShutdownRequested()) {
+                result = fStale ? PoWSearchResult::STALE : PoWSearchResult::SHUTDOWN;
+                state.fStop = true;
+            }
+            lock.lock();
+        }
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    const int64_t nTriesLeft = state.nTriesLeft;
+    const uint64_t nTried = nMaxTries - std::max<int64_t>(nTriesLeft, 0);
+    nMaxTries = std::max<int64_t>(nTriesLeft, 0);
+    LogPrint(BCLog::BENCH, "%s: %u tries on %d threads, %s\n", __func__, nTried, nThreads, state.fFound ? "found" : "not found");
+
+    if (state.fFound) {
+        if (fEquihash) {
+            block.nBigNonce = state.nBigNonce;
+            block.nSolution = state.nSolution;
+        } else {
+            block.nNonce = state.nNonce;
+        }
+        return PoWSearchResult::FOUND;
+    }
+    if (result == PoWSearchResult::EXHAUSTED && nMaxTries == 0)
+        return PoWSearchResult::MAX_TRIES;
+    return result;
+}
@@ -21,6 +21,8 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -genproclimit, the number of threads used by generate and generatetoaddress */
+static const int DEFAULT_GENERATE_THREADS = 1;
 
 struct CBlockTemplate
 {
@@ -196,4 +198,23 @@ private:
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev, uint8_t algo);
 
+/** Outcome of SearchProofOfWork */
+enum class PoWSearchResult {
+    FOUND,      //!< the block now carries a valid proof of work
+    EXHAUSTED,  //!< every nonce in the range was tried
+    MAX_TRIES,  //!< the nMaxTries budget is used up
+    STALE,      //!< the chain tip is no longer pindexPrev
+    SHUTDOWN,   //!< shutdown was requested
+};
+
+/**
+ * Search the first nNonceCount nonces of a block template for a valid proof
+ * of work, using nThreads threads that each try every nThreads-th nonce.
+ * Every thread serializes the header once and only patches the nonce
+ * afterwards; Equihash based algos use the cancellable optimised solver.
+ * On FOUND the nonce (and Equihash solution) are written into block.
+ * nMaxTries is decreased by the number of nonces tried.
+ */
+PoWSearchResult SearchProofOfWork(CBlock& block, const CBlockIndex* pindexPrev, const CChainParams& chainparams, int nThreads, uint32_t nNonceCount, uint64_t& nMaxTries);
+
 #endif // BITCOIN_MINER_H
@@ -28,6 +28,7 @@
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <set>
 
 #ifndef WIN32
 #include <arpa/inet.h>
@@ -56,6 +57,8 @@ static const unsigned int MAX_ADDR_TO_SEND = 1000;
 /* FIXME: Once the headers size limit is deployed sufficiently in the network,
    we may want to lower this again if it seems useful.  */
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 64 * 1000 * 1000;
+/** Maximum number of bytes kept in the pool of recycled receive buffers */
+static const size_t MAX_RECV_BUFFER_POOL_BYTES = 32 * 1024 * 1024;
 /** Maximum length of strSubVer in `version` message */
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 /** Maximum number of automatic outgoing nodes */
@@ -89,6 +92,17 @@ static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
+/** How ThreadSocketHandler waits for socket readiness (-socketevents) */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_EPOLL = 1,
+};
+#ifdef HAVE_EPOLL
+static const char* const DEFAULT_SOCKETEVENTS = "epoll";
+#else
+static const char* const DEFAULT_SOCKETEVENTS = "select";
+#endif
+
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
@@ -118,6 +132,34 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * A message that is serialized, framed and checksummed once, and can then
+ * be queued to any number of peers without being copied or hashed again.
+ */
+struct CSharedNetMsg
+{
+    explicit CSharedNetMsg(CSerializedNetMsg&& msg);
+
+    std::vector<unsigned char> data; // message header followed by the payload
+    std::string command;
+};
+typedef std::shared_ptr<const CSharedNetMsg> CSharedNetMsgRef;
+
+/** An entry of a node's send queue: either owned by the node, or a message shared with other peers */
+class CSendQueueEntry
+{
+public:
+    explicit CSendQueueEntry(std::vector<unsigned char>&& dataIn) : data(std::move(dataIn)) {}
+    explicit CSendQueueEntry(const CSharedNetMsgRef& msgIn) : msg(msgIn) {}
+
+    const unsigned char* begin() const { return msg ? msg->data.data() : data.data(); }
+    size_t size() const { return msg ? msg->data.size() : data.size(); }
+
+private:
+    std::vector<unsigned char> data;
+    CSharedNetMsgRef msg;
+};
+
 class NetEventsInterface;
 class CConnman
 {
@@ -142,6 +184,7 @@ public:
         NetEventsInterface* m_msgproc = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         std::vector<std::string> vSeedNodes;
@@ -163,6 +206,7 @@ public:
         m_msgproc = connOptions.m_msgproc;
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
+        socketEventsMode = connOptions.socketEventsMode;
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -225,6 +269,7 @@ public:
     bool IsMasternodeOrDisconnectRequested(const CService& addr);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsgRef& msg);
     
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
@@ -439,6 +484,11 @@ private:
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    void AddSocketEvents(CNode* pnode);
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#ifdef HAVE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set);
+#endif
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenMasternodeConnections();
@@ -495,6 +545,10 @@ private:
     unsigned int nSendBufferMaxSize;
     unsigned int nReceiveFloodSize;
 
+    SocketEventsMode socketEventsMode;
+    /** epoll instance used when socketEventsMode == SOCKETEVENTS_EPOLL, -1 otherwise */
+    int epollfd;
+
     std::vector<ListenSocket> vhListenSocket;
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned;
@@ -554,6 +608,8 @@ private:
     friend struct CConnmanTest;
 };
 extern std::unique_ptr<CConnman> g_connman;
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode);
+std::string GetSupportedSocketEventsModes();
 void Discover();
 void StartMapPort();
 void InterruptMapPort();
@@ -668,6 +724,39 @@ public:
 
 
 
+/**
+ * Pool of payload buffers for received messages, shared by all peers.
+ * Buffers are kept in power-of-two size classes, so that large messages
+ * (blocks, headers with auxpow, masternode lists) reuse the allocation of
+ * an earlier message instead of growing (and zeroing on free) a fresh one.
+ */
+class CRecvBufferPool
+{
+public:
+    /** Buffers smaller than 2^MIN_SIZE_CLASS bytes are not worth pooling */
+    static const unsigned int MIN_SIZE_CLASS = 14;
+    static const unsigned int MAX_SIZE_CLASS = 26;
+
+    explicit CRecvBufferPool(size_t nMaxPooledBytesIn);
+
+    /** Give an empty stream a pooled buffer that holds at least nSize bytes. Returns false if none is available. */
+    bool Acquire(CDataStream& stream, size_t nSize);
+    /** Take back the buffer of stream, leaving the stream empty */
+    void Release(CDataStream& stream);
+
+    size_t GetPooledBytes() const;
+    size_t GetPooledBuffers() const;
+
+private:
+    mutable CCriticalSection cs;
+    std::vector<CSerializeData> vFree[MAX_SIZE_CLASS - MIN_SIZE_CLASS + 1];
+    size_t nPooledBytes;
+    const size_t nMaxPooledBytes;
+};
+
+/** The pool used for the vRecv buffers of all CNetMessages */
+CRecvBufferPool& GetRecvBufferPool();
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -692,6 +781,11 @@ public:
         nTime = 0;
     }
 
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage(const CNetMessage&) = delete;
+    CNetMessage& operator=(const CNetMessage&) = delete;
+    ~CNetMessage();
+
     bool complete() const
     {
         if (!in_data)
@@ -723,11 +817,16 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSendQueueEntry> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
 
+    // Readiness remembered between edge-triggered epoll wakeups. fHasRecvData
+    // is only touched by the socket handler thread, fCanSendData requires cs_vSend.
+    bool fHasRecvData;
+    bool fCanSendData;
+
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg;
     size_t nProcessQueueSize;
@@ -807,6 +906,8 @@ public:
     // List of non-tx/non-block inventory items
     std::vector<CInv> vInventoryOtherToSend;
     CCriticalSection cs_inventory;
+    // Also protected by cs_inventory, as messages of some subsystems are
+    // handled outside of ThreadMessageHandler
     std::set<uint256> setAskFor;
     std::multimap<int64_t, CInv> mapAskFor;
     int64_t nNextInvSend;
@@ -959,6 +1060,7 @@ public:
     }
 
     void AskFor(const CInv& inv);
+    void RemoveAskFor(const uint256& hash);
 
     void CloseSocketDisconnect();
 
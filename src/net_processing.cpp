@@ -30,6 +30,7 @@
 #include <ui_interface.h>
 #include <util.h>
 #include <utilmoneystr.h>
+#include <utxosnapshot.h>
 #include <utilstrencodings.h>
 
 #include <spork.h>
@@ -38,6 +39,8 @@
 #include <masternode-sync.h>
 #include <masternodeman.h>
 
+#include <tuple>
+
 #if defined(NDEBUG)
 # error "Globaltoken cannot be compiled without assertions."
 #endif
@@ -126,6 +129,16 @@ namespace {
     /** Stack of nodes which we have set to announce using compact blocks */
     std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
 
+    /**
+     * Auxpow of headers we requested as cmpctblock, keyed by block hash.
+     * Peers speaking COMPACT_HEADER_VERSION leave the auxpow out of the
+     * cmpctblock they send in reply, so we keep it from the headers
+     * announcement. Protected by cs_main.
+     */
+    std::map<uint256, boost::shared_ptr<CAuxPow>> mapRecentAuxPow;
+    std::deque<uint256> vRecentAuxPowOrder;
+    static const size_t MAX_RECENT_AUXPOW = 16;
+
     /** Number of preferable block download peers. */
     int nPreferredDownload = 0;
 
@@ -143,6 +156,20 @@ namespace {
     MapRelay mapRelay;
     /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_main). */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
+
+    /**
+     * Serialized replies to getdata for relayed objects, keyed by command,
+     * hash, and the send version and flags they were made for, so that every
+     * peer asking for the same transaction, lock vote or payment vote gets the
+     * same message without it being serialized and hashed again. Holds at
+     * most MAX_RELAY_MSG_CACHE_BYTES. Protected by cs_main.
+     */
+    typedef std::map<std::tuple<std::string, uint256, int, int>, CSharedNetMsgRef> MapRelayMsg;
+    MapRelayMsg mapRelayMsg;
+    /** Expiration-time ordered list of (expire time, relay message map entry) pairs, protected by cs_main. */
+    std::deque<std::pair<int64_t, MapRelayMsg::iterator>> vRelayMsgExpiration;
+    /** Size of the messages in mapRelayMsg, protected by cs_main. */
+    size_t nRelayMsgBytes = 0;
 } // namespace
 
 namespace {
@@ -245,6 +272,11 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! Microseconds of proof of work checks this peer may still cause, see POW_CHECK_BUDGET_PER_SECOND
+    int64_t nPowCheckBudget;
+    //! When nPowCheckBudget was last topped up (in microseconds)
+    int64_t nPowCheckBudgetTime;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -269,6 +301,8 @@ struct CNodeState {
         fSupportsDesiredCmpctVersion = false;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
+        nPowCheckBudget = POW_CHECK_BUDGET_MAX;
+        nPowCheckBudgetTime = GetTimeMicros();
     }
 };
 
@@ -457,6 +491,31 @@ bool CanDirectFetch(const Consensus::Params &consensusParams)
     return chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - consensusParams.nPowTargetSpacing * 20;
 }
 
+// Requires cs_main
+void RememberRecentAuxPow(const CBlockHeader& header)
+{
+    if (!header.auxpow || mapRecentAuxPow.count(header.GetHash()))
+        return;
+    if (vRecentAuxPowOrder.size() >= MAX_RECENT_AUXPOW) {
+        mapRecentAuxPow.erase(vRecentAuxPowOrder.front());
+        vRecentAuxPowOrder.pop_front();
+    }
+    mapRecentAuxPow.emplace(header.GetHash(), header.auxpow);
+    vRecentAuxPowOrder.push_back(header.GetHash());
+}
+
+// Requires cs_main
+/** Top up the proof of work budget of a peer for the time passed, and return whether any is left */
+bool PowCheckBudgetLeft(CNodeState *state)
+{
+    const int64_t nNow = GetTimeMicros();
+    if (nNow > state->nPowCheckBudgetTime) {
+        state->nPowCheckBudget = std::min(POW_CHECK_BUDGET_MAX, state->nPowCheckBudget + (nNow - state->nPowCheckBudgetTime) * POW_CHECK_BUDGET_PER_SECOND / 1000000);
+    }
+    state->nPowCheckBudgetTime = nNow;
+    return state->nPowCheckBudget > 0;
+}
+
 // Requires cs_main
 bool PeerHasHeader(CNodeState *state, const CBlockIndex *pindex)
 {
@@ -778,6 +837,20 @@ void Misbehaving(NodeId pnode, int howmuch, const std::string& message)
         LogPrint(BCLog::NET, "%s: %s peer=%d (%d -> %d)%s\n", __func__, state->name, pnode, state->nMisbehavior-howmuch, state->nMisbehavior, message_prefixed);
 }
 
+// Requires cs_main.
+/** Charge a peer for the time spent checking headers or a block that did not get us anywhere */
+void ChargePowCheck(NodeId nodeid, int64_t nTime)
+{
+    CNodeState *state = State(nodeid);
+    if (state == nullptr)
+        return;
+    const bool fHadBudget = PowCheckBudgetLeft(state);
+    state->nPowCheckBudget = std::max(-POW_CHECK_BUDGET_MAX, state->nPowCheckBudget - nTime);
+    if (fHadBudget && state->nPowCheckBudget <= 0) {
+        LogPrintf("peer=%d used up its proof of work check budget, its headers and blocks are handled more slowly\n", nodeid);
+    }
+}
+
 
 
 
@@ -857,7 +930,6 @@ static bool fWitnessesPresentInMostRecentCompactBlock;
 
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
     LOCK(cs_main);
 
@@ -877,8 +949,10 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
-        // TODO: Avoid the repeated-serialization here
+    // Serialized once for each send version among the peers it is announced to
+    std::map<int, CSharedNetMsgRef> mapCmpctBlockMsg;
+
+    connman->ForEachNode([this, &pcmpctblock, &mapCmpctBlockMsg, pindex, fWitnessEnabled, &hashBlock](CNode* pnode) {
         if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -890,7 +964,12 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            // The header encoding depends on the version the peer speaks
+            const int nSendVersion = pnode->GetSendVersion();
+            CSharedNetMsgRef& msgCmpctBlock = mapCmpctBlockMsg[nSendVersion];
+            if (!msgCmpctBlock)
+                msgCmpctBlock = CNetMsgMaker(nSendVersion).MakeShared(0, NetMsgType::CMPCTBLOCK, *pcmpctblock);
+            connman->PushMessage(pnode, msgCmpctBlock);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1014,22 +1093,29 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return instantsend.AlreadyHave(inv.hash);
 
     case MSG_SPORK:
-        return mapSporks.count(inv.hash);
+        {
+            CSporkMessage spork;
+            return sporkManager.GetSporkByHash(inv.hash, spork);
+        }
 
     case MSG_MASTERNODE_PAYMENT_VOTE:
-        return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
+        {
+            LOCK(cs_mapMasternodePaymentVotes);
+            return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
+        }
 
     case MSG_MASTERNODE_PAYMENT_BLOCK:
         {
             BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+            LOCK(cs_mapMasternodeBlocks);
             return mi != mapBlockIndex.end() && mnpayments.mapMasternodeBlocks.find(mi->second->nHeight) != mnpayments.mapMasternodeBlocks.end();
         }
 
     case MSG_MASTERNODE_ANNOUNCE:
-        return mnodeman.mapSeenMasternodeBroadcast.count(inv.hash) && !mnodeman.IsMnbRecoveryRequested(inv.hash);
+        return mnodeman.AlreadyHaveMasternodeBroadcast(inv.hash);
 
     case MSG_MASTERNODE_PING:
-        return mnodeman.mapSeenMasternodePing.count(inv.hash);
+        return mnodeman.HasSeenMasternodePing(inv.hash);
 
     case MSG_MASTERNODE_VERIFY:
         return mnodeman.mapSeenMasternodeVerification.count(inv.hash);
@@ -1056,6 +1142,172 @@ void RelayTransactionFromExtern(const CTransaction& tx, CConnman* connman)
     RelayTransaction(tx, connman);
 }
 
+CMessageWorkerQueue::CMessageWorkerQueue(const std::string& strNameIn, size_t nMaxQueuedIn, size_t nMaxQueuedPerPeerIn, Handler handlerIn) :
+    strName(strNameIn), nMaxQueued(nMaxQueuedIn), nMaxQueuedPerPeer(nMaxQueuedPerPeerIn), handler(std::move(handlerIn)), fRunning(false), nDropped(0)
+{
+}
+
+CMessageWorkerQueue::~CMessageWorkerQueue()
+{
+    Stop();
+}
+
+void CMessageWorkerQueue::Start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fRunning)
+        return;
+    fRunning = true;
+    thread = std::thread(&TraceThread<std::function<void()> >, strName.c_str(), std::function<void()>(std::bind(&CMessageWorkerQueue::ThreadProcess, this)));
+}
+
+void CMessageWorkerQueue::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fRunning = false;
+    }
+    cond.notify_all();
+    if (thread.joinable())
+        thread.join();
+
+    std::deque<QueuedMessage> vDropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        vDropped.swap(queue);
+        mapQueuedPerPeer.clear();
+    }
+    for (QueuedMessage& msg : vDropped)
+        msg.pfrom->Release();
+}
+
+bool CMessageWorkerQueue::Push(CNode* pfrom, const std::string& strCommand, CDataStream&& vRecv)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fRunning)
+            return false;
+        if (queue.size() >= nMaxQueued) {
+            nDropped++;
+            LogPrint(BCLog::NET, "%s: queue full, dropping %s from peer=%d\n", strName, SanitizeString(strCommand), pfrom->GetId());
+            return true;
+        }
+        size_t& nQueuedPeer = mapQueuedPerPeer[pfrom->GetId()];
+        if (nQueuedPeer >= nMaxQueuedPerPeer) {
+            nDropped++;
+            LogPrint(BCLog::NET, "%s: peer=%d has too many messages queued, dropping %s\n", strName, pfrom->GetId(), SanitizeString(strCommand));
+            return true;
+        }
+        nQueuedPeer++;
+        pfrom->AddRef();
+        queue.push_back(QueuedMessage{pfrom, strCommand, std::move(vRecv)});
+    }
+    cond.notify_one();
+    return true;
+}
+
+size_t CMessageWorkerQueue::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+uint64_t CMessageWorkerQueue::GetDroppedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nDropped;
+}
+
+void CMessageWorkerQueue::ThreadProcess()
+{
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return !fRunning || !queue.empty(); });
+        if (!fRunning)
+            return;
+        QueuedMessage msg(std::move(queue.front()));
+        queue.pop_front();
+        std::map<NodeId, size_t>::iterator it = mapQueuedPerPeer.find(msg.pfrom->GetId());
+        if (it != mapQueuedPerPeer.end() && --it->second == 0)
+            mapQueuedPerPeer.erase(it);
+        lock.unlock();
+
+        if (!msg.pfrom->fDisconnect) {
+            try {
+                handler(msg.pfrom, msg.strCommand, msg.vRecv);
+            } catch (const std::ios_base::failure& e) {
+                LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' caught\n", strName, SanitizeString(msg.strCommand), msg.vRecv.size(), e.what());
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, strName.c_str());
+            } catch (...) {
+                PrintExceptionContinue(nullptr, strName.c_str());
+            }
+        }
+        GetRecvBufferPool().Release(msg.vRecv);
+        msg.pfrom->Release();
+    }
+}
+
+namespace {
+
+/** Set up once by StartMessageWorkers(), before the message handler thread runs */
+std::unique_ptr<CMessageWorkerQueue> workerMasternode;
+std::unique_ptr<CMessageWorkerQueue> workerPaymentVote;
+std::unique_ptr<CMessageWorkerQueue> workerInstantSend;
+std::unique_ptr<CMessageWorkerQueue> workerSpork;
+
+CMessageWorkerQueue* GetMessageWorker(const std::string& strCommand)
+{
+    if (strCommand == NetMsgType::MNANNOUNCE || strCommand == NetMsgType::MNPING ||
+        strCommand == NetMsgType::DSEG || strCommand == NetMsgType::MNVERIFY)
+        return workerMasternode.get();
+    if (strCommand == NetMsgType::MASTERNODEPAYMENTVOTE || strCommand == NetMsgType::MASTERNODEPAYMENTSYNC)
+        return workerPaymentVote.get();
+    if (strCommand == NetMsgType::TXLOCKVOTE)
+        return workerInstantSend.get();
+    if (strCommand == NetMsgType::SPORK || strCommand == NetMsgType::GETSPORKS)
+        return workerSpork.get();
+    return nullptr;
+}
+
+} // namespace
+
+void StartMessageWorkers(CConnman& connman)
+{
+    CConnman* pconnman = &connman;
+    workerMasternode.reset(new CMessageWorkerQueue("mnmsg", MAX_QUEUED_MASTERNODE_MESSAGES, MAX_QUEUED_MASTERNODE_MESSAGES / MESSAGE_WORKER_PEER_SHARE,
+        [pconnman](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) {
+            mnodeman.ProcessMessage(pfrom, strCommand, vRecv, *pconnman);
+        }));
+    workerPaymentVote.reset(new CMessageWorkerQueue("mnwmsg", MAX_QUEUED_PAYMENTVOTE_MESSAGES, MAX_QUEUED_PAYMENTVOTE_MESSAGES / MESSAGE_WORKER_PEER_SHARE,
+        [pconnman](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) {
+            mnpayments.ProcessMessage(pfrom, strCommand, vRecv, *pconnman);
+        }));
+    workerInstantSend.reset(new CMessageWorkerQueue("ixmsg", MAX_QUEUED_INSTANTSEND_MESSAGES, MAX_QUEUED_INSTANTSEND_MESSAGES / MESSAGE_WORKER_PEER_SHARE,
+        [pconnman](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) {
+            instantsend.ProcessMessage(pfrom, strCommand, vRecv, *pconnman);
+        }));
+    workerSpork.reset(new CMessageWorkerQueue("sporkmsg", MAX_QUEUED_SPORK_MESSAGES, MAX_QUEUED_SPORK_MESSAGES / MESSAGE_WORKER_PEER_SHARE,
+        [pconnman](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) {
+            sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *pconnman);
+        }));
+
+    workerMasternode->Start();
+    workerPaymentVote->Start();
+    workerInstantSend->Start();
+    workerSpork->Start();
+}
+
+void StopMessageWorkers()
+{
+    // The workers themselves stay allocated: ThreadMessageHandler may still be
+    // looking them up, and falls back to handling messages inline once stopped.
+    for (CMessageWorkerQueue* worker : {workerMasternode.get(), workerPaymentVote.get(), workerInstantSend.get(), workerSpork.get()}) {
+        if (worker)
+            worker->Stop();
+    }
+}
+
 static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connman)
 {
     unsigned int nRelayNodes = fReachable ? 2 : 1; // limited relaying of addresses outside our network(s)
@@ -1209,10 +1461,22 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
             bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
             if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                // Compact blocks are only requested right after a headers
+                // announcement, so the peer already has the Equihash solution
+                // and auxpow of this header.
+                const bool fOmitHeaderData = pfrom->GetSendVersion() >= COMPACT_HEADER_VERSION;
                 if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == mi->second->GetBlockHash()) {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                    if (fOmitHeaderData) {
+                        CBlockHeaderAndShortTxIDs cmpctblock(*a_recent_compact_block);
+                        cmpctblock.OmitKnownHeaderData();
+                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+                    } else {
+                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                    }
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
+                    if (fOmitHeaderData)
+                        cmpctblock.OmitKnownHeaderData();
                     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                 }
             } else {
@@ -1234,6 +1498,32 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
     }
 }
 
+// Requires cs_main
+template <typename T>
+void static PushRelayMessage(CNode* pfrom, CConnman* connman, const CInv& inv, int nSendFlags, const std::string& strCommand, const T& obj)
+{
+    const int nSendVersion = pfrom->GetSendVersion();
+    const auto key = std::make_tuple(strCommand, inv.hash, nSendVersion, nSendFlags);
+    MapRelayMsg::iterator mi = mapRelayMsg.find(key);
+    if (mi == mapRelayMsg.end()) {
+        CSharedNetMsgRef msg = CNetMsgMaker(nSendVersion).MakeShared(nSendFlags, strCommand, obj);
+
+        // Expire old relay messages, and the oldest ones to make room for this one
+        int64_t nNow = GetTimeMicros();
+        while (!vRelayMsgExpiration.empty() && (vRelayMsgExpiration.front().first < nNow ||
+                nRelayMsgBytes + msg->data.size() > MAX_RELAY_MSG_CACHE_BYTES)) {
+            nRelayMsgBytes -= vRelayMsgExpiration.front().second->second->data.size();
+            mapRelayMsg.erase(vRelayMsgExpiration.front().second);
+            vRelayMsgExpiration.pop_front();
+        }
+
+        mi = mapRelayMsg.emplace(key, msg).first;
+        nRelayMsgBytes += msg->data.size();
+        vRelayMsgExpiration.push_back(std::make_pair(nNow + 15 * 60 * 1000000, mi));
+    }
+    connman->PushMessage(pfrom, mi->second);
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     AssertLockNotHeld(cs_main);
@@ -1260,7 +1550,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             auto mi = mapRelay.find(inv.hash);
             int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
             if (mi != mapRelay.end()) {
-                connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                PushRelayMessage(pfrom, connman, inv, nSendFlags, NetMsgType::TX, *mi->second);
                 push = true;
             } else if (pfrom->timeLastMempoolReq) {
                 auto txinfo = mempool.info(inv.hash);
@@ -1275,7 +1565,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             if (!push && inv.type == MSG_TXLOCK_REQUEST) {
                 CTxLockRequest txLockRequest;
                 if(instantsend.GetTxLockRequest(inv.hash, txLockRequest)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TXLOCKREQUEST, txLockRequest));
+                    PushRelayMessage(pfrom, connman, inv, 0, NetMsgType::TXLOCKREQUEST, txLockRequest);
                     push = true;
                 }
             }
@@ -1283,34 +1573,36 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             if (!push && inv.type == MSG_TXLOCK_VOTE) {
                 CTxLockVote vote;
                 if(instantsend.GetTxLockVote(inv.hash, vote)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TXLOCKVOTE, vote));
+                    PushRelayMessage(pfrom, connman, inv, 0, NetMsgType::TXLOCKVOTE, vote);
                     push = true;
                 }
             }
 
             if (!push && inv.type == MSG_SPORK) {
-                if(mapSporks.count(inv.hash)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, mapSporks[inv.hash]));
+                CSporkMessage spork;
+                if(sporkManager.GetSporkByHash(inv.hash, spork)) {
+                    PushRelayMessage(pfrom, connman, inv, 0, NetMsgType::SPORK, spork);
                     push = true;
                 }
             }
 
             if (!push && inv.type == MSG_MASTERNODE_PAYMENT_VOTE) {
+                LOCK(cs_mapMasternodePaymentVotes);
                 if(mnpayments.HasVerifiedPaymentVote(inv.hash)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, mnpayments.mapMasternodePaymentVotes[inv.hash]));
+                    PushRelayMessage(pfrom, connman, inv, 0, NetMsgType::MASTERNODEPAYMENTVOTE, mnpayments.mapMasternodePaymentVotes[inv.hash]);
                     push = true;
                 }
             }
 
             if (!push && inv.type == MSG_MASTERNODE_PAYMENT_BLOCK) {
                 BlockMap::iterator mipb = mapBlockIndex.find(inv.hash);
-                LOCK(cs_mapMasternodeBlocks);
+                LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
                 if (mipb != mapBlockIndex.end() && mnpayments.mapMasternodeBlocks.count(mipb->second->nHeight)) {
                     for(CMasternodePayee& payee : mnpayments.mapMasternodeBlocks[mipb->second->nHeight].vecPayees) {
                         std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
                         for(uint256& hash : vecVoteHashes) {
                             if(mnpayments.HasVerifiedPaymentVote(hash)) {
-                                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, mnpayments.mapMasternodePaymentVotes[hash]));
+                                PushRelayMessage(pfrom, connman, CInv(MSG_MASTERNODE_PAYMENT_VOTE, hash), 0, NetMsgType::MASTERNODEPAYMENTVOTE, mnpayments.mapMasternodePaymentVotes[hash]);
                             }
                         }
                     }
@@ -1319,15 +1611,17 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             }
 
             if (!push && inv.type == MSG_MASTERNODE_ANNOUNCE) {
-                if(mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)){
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCE, mnodeman.mapSeenMasternodeBroadcast[inv.hash].second));
+                CMasternodeBroadcast mnb;
+                if(mnodeman.GetSeenMasternodeBroadcast(inv.hash, mnb)){
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCE, mnb));
                     push = true;
                 }
             }
 
             if (!push && inv.type == MSG_MASTERNODE_PING) {
-                if(mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, mnodeman.mapSeenMasternodePing[inv.hash]));
+                CMasternodePing mnp;
+                if(mnodeman.GetSeenMasternodePing(inv.hash, mnp)) {
+                    PushRelayMessage(pfrom, connman, inv, 0, NetMsgType::MNPING, mnp);
                     push = true;
                 }
             }
@@ -1459,6 +1753,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         int nDoS;
         if (state.IsInvalid(nDoS)) {
             LOCK(cs_main);
+            ChargePowCheck(pfrom->GetId(), state.GetPowCheckTime());
             if (nDoS > 0) {
                 Misbehaving(pfrom->GetId(), nDoS, "invalid header received");
             } else {
@@ -1519,6 +1814,9 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
 
         if (received_new_header && pindexLast->nChainWork > chainActive.Tip()->nChainWork) {
             nodestate->m_last_block_announcement = GetTime();
+        } else {
+            // Valid, but nothing we are going to download
+            ChargePowCheck(pfrom->GetId(), state.GetPowCheckTime());
         }
 
         if (nCount == MAX_HEADERS_RESULTS) {
@@ -1575,6 +1873,13 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
                     if (nodestate->fSupportsDesiredCmpctVersion && vGetData.size() == 1 && mapBlocksInFlight.size() == 1 && pindexLast->pprev->IsValid(BLOCK_VALID_CHAIN)) {
                         // In any case, we want to download using a compact block, not a regular one
                         vGetData[0] = CInv(MSG_CMPCT_BLOCK, vGetData[0].hash);
+                        // The reply may leave out the auxpow we just received
+                        for (const CBlockHeader& header : headers) {
+                            if (header.GetHash() == vGetData[0].hash) {
+                                RememberRecentAuxPow(header);
+                                break;
+                            }
+                        }
                     }
                     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vGetData));
                 }
@@ -2260,7 +2565,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         CInv inv(nInvType, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
-        pfrom->setAskFor.erase(inv.hash);
+        pfrom->RemoveAskFor(inv.hash);
         
         // Process custom logic, no matter if tx will be accepted to mempool later or not
         if (strCommand == NetMsgType::TXLOCKREQUEST) {
@@ -2275,7 +2580,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         bool fMissingInputs = false;
         CValidationState state;
 
-        pfrom->setAskFor.erase(inv.hash);
+        pfrom->RemoveAskFor(inv.hash);
         mapAlreadyAskedFor.erase(inv.hash);
 
         std::list<CTransactionRef> lRemovedTxn;
@@ -2469,6 +2774,22 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         {
         LOCK(cs_main);
 
+        if (!cmpctblock.IsHeaderComplete()) {
+            // The peer left out header data we got with its headers announcement.
+            // If we no longer have it, fall back to requesting the full block.
+            const uint256& hash = cmpctblock.GetOmittedHeaderHash();
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
+            std::map<uint256, boost::shared_ptr<CAuxPow>>::iterator itAuxPow = mapRecentAuxPow.find(hash);
+            boost::shared_ptr<CAuxPow> auxpow = itAuxPow != mapRecentAuxPow.end() ? itAuxPow->second : boost::shared_ptr<CAuxPow>();
+            if (mi == mapBlockIndex.end() || cmpctblock.FillOmittedHeaderData(&mi->second->nSolution, auxpow) != READ_STATUS_OK) {
+                LogPrint(BCLog::CMPCTBLOCK, "Cannot restore header of cmpctblock %s from peer=%d, requesting full block\n", hash.ToString(), pfrom->GetId());
+                std::vector<CInv> vInv(1);
+                vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), hash);
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
+                return true;
+            }
+        }
+
         if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
             // Doesn't connect (or is genesis), instead of DoSing in AcceptBlockHeader, request deeper headers
             if (!IsInitialBlockDownload())
@@ -2486,8 +2807,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (!ProcessNewBlockHeaders({cmpctblock.header}, state, chainparams, &pindex)) {
             int nDoS;
             if (state.IsInvalid(nDoS)) {
+                LOCK(cs_main);
+                ChargePowCheck(pfrom->GetId(), state.GetPowCheckTime());
                 if (nDoS > 0) {
-                    LOCK(cs_main);
                     Misbehaving(pfrom->GetId(), nDoS, strprintf("Peer %d sent us invalid header via cmpctblock\n", pfrom->GetId()));
                 } else {
                     LogPrint(BCLog::NET, "Peer %d sent us invalid header via cmpctblock\n", pfrom->GetId());
@@ -2661,12 +2983,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // we have a chain with at least nMinimumChainWork), and we ignore
             // compact blocks with less work than our tip, it is safe to treat
             // reconstructed compact blocks as having been requested.
-            ProcessNewBlock(chainparams, pblock, /*fForceProcessing=*/true, &fNewBlock);
+            int64_t nPowCheckTime = 0;
+            ProcessNewBlock(chainparams, pblock, /*fForceProcessing=*/true, &fNewBlock, &nPowCheckTime);
             if (fNewBlock) {
                 pfrom->nLastBlockTime = GetTime();
             } else {
                 LOCK(cs_main);
                 mapBlockSource.erase(pblock->GetHash());
+                ChargePowCheck(pfrom->GetId(), nPowCheckTime);
             }
             LOCK(cs_main); // hold cs_main for CBlockIndex::IsValid()
             if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS)) {
@@ -2744,12 +3068,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // disk-space attacks), but this should be safe due to the
             // protections in the compact block handler -- see related comment
             // in compact block optimistic reconstruction handling.
-            ProcessNewBlock(chainparams, pblock, /*fForceProcessing=*/true, &fNewBlock);
+            int64_t nPowCheckTime = 0;
+            ProcessNewBlock(chainparams, pblock, /*fForceProcessing=*/true, &fNewBlock, &nPowCheckTime);
             if (fNewBlock) {
                 pfrom->nLastBlockTime = GetTime();
             } else {
                 LOCK(cs_main);
                 mapBlockSource.erase(pblock->GetHash());
+                ChargePowCheck(pfrom->GetId(), nPowCheckTime);
             }
         }
     }
@@ -2794,17 +3120,31 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
             forceProcessing |= MarkBlockAsReceived(hash);
+            // The proof of work of an unannounced block is only checked once
+            // its header passed the checks against its parent.
+            CValidationState state;
+            if (!PreCheckBlockHeader(*pblock, state, chainparams)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS, strprintf("invalid header of block %s", hash.ToString()));
+                } else {
+                    LogPrint(BCLog::NET, "ignoring block %s peer=%d: %s\n", hash.ToString(), pfrom->GetId(), FormatStateMessage(state));
+                }
+                return true;
+            }
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
         }
         bool fNewBlock = false;
-        ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock);
+        int64_t nPowCheckTime = 0;
+        ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock, &nPowCheckTime);
         if (fNewBlock) {
             pfrom->nLastBlockTime = GetTime();
         } else {
             LOCK(cs_main);
             mapBlockSource.erase(pblock->GetHash());
+            ChargePowCheck(pfrom->GetId(), nPowCheckTime);
         }
     }
 
@@ -3022,11 +3362,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (found)
         {
             //probably one the extensions
-            mnodeman.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            mnpayments.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            instantsend.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman);
-            masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+            CMessageWorkerQueue* worker = GetMessageWorker(strCommand);
+            if (!worker || !worker->Push(pfrom, strCommand, std::move(vRecv))) {
+                mnodeman.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+                mnpayments.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+                instantsend.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+                sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman);
+                masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+            }
         }
         else
         {
@@ -3096,6 +3439,28 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     if (pfrom->fPauseSend)
         return false;
 
+    // A peer that used up its proof of work check budget has its messages left
+    // queued while the next one is a header or block, until the budget refills.
+    // Messages are handled in order, so everything queued behind it waits too.
+    // Once its queue is full we stop reading from it; other peers are served
+    // as usual meanwhile.
+    if (!pfrom->fWhitelisted) {
+        std::string strNextCommand;
+        {
+            LOCK(pfrom->cs_vProcessMsg);
+            if (pfrom->vProcessMsg.empty())
+                return false;
+            strNextCommand = pfrom->vProcessMsg.front().hdr.GetCommand();
+        }
+        if (strNextCommand == NetMsgType::HEADERS || strNextCommand == NetMsgType::BLOCK ||
+            strNextCommand == NetMsgType::CMPCTBLOCK || strNextCommand == NetMsgType::BLOCKTXN) {
+            LOCK(cs_main);
+            CNodeState *state = State(pfrom->GetId());
+            if (state && !PowCheckBudgetLeft(state))
+                return false;
+        }
+    }
+
     std::list<CNetMessage> msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
@@ -3804,7 +4169,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && !IsUTXOSnapshotPending() && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
             FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
@@ -3826,9 +4191,19 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
         //
         // Message: getdata (non-blocks)
         //
-        while (!pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
+        std::vector<CInv> vAskFor;
+        {
+            // AlreadyHave() may take subsystem locks, which are held by the
+            // message workers while they take cs_inventory, so only collect here
+            LOCK(pto->cs_inventory);
+            while (!pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
+            {
+                vAskFor.push_back((*pto->mapAskFor.begin()).second);
+                pto->mapAskFor.erase(pto->mapAskFor.begin());
+            }
+        }
+        for (const CInv& inv : vAskFor)
         {
-            const CInv& inv = (*pto->mapAskFor.begin()).second;
             if (!AlreadyHave(inv))
             {
                 LogPrint(BCLog::NET, "Requesting %s peer=%d\n", inv.ToString(), pto->GetId());
@@ -3840,9 +4215,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                 }
             } else {
                 //If we're not going to ask, don't expect a response.
-                pto->setAskFor.erase(inv.hash);
+                pto->RemoveAskFor(inv.hash);
             }
-            pto->mapAskFor.erase(pto->mapAskFor.begin());
         }
         if (!vGetData.empty())
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETDATA, vGetData));
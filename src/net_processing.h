@@ -10,6 +10,13 @@
 #include <validationinterface.h>
 #include <consensus/params.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
 /** Expiration time for orphan transactions in seconds */
@@ -34,6 +41,74 @@ static constexpr int64_t STALE_CHECK_INTERVAL = 10 * 60; // 10 minutes
 static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
+/** Microseconds of proof of work checks per second a peer may cause with headers and blocks that turn out useless */
+static constexpr int64_t POW_CHECK_BUDGET_PER_SECOND = 50000; // 5% of a core
+/** Microseconds of proof of work checks a peer may cause in a burst */
+static constexpr int64_t POW_CHECK_BUDGET_MAX = 2 * 1000000; // 2 seconds
+/** Maximum size of the serialized relay messages kept to answer getdata from several peers */
+static const size_t MAX_RELAY_MSG_CACHE_BYTES = 16 << 20;
+/** Maximum number of messages waiting for each subsystem worker; further messages are dropped */
+static const size_t MAX_QUEUED_MASTERNODE_MESSAGES = 10000;
+static const size_t MAX_QUEUED_PAYMENTVOTE_MESSAGES = 50000;
+static const size_t MAX_QUEUED_INSTANTSEND_MESSAGES = 10000;
+static const size_t MAX_QUEUED_SPORK_MESSAGES = 1000;
+/** A single peer may fill at most this fraction (1/n) of a subsystem worker's queue */
+static const size_t MESSAGE_WORKER_PEER_SHARE = 4;
+
+/**
+ * Bounded FIFO of received messages served by a dedicated thread.
+ *
+ * Masternode, payment vote, InstantSend and spork messages are handed to one
+ * of these each, so that a flood of them never delays block and transaction
+ * processing in ThreadMessageHandler. Queued messages hold a reference on
+ * their node, which keeps it from being deleted until they are handled.
+ * Each peer may only fill part of the queue, so one flooding peer cannot
+ * crowd out the messages of the others.
+ */
+class CMessageWorkerQueue
+{
+public:
+    typedef std::function<void(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)> Handler;
+
+    CMessageWorkerQueue(const std::string& strNameIn, size_t nMaxQueuedIn, size_t nMaxQueuedPerPeerIn, Handler handlerIn);
+    ~CMessageWorkerQueue();
+
+    void Start();
+    /** Stop the worker thread and drop (without handling) whatever is still queued */
+    void Stop();
+    /**
+     * Take ownership of a message. Returns false if the worker is not running,
+     * in which case the caller has to handle the message itself. Messages that
+     * do not fit in the queue, or in the peer's share of it, are dropped (and
+     * reported as taken).
+     */
+    bool Push(CNode* pfrom, const std::string& strCommand, CDataStream&& vRecv);
+    size_t Size() const;
+    uint64_t GetDroppedCount() const;
+
+private:
+    struct QueuedMessage {
+        CNode* pfrom;
+        std::string strCommand;
+        CDataStream vRecv;
+    };
+
+    void ThreadProcess();
+
+    const std::string strName;
+    const size_t nMaxQueued;
+    const size_t nMaxQueuedPerPeer;
+    const Handler handler;
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<QueuedMessage> queue;
+    //! Number of messages in the queue per peer
+    std::map<NodeId, size_t> mapQueuedPerPeer;
+    bool fRunning;
+    uint64_t nDropped;
+    std::thread thread;
+};
 
 class PeerLogicValidation : public CValidationInterface, public NetEventsInterface {
 private:
@@ -82,5 +157,9 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
 /** Relay a Transaction from external functions. */
 void RelayTransactionFromExtern(const CTransaction& tx, CConnman* connman);
+/** Start the masternode, payment vote, InstantSend and spork message workers */
+void StartMessageWorkers(CConnman& connman);
+/** Stop the message workers; must happen before the nodes they reference are deleted */
+void StopMessageWorkers();
 
 #endif // BITCOIN_NET_PROCESSING_H
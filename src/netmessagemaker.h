@@ -29,6 +29,13 @@ public:
         return Make(0, std::move(sCommand), std::forward<Args>(args)...);
     }
 
+    /** Make a message that can be pushed to many peers, serializing and hashing it only once */
+    template <typename... Args>
+    CSharedNetMsgRef MakeShared(int nFlags, std::string sCommand, Args&&... args) const
+    {
+        return std::make_shared<const CSharedNetMsg>(Make(nFlags, std::move(sCommand), std::forward<Args>(args)...));
+    }
+
 private:
     const int nVersion;
 };
@@ -158,11 +158,7 @@ unsigned int GetNextWorkRequiredV2(const CBlockIndex* pindexLast, const CBlockHe
 
 	// find first block in averaging interval
 	// Go back by what we want to be nAveragingInterval blocks per algo
-	const CBlockIndex* pindexFirst = pindexLast;
-	for (int i = 0; pindexFirst && i < NUM_ALGOS_OLD*params.nAveragingInterval; i++)
-	{
-		pindexFirst = pindexFirst->pprev;
-	}
+	const CBlockIndex* pindexFirst = pindexLast->GetAncestor(pindexLast->nHeight - NUM_ALGOS_OLD*params.nAveragingInterval);
 
 	const CBlockIndex* pindexPrevAlgo = GetLastBlockIndexForAlgo(pindexLast, algo, params);
 	if (pindexPrevAlgo == nullptr || pindexFirst == nullptr)
@@ -239,11 +235,8 @@ unsigned int GetNextWorkRequiredV3(const CBlockIndex* pindexLast, const CBlockHe
 
 	// find first block in averaging interval
 	// Go back by what we want to be nAveragingInterval blocks per algo
-	const CBlockIndex* pindexFirst = pindexLast;
-	for (int i = 0; pindexFirst && i < NUM_ALGOS*params.nAveragingInterval; i++) // unchanged, nAveragingInterval is still the same
-	{
-		pindexFirst = pindexFirst->pprev;
-	}
+	// unchanged, nAveragingInterval is still the same
+	const CBlockIndex* pindexFirst = pindexLast->GetAncestor(pindexLast->nHeight - NUM_ALGOS*params.nAveragingInterval);
 
 	const CBlockIndex* pindexPrevAlgo = GetLastBlockIndexForAlgo(pindexLast, algo, params);
 	if (pindexPrevAlgo == nullptr || pindexFirst == nullptr)
@@ -142,7 +142,7 @@ public:
      * @param nVersion the block version to check.
      * @return true if it is legacy, false if not.
      */
-    inline bool IsLegacyVersion(int32_t blockversion) const
+    static inline bool IsLegacyVersion(int32_t blockversion)
     {
         return (blockversion == 1 || blockversion == 2 || blockversion == 536870912 || blockversion == 536870913 || blockversion == 536870914);
     }
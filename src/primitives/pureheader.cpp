@@ -52,7 +52,7 @@ uint256 CPureBlockHeader::GetPoWHash(uint8_t nAlgo, int nType, int nVersion) con
     return SerializeMultiAlgoHash(*this, nAlgo, nType, nVersion);
 }
 
-uint8_t CPureBlockHeader::GetAlgo() const
+uint8_t CPureBlockHeader::GetAlgoFromVersion(int32_t nVersion)
 {
     if(IsLegacyVersion(nVersion))
         return ALGO_SHA256D;
@@ -274,7 +274,10 @@ public:
         }
     }
 	
-    uint8_t GetAlgo() const;
+    uint8_t GetAlgo() const { return GetAlgoFromVersion(nVersion); }
+
+    /** Decode the algo from a block version alone, without building a header */
+    static uint8_t GetAlgoFromVersion(int32_t nVersion);
     
     CDefaultBlockHeader GetDefaultBlockHeader() const;    
     CEquihashBlockHeader GetEquihashBlockHeader() const;
@@ -6,6 +6,8 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <crypto/common.h>
+#include <jsonwriter.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <validation.h>
@@ -23,6 +25,8 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int MAX_REST_BLOCKS = 2000; //max blocks in one /rest/blocks/ reply
+static const size_t MAX_REST_BLOCKS_SIZE = 32 * 1024 * 1024; //stop adding blocks to a /rest/blocks/ reply after this many bytes
 
 enum RetFormat {
     RF_UNDEF,
@@ -223,18 +227,19 @@ static bool rest_block(HTTPRequest* req,
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        std::string binaryBlock = ssBlock.str();
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        req->WriteReplyData(ssBlock.data(), ssBlock.size());
+        req->WriteReply(HTTP_OK);
         return true;
     }
 
     case RF_HEX: {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
@@ -242,14 +247,14 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock;
+        req->WriteHeader("Content-Type", "application/json");
+        CJSONStreamWriter writer([req](const char* data, size_t size) { req->WriteReplyData(data, size); });
         {
             LOCK(cs_main);
-            objBlock = blockToJSON(block, pblockindex, showTxDetails);
+            blockToJSON(writer, block, pblockindex, showTxDetails);
         }
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        writer.Flush();
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
 
@@ -269,6 +274,74 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+static bool rest_blocks(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block range specified. Use /rest/blocks/<start>/<count>.<ext>.");
+
+    int32_t nStart, nCount;
+    if (!ParseInt32(path[0], &nStart) || nStart < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid start height: " + path[0]);
+    if (!ParseInt32(path[1], &nCount) || nCount < 1 || nCount > MAX_REST_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + path[1]);
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    std::vector<const CBlockIndex*> vBlocks;
+    {
+        LOCK(cs_main);
+        if (nStart > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Start height beyond the active chain: " + path[0]);
+        for (int nHeight = nStart; nHeight <= chainActive.Height() && (int)vBlocks.size() < nCount; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+                return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block at height %d not available (pruned data)", nHeight));
+            vBlocks.push_back(pindex);
+        }
+    }
+
+    // Each block is preceded by its size as a 4-byte little-endian integer.
+    // Large ranges are cut short after MAX_REST_BLOCKS_SIZE bytes; clients
+    // continue from the height following the last block they received.
+    size_t nWritten = 0;
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    for (const CBlockIndex* pindex : vBlocks) {
+        // Blocks of the active chain had their proof of work checked when connected
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus(), false)) {
+            if (nWritten == 0)
+                return RESTERR(req, HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not found");
+            break;
+        }
+        ssBlock.clear();
+        ssBlock << block;
+        if (nWritten > 0 && nWritten + 4 + ssBlock.size() > MAX_REST_BLOCKS_SIZE)
+            break;
+
+        unsigned char size[4];
+        WriteLE32(size, ssBlock.size());
+        if (rf == RF_BINARY) {
+            req->WriteReplyData((const char*)size, sizeof(size));
+            req->WriteReplyData(ssBlock.data(), ssBlock.size());
+        } else {
+            const std::string strHex = HexStr(size, size + sizeof(size)) + HexStr(ssBlock.begin(), ssBlock.end());
+            req->WriteReplyData(strHex.data(), strHex.size());
+        }
+        nWritten += sizeof(size) + ssBlock.size();
+    }
+
+    req->WriteHeader("Content-Type", rf == RF_BINARY ? "application/octet-stream" : "text/plain");
+    req->WriteReply(HTTP_OK, rf == RF_HEX ? "\n" : "");
+    return true;
+}
+
 // A bit of a hack - dependency on a function defined in rpc/blockchain.cpp
 UniValue getblockchaininfo(const JSONRPCRequest& request);
 
@@ -374,11 +447,11 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     }
 
     case RF_JSON: {
-        UniValue objTx(UniValue::VOBJ);
-        TxToUniv(*tx, hashBlock, objTx);
-        std::string strJSON = objTx.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        CJSONStreamWriter writer([req](const char* data, size_t size) { req->WriteReplyData(data, size); });
+        TxToJSONWriter(writer, *tx, hashBlock);
+        writer.Flush();
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
 
@@ -577,6 +650,7 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blocks/", rest_blocks},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
@@ -9,9 +9,12 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <clientversion.h>
 #include <coins.h>
+#include <coinstats.h>
 #include <consensus/validation.h>
 #include <instantx.h>
+#include <jsonwriter.h>
 #include <globaltoken/hardfork.h>
 #include <validation.h>
 #include <core_io.h>
@@ -25,6 +28,7 @@
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <utxosnapshot.h>
 #include <hash.h>
 #include <validationinterface.h>
 #include <warnings.h>
@@ -35,6 +39,7 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 
@@ -48,6 +53,11 @@ static std::mutex cs_blockchange;
 static std::condition_variable cond_blockchange;
 static CUpdatedBlock latestblock;
 
+/* Tips as of the last notifications. Block index entries are not freed while
+ * RPC is running, so the chain below them can be walked without cs_main. */
+static std::atomic<const CBlockIndex*> rpcChainTip(nullptr);
+static std::atomic<const CBlockIndex*> rpcHeaderTip(nullptr);
+
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 extern void POSTxToJSON(const CPOSTransaction& tx, const uint256 hashBlock, UniValue& entry, const std::string hextx);
 
@@ -56,26 +66,21 @@ extern void POSTxToJSON(const CPOSTransaction& tx, const uint256 hashBlock, UniV
  */
 double GetDifficulty(const CChain& chain, const CBlockIndex* blockindex, uint8_t algo)
 {
-    unsigned int nBits;
-    unsigned int powLimit = Params().GetConsensus().aPOWAlgos[algo].GetArithPowLimit().GetCompact();
-	
     if (blockindex == nullptr)
-    {
-        if (chain.Tip() == nullptr)
-            nBits = powLimit;
-        else
-        {
-            //blockindex = chainActive.Tip();
-            blockindex = GetLastBlockIndexForAlgo(chain.Tip(), algo, Params().GetConsensus());
-            if (blockindex == nullptr)
-                nBits = powLimit;
-            else
-                nBits = blockindex->nBits;
-        }  
-    }
-    else
-    nBits = blockindex->nBits;
+        return GetDifficultyForAlgo(chain.Tip(), algo);
+
+    return GetDifficultyFromBits(blockindex->nBits);
+}
 
+double GetDifficultyForAlgo(const CBlockIndex* pindexTip, uint8_t algo)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const CBlockIndex* pindex = pindexTip ? GetLastBlockIndexForAlgo(pindexTip, algo, consensusParams) : nullptr;
+    return GetDifficultyFromBits(pindex ? pindex->nBits : consensusParams.aPOWAlgos[algo].GetArithPowLimit().GetCompact());
+}
+
+double GetDifficultyFromBits(uint32_t nBits)
+{
     int nShift = (nBits >> 24) & 0xff;
     double dDiff =
         (double)0x0000ffff / (double)(nBits & 0x00ffffff);
@@ -291,6 +296,69 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    AssertLockHeld(cs_main);
+	uint8_t algo = block.GetAlgo();
+    bool isauxpow = block.auxpow && (block.auxpow != nullptr);
+	const CBlockIndex *pnext = chainActive.Next(blockindex);
+	const CBlockIndex* plastAlgo = GetLastBlockIndexForAlgo(blockindex->pprev, algo, Params().GetConsensus());
+	const CBlockIndex* pnextAlgo = GetNextBlockIndexForAlgo(pnext, algo);
+    writer.BeginObject();
+    writer.KV("hash", blockindex->GetBlockHash().GetHex());
+    int confirmations = -1;
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(blockindex))
+        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    writer.KV("confirmations", confirmations);
+    writer.KV("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    writer.KV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.KV("weight", (int)::GetBlockWeight(block));
+    writer.KV("height", blockindex->nHeight);
+    writer.KV("algo", GetAlgoName(algo));
+	writer.KV("algoid", algo);
+    if(!isauxpow)
+        writer.KV("algopowhash", block.GetPoWHash(SER_GETHASH, LoadMultiHasherVersionFlags(Params().GetConsensus().Hardfork3.IsActivated(block.nTime))).GetHex());
+    writer.KV("version", block.nVersion);
+    writer.KV("versionHex", strprintf("%08x", block.nVersion));
+    writer.KV("merkleroot", block.hashMerkleRoot.GetHex());
+    // The transactions are by far the largest part, write them one at a time
+    writer.Key("tx");
+    writer.BeginArray();
+    for(const auto& tx : block.vtx)
+    {
+        if(txDetails)
+            TxToJSONWriter(writer, *tx, uint256(), true, RPCSerializationFlags());
+        else
+            writer.Value(tx->GetHash().GetHex());
+    }
+    writer.EndArray();
+    writer.KV("time", block.GetBlockTime());
+    writer.KV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+    if(IsEquihashBasedAlgo(algo))
+        writer.KV("nonce", block.nBigNonce.GetHex());
+    else
+        writer.KV("nonce", (uint64_t)block.nNonce);
+    if(!isauxpow && IsEquihashBasedAlgo(algo))
+        writer.KV("solution", HexStr(blockindex->nSolution));
+    writer.KV("bits", strprintf("%08x", block.nBits));
+    writer.KV("difficulty", UniValue(GetDifficulty(blockindex, algo)));
+    writer.KV("chainwork", blockindex->nChainWork.GetHex());
+    
+    if (block.auxpow)
+        writer.KV("auxpow", AuxpowToJSON(*block.auxpow, algo));
+
+    if (blockindex->pprev)
+        writer.KV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+	if (plastAlgo != nullptr)
+		writer.KV("previousalgohash", plastAlgo->GetBlockHash().GetHex());
+    if (pnext)
+        writer.KV("nextblockhash", pnext->GetBlockHash().GetHex());
+	if (pnextAlgo != nullptr)
+		writer.KV("nextalgohash", pnextAlgo->GetBlockHash().GetHex());
+    writer.EndObject();
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -304,8 +372,8 @@ UniValue getblockcount(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    const CBlockIndex* tip = GetRPCChainTip();
+    return tip ? tip->nHeight : -1;
 }
 
 UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -321,12 +389,35 @@ UniValue getbestblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
+    return GetRPCChainTip()->GetBlockHash().GetHex();
+}
+
+const CBlockIndex* GetRPCChainTip()
+{
+    const CBlockIndex* pindex = rpcChainTip.load();
+    if (pindex)
+        return pindex;
+    LOCK(cs_main);
+    return chainActive.Tip();
+}
+
+const CBlockIndex* GetRPCHeaderTip()
+{
+    const CBlockIndex* pindex = rpcHeaderTip.load();
+    if (pindex)
+        return pindex;
     LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return pindexBestHeader;
+}
+
+void RPCNotifyHeaderChange(bool ibd, const CBlockIndex* pindex)
+{
+    rpcHeaderTip = pindex;
 }
 
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
 {
+    rpcChainTip = pindex;
     if(pindex) {
         std::lock_guard<std::mutex> lock(cs_blockchange);
         latestblock.hash = pindex->GetBlockHash();
@@ -485,8 +576,7 @@ UniValue getdifficulty(const JSONRPCRequest& request)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    LOCK(cs_main);
-    return GetDifficulty(NULL, currentAlgo);
+    return GetDifficultyForAlgo(GetRPCChainTip(), currentAlgo);
 }
 
 std::string EntryDescriptionString()
@@ -945,77 +1035,6 @@ UniValue getblock(const JSONRPCRequest& request)
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
-struct CCoinsStats
-{
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nBogoSize;
-    uint256 hashSerialized;
-    uint64_t nDiskSize;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
-};
-
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
-{
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
-    stats.nTransactions++;
-    for (const auto output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
-    }
-    ss << VARINT(0);
-}
-
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
-        }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
-    stats.hashSerialized = ss.GetHash();
-    stats.nDiskSize = view->EstimateSize();
-    return true;
-}
-
 UniValue pruneblockchain(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1187,6 +1206,109 @@ UniValue gettxout(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set to a snapshot file, which loadtxoutset\n"
+            "or -loadsnapshot can load on a new node once its commitment is in the chain parameters.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, relative paths are relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,         (numeric) The number of coins written\n"
+            "  \"base_hash\": \"hash\",       (string) The block the snapshot was taken at\n"
+            "  \"base_height\": n,           (numeric) The height of that block\n"
+            "  \"nchaintx\": n,              (numeric) The number of transactions up to and including that block\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash, as in gettxoutsetinfo\n"
+            "  \"path\": \"path\"             (string) The absolute path of the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    const fs::path temppath = path.string() + ".incomplete";
+    if (fs::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    FlushStateToDisk();
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    const CBlockIndex* pindexBase;
+    {
+        LOCK(cs_main);
+        // A background chainstate flush may be half written
+        if (!pcoinsTip->FinishFlush(true))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to write to coin database");
+        pcursor.reset(pcoinsdbview->Cursor());
+        pindexBase = mapBlockIndex.at(pcursor->GetBestBlock());
+    }
+
+    CAutoFile file(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open " + temppath.string() + " for writing");
+    CCoinsStats stats;
+    if (!WriteUTXOSnapshot(pcursor.get(), file, stats))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    FileCommit(file.Get());
+    file.fclose();
+    if (!RenameOver(temppath, path))
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to rename " + temppath.string());
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("base_hash", stats.hashBlock.GetHex());
+    ret.pushKV("base_height", pindexBase->nHeight);
+    ret.pushKV("nchaintx", (int64_t)pindexBase->nChainTx);
+    ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoads a snapshot written by dumptxoutset and makes its base block the tip.\n"
+            "The snapshot must match the commitment in the chain parameters, the header of its base\n"
+            "block must be known and no block past genesis may be connected yet. The node shuts down\n"
+            "if the load fails after it began writing coins; the chainstate is then wiped on restart.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The snapshot file, relative paths are relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,      (numeric) The number of coins loaded\n"
+            "  \"base_hash\": \"hash\",   (string) The block the snapshot was taken at, now the tip\n"
+            "  \"base_height\": n        (numeric) The height of that block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (IsUTXOSnapshotPending())
+        throw JSONRPCError(RPC_MISC_ERROR, "A snapshot from -loadsnapshot is being loaded");
+
+    std::string strError;
+    CCoinsStats stats;
+    if (!VerifyUTXOSnapshot(path, Params(), stats, strError))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strError);
+    if (!LoadUTXOSnapshot(path, Params(), strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_loaded", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("base_hash", stats.hashBlock.GetHex());
+    ret.pushKV("base_height", stats.nHeight);
+    return ret;
+}
+
 UniValue verifychain(const JSONRPCRequest& request)
 {
     int nCheckLevel = gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL);
@@ -1786,25 +1908,27 @@ UniValue savemempool(const JSONRPCRequest& request)
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {} },
-    { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"} },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          {} },
-    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
-    { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
-    { "blockchain",         "getchaintips",           &getchaintips,           {} },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
-    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
-    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
-    { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
-    { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {}, true },
+    { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"}, true },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       {}, true },
+    { "blockchain",         "getblockcount",          &getblockcount,          {}, true },
+    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"}, true },
+    { "blockchain",         "getblockhash",           &getblockhash,           {"height"}, true },
+    { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"}, true },
+    { "blockchain",         "getchaintips",           &getchaintips,           {}, true },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          {}, true },
+    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"}, true },
+    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"}, true },
+    { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"}, true },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {}, true },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"}, true },
+    { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"}, true },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {}, true, 1 },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"}, true, 1 },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"}, false, 1 },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
-    { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
+    { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"}, true, 1 },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
 
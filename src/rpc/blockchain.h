@@ -7,6 +7,7 @@
 #include <stdint.h>
 class CBlock;
 class CBlockIndex;
+class CJSONStreamWriter;
 class UniValue;
 
 /**
@@ -18,12 +19,33 @@ class UniValue;
  */
 double GetDifficulty(const CBlockIndex* blockindex = nullptr, uint8_t algo = 0);
 
+/** Difficulty corresponding to a compact target, on the same scale as GetDifficulty */
+double GetDifficultyFromBits(uint32_t nBits);
+
+/** Difficulty of the last block of the given algo at or below pindexTip, or of its pow limit if there is none */
+double GetDifficultyForAlgo(const CBlockIndex* pindexTip, uint8_t algo);
+
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
+/** Callback for when the best header changed. */
+void RPCNotifyHeaderChange(bool ibd, const CBlockIndex *);
+
+/**
+ * Chain tip and best header as of the last notification. Read-only RPC
+ * methods use these instead of taking cs_main: walking pprev or
+ * GetAncestor() from them gives a consistent view of the chain even while
+ * the tip moves on.
+ */
+const CBlockIndex* GetRPCChainTip();
+const CBlockIndex* GetRPCHeaderTip();
+
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 
+/** Same output as blockToJSON, written without building a UniValue */
+void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
@@ -34,6 +34,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "generatetoaddress", 0, "nblocks" },
     { "generatetoaddress", 2, "maxtries" },
     { "getnetworkhashps", 0, "nblocks" },
+    { "getalgostats", 0, "start" },
+    { "getalgostats", 1, "end" },
+    { "getalgostats", 3, "verbose" },
     { "getnetworkhashps", 1, "height" },
     { "sendtoaddress", 1, "amount" },
     { "sendtoaddress", 4, "subtractfeefromamount" },
@@ -101,6 +104,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblock", 1, "verbosity" },
     { "getblock", 1, "verbose" },
     { "getblockheader", 1, "verbose" },
+    { "getaddressutxos", 0, "addresses" },
+    { "getaddressdeltas", 0, "addresses" },
+    { "getspentinfo", 0, "json" },
     { "getblocktreasury", 0, "height" },
     { "getchaintxstats", 0, "nblocks" },
     { "gettransaction", 1, "include_watchonly" },
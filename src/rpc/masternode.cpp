@@ -14,6 +14,7 @@
 #include <masternode-sync.h>
 #include <masternodeconfig.h>
 #include <masternodeman.h>
+#include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <script/standard.h>
 #include <util.h>
@@ -146,11 +147,7 @@ UniValue masternode(const JSONRPCRequest& request)
         int nCount;
         int nHeight;
         masternode_info_t mnInfo;
-        CBlockIndex* pindex = nullptr;
-        {
-            LOCK(cs_main);
-            pindex = chainActive.Tip();
-        }
+        const CBlockIndex* pindex = GetRPCChainTip();
         nHeight = pindex->nHeight + (strCommand == "current" ? 1 : 10);
         mnodeman.UpdateLastPaid(pindex);
 
@@ -331,6 +328,8 @@ UniValue masternode(const JSONRPCRequest& request)
         std::vector<COutput> vPossibleCoins;
         pwallet->AvailableCoins(vPossibleCoins, true, nullptr, 1, MAX_MONEY, MAX_MONEY, 0, 0, 9999999, ONLY_COLLATERAL, false);
 
+        const std::map<COutPoint, bool>& mapCollaterals = pwallet->GetCollateralOutputs();
+
         UniValue obj(UniValue::VOBJ);
         int counter = 0;
         for (const auto& out : vPossibleCoins) {
@@ -338,6 +337,8 @@ UniValue masternode(const JSONRPCRequest& request)
             UniValue entries(UniValue::VOBJ);
             entries.pushKV("txhash", out.tx->GetHash().ToString());
             entries.pushKV("txoutput", strprintf("%d", out.i));
+            auto it = mapCollaterals.find(COutPoint(out.tx->GetHash(), out.i));
+            entries.pushKV("locked", it != mapCollaterals.end() && it->second);
             obj.pushKV(strprintf("%d", counter), entries);
         }
 
@@ -404,14 +405,9 @@ UniValue masternode(const JSONRPCRequest& request)
 
     if (strCommand == "winners")
     {
-        int nHeight;
-        {
-            LOCK(cs_main);
-            CBlockIndex* pindex = chainActive.Tip();
-            if(!pindex) return NullUniValue;
-
-            nHeight = pindex->nHeight;
-        }
+        const CBlockIndex* pindex = GetRPCChainTip();
+        if(!pindex) return NullUniValue;
+        int nHeight = pindex->nHeight;
 
         int nLast = 10;
         std::string strFilter = "";
@@ -486,12 +482,7 @@ UniValue masternodelist(const JSONRPCRequest& request)
     }
 
     if (strMode == "full" || strMode == "json" || strMode == "lastpaidtime" || strMode == "lastpaidblock") {
-        CBlockIndex* pindex = nullptr;
-        {
-            LOCK(cs_main);
-            pindex = chainActive.Tip();
-        }
-        mnodeman.UpdateLastPaid(pindex);
+        mnodeman.UpdateLastPaid(GetRPCChainTip());
     }
 
     UniValue obj(UniValue::VOBJ);
@@ -862,7 +853,7 @@ static const CRPCCommand commands[] =
 { //  category                     name                      actor (function)         argNames
   //  ---------------------        ------------------------  -----------------------  ----------
     { "globaltoken",               "masternode",             &masternode,             {} },
-    { "globaltoken",               "masternodelist",         &masternodelist,         {} },
+    { "globaltoken",               "masternodelist",         &masternodelist,         {}, true, 2 },
     { "globaltoken",               "masternodebroadcast",    &masternodebroadcast,    {} },
 };
 
@@ -10,6 +10,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <base58.h>
+#include <algostats.h>
 #include <amount.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -39,6 +40,7 @@
 #include <masternode-payments.h>
 #include <masternode-sync.h>
 
+#include <limits>
 #include <memory>
 #include <stdint.h>
 
@@ -57,11 +59,11 @@ unsigned int ParseConfirmTarget(const UniValue& value)
  * or from the last difficulty change if 'lookup' is nonpositive.
  * If 'height' is nonnegative, compute the estimate at the time when a given block was found.
  */
-UniValue GetNetworkHashPS(uint8_t nAlgo, int lookup, int height) {
-    CBlockIndex *pb = chainActive.Tip();
+UniValue GetNetworkHashPS(uint8_t nAlgo, int lookup, int height, const CBlockIndex* pindexTip) {
+    const CBlockIndex *pb = pindexTip;
 
-    if (height >= 0 && height < chainActive.Height())
-        pb = chainActive[height];
+    if (pb != nullptr && height >= 0 && height < pb->nHeight)
+        pb = pb->GetAncestor(height);
 
     if (pb == nullptr || !pb->nHeight)
         return 0;
@@ -187,8 +189,6 @@ UniValue getnetworkhashps(const JSONRPCRequest& request)
             + HelpExampleRpc("getnetworkhashps", "")
         , GetAlgoRangeString()));
 
-    LOCK(cs_main);
-    
     uint8_t algo = currentAlgo;
     bool fAlgoFound = true;
     if (!request.params[2].isNull()) {
@@ -198,19 +198,18 @@ UniValue getnetworkhashps(const JSONRPCRequest& request)
     if(!fAlgoFound)
         throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid mining algorithm '%s' selected. Available algorithms: %s", request.params[2].get_str(), GetAlgoRangeString()));
     
-    return GetNetworkHashPS(algo, !request.params[0].isNull() ? request.params[0].get_int() : 24, !request.params[1].isNull() ? request.params[1].get_int() : -1);
+    return GetNetworkHashPS(algo, !request.params[0].isNull() ? request.params[0].get_int() : 24, !request.params[1].isNull() ? request.params[1].get_int() : -1, GetRPCChainTip());
 }
 
 UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript, uint8_t nAlgo)
 {
-	static const int nInnerLoopGlobalTokenMask = 0x1FFFF;
-    static const int nInnerLoopGlobalTokenCount = 0x10000;
-    static const int nInnerLoopEquihashMask = 0xFFFF;
-	static const int nInnerLoopEquihashCount = 0xFFFF;
+    static const uint32_t nInnerLoopGlobalTokenCount = 0x10000;
+    static const uint32_t nInnerLoopEquihashCount = 0xFFFF;
     int nHeightEnd = 0;
     int nHeight = 0;
-	int nInnerLoopCount;
-	int nInnerLoopMask;
+    int nThreads = gArgs.GetArg("-genproclimit", DEFAULT_GENERATE_THREADS);
+    if (nThreads < 0)
+        nThreads = GetNumCores();
 
     {   // Don't keep cs_main locked
         LOCK(cs_main);
@@ -220,8 +219,6 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
     unsigned int nExtraNonce = 0;
     UniValue blockHashes(UniValue::VARR);
 	const CChainParams& params = Params();
-	unsigned int n;
-    unsigned int k;
     while (nHeight < nHeightEnd)
     {
         std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript, nAlgo));
@@ -267,98 +264,21 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         }
         
         */
+        const CBlockIndex* pindexPrev;
         {
             LOCK(cs_main);
-            IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
+            pindexPrev = chainActive.Tip();
+            if (pblock->hashPrevBlock != pindexPrev->GetBlockHash())
+                continue;
+            IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
         }
-		if(params.GetConsensus().Hardfork1.IsActivated(pblock->nTime))
-		{
-			if(IsEquihashBasedAlgo(nAlgo))
-			{
-                CEquihashBlockHeader equihashblock = pblock->GetEquihashBlockHeader();
-				nInnerLoopMask = nInnerLoopEquihashMask;
-				nInnerLoopCount = nInnerLoopEquihashCount;
-                n = params.GetEquihashAlgoN(nAlgo);
-                k = params.GetEquihashAlgoK(nAlgo);
-				// Solve Equihash.
-				crypto_generichash_blake2b_state eh_state;
-                EhInitialiseState(n, k, eh_state, GetEquihashBasedDefaultPersonalize(nAlgo));
-
-				// I = the block header minus nonce and solution.
-				CEquihashInput I{equihashblock};
-				CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-				ss << I;
-
-				// H(I||...
-				crypto_generichash_blake2b_update(&eh_state, (unsigned char*)&ss[0], ss.size());
-
-				while (nMaxTries > 0 &&
-					   ((int)equihashblock.nNonce.GetUint64(0) & nInnerLoopEquihashMask) < nInnerLoopCount) {
-					// Yes, there is a chance every nonce could fail to satisfy the -regtest
-					// target -- 1 in 2^(2^256). That ain't gonna happen
-					equihashblock.nNonce = ArithToUint256(UintToArith256(equihashblock.nNonce) + 1);
-
-					// H(I||V||...
-					crypto_generichash_blake2b_state curr_state;
-					curr_state = eh_state;
-					crypto_generichash_blake2b_update(&curr_state,
-													  equihashblock.nNonce.begin(),
-													  equihashblock.nNonce.size());
-
-					// (x_1, x_2, ...) = A(I, V, n, k)
-					std::function<bool(std::vector<unsigned char>)> validBlock =
-							[&equihashblock, nAlgo](std::vector<unsigned char> soln) {
-						equihashblock.nSolution = soln;
-						return CheckProofOfWork(equihashblock.GetHash(), equihashblock.nBits, Params().GetConsensus(), nAlgo);
-					};
-					bool found = EhBasicSolveUncancellable(n, k, curr_state, validBlock);
-                    --nMaxTries;
-					if (found) {
-						break;
-					}
-				}
-                
-                // If Block is found convert CEquihashBlockHeader calculated stuff to pblock
-                
-                pblock->nBigNonce = equihashblock.nNonce;
-                pblock->nSolution = equihashblock.nSolution;
-			}
-			else
-			{
-                CDefaultBlockHeader defaultblockheader = pblock->GetDefaultBlockHeader();
-				nInnerLoopMask = nInnerLoopGlobalTokenMask;
-				nInnerLoopCount = nInnerLoopGlobalTokenCount;
-				while (nMaxTries > 0 && defaultblockheader.nNonce < nInnerLoopCount && !CheckProofOfWork(defaultblockheader.GetPoWHash(nAlgo, SER_GETHASH, LoadMultiHasherVersionFlags(Params().GetConsensus().Hardfork3.IsActivated(defaultblockheader.nTime))), defaultblockheader.nBits, Params().GetConsensus(), nAlgo)) {
-					++defaultblockheader.nNonce;
-					--nMaxTries;
-				}
-                
-                // If Block is found convert CDefaultBlockHeader calculated stuff to pblock
-                
-                pblock->nNonce = defaultblockheader.nNonce;
-			}
-		}
-		else
-		{
-            CDefaultBlockHeader defaultblockheader = pblock->GetDefaultBlockHeader();
-			nInnerLoopMask = nInnerLoopGlobalTokenMask;
-			nInnerLoopCount = nInnerLoopGlobalTokenCount;
-			while (nMaxTries > 0 && defaultblockheader.nNonce < nInnerLoopCount && !CheckProofOfWork(defaultblockheader.GetPoWHash(ALGO_SHA256D, SER_GETHASH, LoadMultiHasherVersionFlags(Params().GetConsensus().Hardfork3.IsActivated(defaultblockheader.nTime))), defaultblockheader.nBits, Params().GetConsensus(), ALGO_SHA256D)) {
-				++defaultblockheader.nNonce;
-				--nMaxTries;
-			}
-            
-            // If Block is found convert CDefaultBlockHeader calculated stuff to pblock
-                
-            pblock->nNonce = defaultblockheader.nNonce;
-		}
-        if (nMaxTries == 0) {
+        const uint32_t nNonceCount = IsEquihashBasedAlgo(pblock->GetAlgo()) && params.GetConsensus().Hardfork1.IsActivated(pblock->nTime) ? nInnerLoopEquihashCount : nInnerLoopGlobalTokenCount;
+        const PoWSearchResult result = SearchProofOfWork(*pblock, pindexPrev, params, nThreads, nNonceCount, nMaxTries);
+        if (result == PoWSearchResult::MAX_TRIES || result == PoWSearchResult::SHUTDOWN) {
             break;
         }
-        if (IsEquihashBasedAlgo(pblock->GetAlgo()) && ((int)pblock->nBigNonce.GetUint64(0) & nInnerLoopMask) == nInnerLoopCount) {
-            continue;
-        }
-        if (!IsEquihashBasedAlgo(pblock->GetAlgo()) && (pblock->nNonce & nInnerLoopMask) == nInnerLoopCount) {
+        if (result != PoWSearchResult::FOUND) {
+            // Nonce range exhausted or the tip moved: start over with a new template
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -382,6 +302,7 @@ UniValue generatetoaddress(const JSONRPCRequest& request)
         throw std::runtime_error(strprintf(
             "generatetoaddress nblocks address (maxtries)\n"
             "\nMine blocks immediately to a specified address (before the RPC call returns)\n"
+            "The proof of work is searched with -genproclimit threads.\n"
             "\nArguments:\n"
             "1. nblocks      (numeric, required) How many blocks are generated immediately.\n"
             "2. address      (string, required) The address to send the newly generated globaltoken to.\n"
@@ -471,12 +392,12 @@ UniValue getmininginfo(const JSONRPCRequest& request)
 	obj.pushKV("algoid",             currentAlgo);
 	obj.pushKV("algo",               GetAlgoName(currentAlgo));
     obj.pushKV("difficulty",         (double)GetDifficulty(NULL, currentAlgo));
-    obj.pushKV("networkhashps",      getnetworkhashps(request));
+    obj.pushKV("networkhashps",      GetNetworkHashPS(currentAlgo, 24, -1, chainActive.Tip()));
     for(uint8_t i = 0; i < NUM_ALGOS; i++)
     {
         UniValue currentAlgo(UniValue::VOBJ);
         currentAlgo.pushKV("difficulty",       (double)GetDifficulty(NULL, i));
-        currentAlgo.pushKV("nethashrate",      GetNetworkHashPS(i, 24, -1));
+        currentAlgo.pushKV("nethashrate",      GetNetworkHashPS(i, 24, -1, chainActive.Tip()));
         algodetails.pushKV(GetAlgoName(i), currentAlgo);
     }
 	obj.pushKV("algodetails", algodetails);
@@ -518,15 +439,15 @@ UniValue getalgoinfo(const JSONRPCRequest& request)
             + HelpExampleRpc("getalgoinfo", "")
         );
 
-    LOCK(cs_main);
-	
-    CBlockIndex* tip = chainActive.Tip();
+    // Works on the chain as of the last tip notification, without cs_main
+    const CBlockIndex* tip = GetRPCChainTip();
+    const CBlockIndex* pindexHeader = GetRPCHeaderTip();
 
     UniValue obj(UniValue::VOBJ);
     UniValue algos(UniValue::VOBJ);
 	
-    obj.pushKV("blocks",                (int)chainActive.Height());
-    obj.pushKV("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1);
+    obj.pushKV("blocks",                tip->nHeight);
+    obj.pushKV("headers",               pindexHeader ? pindexHeader->nHeight : -1);
     obj.pushKV("bestblockhash",         tip->GetBlockHash().GetHex());
     obj.pushKV("algos",                 NUM_ALGOS);
     obj.pushKV("lastblockalgo",         GetAlgoName(tip->GetAlgo()));
@@ -544,8 +465,8 @@ UniValue getalgoinfo(const JSONRPCRequest& request)
 	
         algo_description.pushKV("algoid",      consensusParams.aPOWAlgos[i].GetAlgoID());
         algo_description.pushKV("lastblock",   lastblock);
-        algo_description.pushKV("difficulty",  (double)GetDifficulty(NULL, consensusParams.aPOWAlgos[i].GetAlgoID()));
-        algo_description.pushKV("nethashrate", GetNetworkHashPS(consensusParams.aPOWAlgos[i].GetAlgoID(), 24, -1));
+        algo_description.pushKV("difficulty",  GetDifficultyForAlgo(tip, consensusParams.aPOWAlgos[i].GetAlgoID()));
+        algo_description.pushKV("nethashrate", GetNetworkHashPS(consensusParams.aPOWAlgos[i].GetAlgoID(), 24, -1, tip));
         algo_description.pushKV("lastdiffret", CalculateDiffRetargetingBlock(tip, RETARGETING_LAST, consensusParams.aPOWAlgos[i].GetAlgoID(), Params().GetConsensus()));
         algo_description.pushKV("nextdiffret", CalculateDiffRetargetingBlock(tip, RETARGETING_NEXT, consensusParams.aPOWAlgos[i].GetAlgoID(), Params().GetConsensus()));
         algos.pushKV(GetAlgoName(consensusParams.aPOWAlgos[i].GetAlgoID()), algo_description);
@@ -555,6 +476,159 @@ UniValue getalgoinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getalgostats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 4)
+        throw std::runtime_error(strprintf(
+            "getalgostats ( start end \"algo\" verbose )\n"
+            "\nReturns per-algorithm block statistics from the algo stats index (requires -algostatsindex).\n"
+            "Does not need the chain lock, so it is cheap to poll.\n"
+            "\nArguments:\n"
+            "1. start       (numeric, optional, default=end-%d) First block height of the window.\n"
+            "2. end         (numeric, optional, default=current height) Last block height of the window.\n"
+            "3. algo        (string, optional) Only return this algorithm (%s)\n"
+            "4. verbose     (boolean, optional, default=false) Include the blocks of each algo in the window.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\": xxxxxx,            (numeric) the height the statistics are valid at\n"
+            "  \"bestblockhash\": \"...\",      (string) the hash of that block\n"
+            "  \"start\": xxxxxx,             (numeric) first height of the window\n"
+            "  \"end\": xxxxxx,               (numeric) last height of the window\n"
+            "  \"algos\": {\n"
+            "     \"xxxx\" : {                 (string) name of the algorithm\n"
+            "        \"algoid\": xx,           (numeric) the ID of this algo\n"
+            "        \"blocks\": xx,           (numeric) blocks of this algo in the active chain\n"
+            "        \"auxpowblocks\": xx,     (numeric) how many of them were merge-mined\n"
+            "        \"lastblock\": xx,        (numeric) height of the last block of this algo, -1 if none\n"
+            "        \"difficulty\": xx,       (numeric) difficulty of the last block of this algo\n"
+            "        \"window\": {\n"
+            "          \"blocks\": xx,         (numeric) blocks of this algo in the window\n"
+            "          \"auxpowblocks\": xx,   (numeric) how many of them were merge-mined\n"
+            "          \"work\": \"xxxx\",     (string) hex of the work they represent at their own targets\n"
+            "          \"avgblocktime\": xx,   (numeric) mean seconds between consecutive blocks of this algo\n"
+            "          \"nethashrate\": xx,    (numeric) work per second between the first and last of them\n"
+            "          \"history\": [        (array, verbose only) the blocks of this algo in the window\n"
+            "            { \"height\": xx, \"time\": xx, \"bits\": \"xx\", \"difficulty\": xx, \"auxpow\": true|false, \"timedelta\": xx }, ...\n"
+            "          ]\n"
+            "        }\n"
+            "     }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getalgostats", "")
+            + HelpExampleCli("getalgostats", "1000 2000 \"sha256d\" true")
+            + HelpExampleRpc("getalgostats", "1000, 2000")
+        , DEFAULT_ALGOSTATS_WINDOW - 1, GetAlgoRangeString()));
+
+    if (!palgostatsindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index not available, start with -algostatsindex to enable it");
+    if (!palgostatsindex->IsSynced())
+        throw JSONRPCError(RPC_MISC_ERROR, "The algostats index is still being built, see debug.log for progress");
+
+    bool fFilter = false;
+    uint8_t nAlgoFilter = 0;
+    if (!request.params[2].isNull()) {
+        fFilter = true;
+        nAlgoFilter = GetAlgoByName(request.params[2].get_str(), 0, fFilter);
+        if (!fFilter)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid mining algorithm '%s' selected. Available algorithms: %s", request.params[2].get_str(), GetAlgoRangeString()));
+    }
+    const bool fVerbose = !request.params[3].isNull() && request.params[3].get_bool();
+
+    // Everything below comes from the index, without cs_main
+    std::vector<CAlgoStatsTotals> vTotals;
+    int nHeight;
+    uint256 hashBest;
+    palgostatsindex->GetTotals(vTotals, nHeight, hashBest);
+
+    int nEnd = request.params[1].isNull() ? nHeight : std::min(request.params[1].get_int(), nHeight);
+    int nStart = request.params[0].isNull() ? nEnd - DEFAULT_ALGOSTATS_WINDOW + 1 : request.params[0].get_int();
+    nStart = std::max(nStart, 0);
+    if (nStart > nEnd)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start height is above the end of the window");
+
+    std::vector<std::pair<int, CAlgoStatsEntry> > vEntries;
+    if (!palgostatsindex->ReadRange(nStart, nEnd, vEntries))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the algo stats index");
+
+    struct CWindowStats {
+        int nBlocks = 0;
+        int nAuxpowBlocks = 0;
+        arith_uint256 nWork;
+        int64_t nTimeDeltas = 0;
+        int nTimeDeltaCount = 0;
+        int64_t nMinTime = std::numeric_limits<int64_t>::max();
+        int64_t nMaxTime = std::numeric_limits<int64_t>::min();
+        UniValue history{UniValue::VARR};
+    };
+    std::vector<CWindowStats> vWindow(vTotals.size());
+    for (const auto& item : vEntries) {
+        const CAlgoStatsEntry& entry = item.second;
+        if (entry.nAlgo >= vWindow.size() || (fFilter && entry.nAlgo != nAlgoFilter))
+            continue;
+        CWindowStats& window = vWindow[entry.nAlgo];
+        window.nBlocks++;
+        if (entry.fAuxpow)
+            window.nAuxpowBlocks++;
+        window.nWork += GetBlockProofBase(entry.nBits);
+        // Only deltas to a block inside the window describe the window
+        if (entry.nPrevAlgoHeight >= nStart) {
+            window.nTimeDeltas += entry.nTimeDelta;
+            window.nTimeDeltaCount++;
+        }
+        window.nMinTime = std::min(window.nMinTime, (int64_t)entry.nTime);
+        window.nMaxTime = std::max(window.nMaxTime, (int64_t)entry.nTime);
+        if (fVerbose) {
+            UniValue block(UniValue::VOBJ);
+            block.pushKV("height", item.first);
+            block.pushKV("time", (int64_t)entry.nTime);
+            block.pushKV("bits", strprintf("%08x", entry.nBits));
+            block.pushKV("difficulty", GetDifficultyFromBits(entry.nBits));
+            block.pushKV("auxpow", entry.fAuxpow);
+            block.pushKV("timedelta", entry.nTimeDelta);
+            window.history.push_back(block);
+        }
+    }
+
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    UniValue algos(UniValue::VOBJ);
+    for (uint8_t i = 0; i < NUM_ALGOS; i++)
+    {
+        const uint8_t nAlgo = consensusParams.aPOWAlgos[i].GetAlgoID();
+        if ((fFilter && nAlgo != nAlgoFilter) || nAlgo >= vTotals.size())
+            continue;
+        const CAlgoStatsTotals& totals = vTotals[nAlgo];
+        const CWindowStats& window = vWindow[nAlgo];
+
+        UniValue windowObj(UniValue::VOBJ);
+        windowObj.pushKV("blocks", window.nBlocks);
+        windowObj.pushKV("auxpowblocks", window.nAuxpowBlocks);
+        windowObj.pushKV("work", window.nWork.GetHex());
+        windowObj.pushKV("avgblocktime", window.nTimeDeltaCount ? (double)window.nTimeDeltas / window.nTimeDeltaCount : 0.0);
+        // Same estimate as CalculateAlgoHashrate
+        windowObj.pushKV("nethashrate", window.nMaxTime > window.nMinTime ? window.nWork.getdouble() / (window.nMaxTime - window.nMinTime) : 0.0);
+        if (fVerbose)
+            windowObj.pushKV("history", window.history);
+
+        UniValue algo(UniValue::VOBJ);
+        algo.pushKV("algoid", nAlgo);
+        algo.pushKV("blocks", (uint64_t)totals.nBlocks);
+        algo.pushKV("auxpowblocks", (uint64_t)totals.nAuxpowBlocks);
+        algo.pushKV("lastblock", totals.nLastHeight);
+        algo.pushKV("difficulty", GetDifficultyFromBits(totals.nLastHeight >= 0 ? totals.nLastBits : consensusParams.aPOWAlgos[i].GetArithPowLimit().GetCompact()));
+        algo.pushKV("window", windowObj);
+        algos.pushKV(GetAlgoName(nAlgo), algo);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("height", nHeight);
+    obj.pushKV("bestblockhash", hashBest.GetHex());
+    obj.pushKV("start", nStart);
+    obj.pushKV("end", nEnd);
+    obj.pushKV("algos", algos);
+    return obj;
+}
+
 
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 UniValue prioritisetransaction(const JSONRPCRequest& request)
@@ -1706,10 +1780,11 @@ UniValue submitauxblock(const JSONRPCRequest& request)
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
-    { "mining",             "getalgoinfo",            &getalgoinfo,            {} },
+    { "mining",             "getalgoinfo",            &getalgoinfo,            {}, true },
+    { "mining",             "getalgostats",           &getalgostats,           {"start","end","algo","verbose"}, true },
     { "mining",             "getblocktreasury",       &getblocktreasury,       {"height"} },
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       {"nblocks","height"} },
-    { "mining",             "getmininginfo",          &getmininginfo,          {} },
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       {"nblocks","height"}, true },
+    { "mining",             "getmininginfo",          &getmininginfo,          {}, true },
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  {"txid","dummy","fee_delta"} },
     { "mining",             "getblocktemplate",       &getblocktemplate,       {"template_request","algo"} },
     { "mining",             "submitblock",            &submitblock,            {"hexdata","dummy"} },
@@ -4,6 +4,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <addressindex.h>
 #include <base58.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -351,6 +352,206 @@ UniValue signmessagewithprivkey(const JSONRPCRequest& request)
     return EncodeBase64(vchSig.data(), vchSig.size());
 }
 
+/** Decode the addresses of an address index query: a single address string or {"addresses": [...]} */
+static std::vector<std::pair<uint8_t, uint160> > ParseAddressIndexAddresses(const UniValue& param)
+{
+    std::vector<UniValue> vValues;
+    if (param.isStr()) {
+        vValues.push_back(param);
+    } else if (param.isObject()) {
+        const UniValue& addresses = find_value(param.get_obj(), "addresses");
+        if (!addresses.isArray())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        vValues = addresses.getValues();
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an addresses array");
+    }
+
+    std::vector<std::pair<uint8_t, uint160> > vAddresses;
+    for (const UniValue& value : vValues) {
+        uint8_t type;
+        uint160 hashBytes;
+        CTxDestination dest = DecodeDestination(value.get_str());
+        if (!IsValidDestination(dest) || !GetAddressIndexKey(dest, type, hashBytes))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + value.get_str());
+        vAddresses.emplace_back(type, hashBytes);
+    }
+    return vAddresses;
+}
+
+static void EnsureIndexSynced(const CChainIndexDB* pdb, const std::string& strOption)
+{
+    if (!pdb)
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Index not available, start with -%s to enable it", strOption));
+    if (!pdb->IsSynced())
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("The %s index is still being built, see debug.log for progress", pdb->GetName()));
+}
+
+UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddressutxos {\"addresses\": [\"address\",...]}\n"
+            "\nReturns the unspent outputs of the given addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. {\n"
+            "  \"addresses\"    (array, required) The globaltoken addresses\n"
+            "    [\n"
+            "      \"address\"  (string) The globaltoken address\n"
+            "      ,...\n"
+            "    ]\n"
+            "}\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\"  (string) The address\n"
+            "    \"txid\"  (string) The output txid\n"
+            "    \"outputIndex\"  (number) The output index\n"
+            "    \"script\"  (string) The script hex\n"
+            "    \"satoshis\"  (number) The number of satoshis of the output\n"
+            "    \"height\"  (number) The block height\n"
+            "  }\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"GKFQAACvBe1Zvy3VpVfCpRQcRipD9EL6Dp\"]}'")
+            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"GKFQAACvBe1Zvy3VpVfCpRQcRipD9EL6Dp\"]}")
+        );
+
+    EnsureIndexSynced(paddressindex.get(), "addressindex");
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspentOutputs;
+    for (const auto& address : ParseAddressIndexAddresses(request.params[0])) {
+        if (!paddressindex->ReadAddressUnspentIndex(address.first, address.second, vUnspentOutputs))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to get address unspent outputs");
+    }
+
+    std::stable_sort(vUnspentOutputs.begin(), vUnspentOutputs.end(),
+        [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a, const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+            return a.second.nHeight < b.second.nHeight;
+        });
+
+    UniValue result(UniValue::VARR);
+    for (const auto& it : vUnspentOutputs) {
+        UniValue output(UniValue::VOBJ);
+        output.pushKV("address", EncodeDestination(GetAddressIndexDestination(it.first.type, it.first.hashBytes)));
+        output.pushKV("txid", it.first.txhash.GetHex());
+        output.pushKV("outputIndex", (int)it.first.index);
+        output.pushKV("script", HexStr(it.second.script.begin(), it.second.script.end()));
+        output.pushKV("satoshis", it.second.nValue);
+        output.pushKV("height", it.second.nHeight);
+        result.push_back(output);
+    }
+    return result;
+}
+
+UniValue getaddressdeltas(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddressdeltas {\"addresses\": [\"address\",...], \"start\": n, \"end\": n}\n"
+            "\nReturns all changes to the balance of the given addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. {\n"
+            "  \"addresses\"    (array, required) The globaltoken addresses\n"
+            "    [\n"
+            "      \"address\"  (string) The globaltoken address\n"
+            "      ,...\n"
+            "    ]\n"
+            "  \"start\"        (number, optional) The start block height\n"
+            "  \"end\"          (number, optional) The end block height\n"
+            "}\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"satoshis\"  (number) The difference of satoshis\n"
+            "    \"txid\"  (string) The related txid\n"
+            "    \"index\"  (number) The related input or output index\n"
+            "    \"blockindex\"  (number) The position of the transaction in its block\n"
+            "    \"height\"  (number) The block height\n"
+            "    \"address\"  (string) The address\n"
+            "  }\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"GKFQAACvBe1Zvy3VpVfCpRQcRipD9EL6Dp\"], \"start\": 1000, \"end\": 2000}'")
+            + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"GKFQAACvBe1Zvy3VpVfCpRQcRipD9EL6Dp\"], \"start\": 1000, \"end\": 2000}")
+        );
+
+    EnsureIndexSynced(paddressindex.get(), "addressindex");
+
+    int nStart = 0;
+    int nEnd = 0;
+    if (request.params[0].isObject()) {
+        const UniValue& start = find_value(request.params[0].get_obj(), "start");
+        const UniValue& end = find_value(request.params[0].get_obj(), "end");
+        if (!start.isNull())
+            nStart = start.get_int();
+        if (!end.isNull())
+            nEnd = end.get_int();
+        if (nStart < 0 || nEnd < 0 || (nEnd > 0 && nEnd < nStart))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end heights must be positive, with end not below start");
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const auto& address : ParseAddressIndexAddresses(request.params[0])) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+        if (!paddressindex->ReadAddressIndex(address.first, address.second, vAddressIndex, nStart, nEnd))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to get address history");
+
+        const std::string strAddress = EncodeDestination(GetAddressIndexDestination(address.first, address.second));
+        for (const auto& it : vAddressIndex) {
+            UniValue delta(UniValue::VOBJ);
+            delta.pushKV("satoshis", it.second);
+            delta.pushKV("txid", it.first.txhash.GetHex());
+            delta.pushKV("index", (int)it.first.index);
+            delta.pushKV("blockindex", (int)it.first.nTxIndex);
+            delta.pushKV("height", it.first.nHeight);
+            delta.pushKV("address", strAddress);
+            result.push_back(delta);
+        }
+    }
+    return result;
+}
+
+UniValue getspentinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
+        throw std::runtime_error(
+            "getspentinfo {\"txid\": \"hex\", \"index\": n}\n"
+            "\nReturns the txid and input index spending the given output (requires -spentindex).\n"
+            "\nArguments:\n"
+            "1. {\n"
+            "  \"txid\"   (string, required) The hex string of the txid\n"
+            "  \"index\"  (number, required) The output index\n"
+            "}\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\"  (string) The spending transaction id\n"
+            "  \"index\"  (number) The spending input index\n"
+            "  \"height\"  (number) The height of the block containing the spending transaction\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'")
+            + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
+        );
+
+    EnsureIndexSynced(pspentindex.get(), "spentindex");
+
+    const UniValue& txid = find_value(request.params[0].get_obj(), "txid");
+    const UniValue& index = find_value(request.params[0].get_obj(), "index");
+    if (!txid.isStr() || !index.isNum())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid txid or index");
+
+    CSpentIndexValue value;
+    if (!pspentindex->ReadSpentIndex(CSpentIndexKey(ParseHashV(txid, "txid"), index.get_int()), value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("txid", value.txid.GetHex());
+    result.pushKV("index", (int)value.inputIndex);
+    result.pushKV("height", value.nHeight);
+    return result;
+}
+
 UniValue setmocktime(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -691,14 +892,19 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
-    { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
+    { "util",               "validateaddress",        &validateaddress,        {"address"}, true }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
     { "util",               "helpnewscriptaddress",   &helpnewscriptaddress,   {} },
     { "util",               "convertoldscriptaddress",&convertoldscriptaddress,{"address"} },
-    { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
+    { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"}, true },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, {"privkey","message"} },
     { "util",               "listattackersaddresses", &listattackersaddresses, {} },
     
+    /* Address index */
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        {"addresses"}, true, 4 },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       {"addresses"}, true, 4 },
+    { "addressindex",       "getspentinfo",           &getspentinfo,           {"json"}, true },
+
     /* Globaltoken features */
     { "globaltoken",        "mnsync",                 &mnsync,                 {} },
     { "globaltoken",        "spork",                  &spork,                  {"value"} },
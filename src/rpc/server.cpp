@@ -31,6 +31,8 @@ static CCriticalSection cs_rpcWarmup;
 static RPCTimerInterface* timerInterface = nullptr;
 /* Map of name to timer. */
 static std::map<std::string, std::unique_ptr<RPCTimerBase> > deadlineTimers;
+/* Map of method name to its concurrency limit. Filled at startup by InitRPCMethodLimits, read-only afterwards. */
+static std::map<std::string, std::unique_ptr<CSemaphore> > mapMethodLimits;
 
 static struct CRPCSignals
 {
@@ -263,9 +265,9 @@ static const CRPCCommand vRPCCommands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     /* Overall control/query calls */
-    { "control",            "help",                   &help,                   {"command"}  },
+    { "control",            "help",                   &help,                   {"command"},        true },
     { "control",            "stop",                   &stop,                   {}  },
-    { "control",            "uptime",                 &uptime,                 {}  },
+    { "control",            "uptime",                 &uptime,                 {},                 true },
 };
 
 CRPCTable::CRPCTable()
@@ -302,6 +304,39 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool InitRPCMethodLimits(std::string& strError)
+{
+    std::map<std::string, int> mapLimits;
+    for (const std::string& strMethod : tableRPC.listCommands()) {
+        const CRPCCommand* pcmd = tableRPC[strMethod];
+        if (pcmd->nMaxConcurrency > 0)
+            mapLimits[strMethod] = pcmd->nMaxConcurrency;
+    }
+    for (const std::string& strLimit : gArgs.GetArgs("-rpcmethodlimit")) {
+        const size_t nPos = strLimit.rfind(':');
+        int32_t nLimit;
+        if (nPos == std::string::npos || !ParseInt32(strLimit.substr(nPos + 1), &nLimit) || nLimit < 0) {
+            strError = strprintf(_("Invalid -rpcmethodlimit=%s, expected <method>:<n>"), strLimit);
+            return false;
+        }
+        const std::string strMethod = strLimit.substr(0, nPos);
+        if (!tableRPC[strMethod]) {
+            strError = strprintf(_("Invalid -rpcmethodlimit=%s, unknown method %s"), strLimit, strMethod);
+            return false;
+        }
+        mapLimits[strMethod] = nLimit;
+    }
+
+    mapMethodLimits.clear();
+    for (const auto& limit : mapLimits) {
+        if (limit.second == 0)
+            continue;
+        mapMethodLimits.emplace(limit.first, MakeUnique<CSemaphore>(limit.second));
+        LogPrint(BCLog::RPC, "Limiting %s to %d concurrent calls\n", limit.first, limit.second);
+    }
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
@@ -410,12 +445,41 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+static bool IsReadOnlyRequest(const UniValue& req)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    if (!req.isObject())
+        return false;
+    const UniValue& valMethod = find_value(req, "method");
+    if (!valMethod.isStr())
+        return false;
+    const CRPCCommand* pcmd = tableRPC[valMethod.get_str()];
+    return pcmd && pcmd->fReadOnly;
+}
 
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCParallelFor& parallelFor)
+{
+    std::vector<UniValue> vReply(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        // Find the run of read-only calls starting here
+        const size_t nStart = reqIdx;
+        reqIdx++;
+        if (parallelFor && IsReadOnlyRequest(vReq[nStart])) {
+            while (reqIdx < vReq.size() && IsReadOnlyRequest(vReq[reqIdx]))
+                reqIdx++;
+        }
+
+        if (reqIdx - nStart > 1) {
+            parallelFor(reqIdx - nStart, [&](size_t i) {
+                vReply[nStart + i] = JSONRPCExecOne(jreq, vReq[nStart + i]);
+            });
+        } else {
+            vReply[nStart] = JSONRPCExecOne(jreq, vReq[nStart]);
+        }
+    }
+
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(vReply);
     return ret.write() + "\n";
 }
 
@@ -483,6 +547,17 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     if (!pcmd)
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
 
+    // Calls over the method's limit are turned away rather than queued, so
+    // that a burst of heavy calls cannot occupy every HTTP worker
+    CSemaphoreGrant grant;
+    std::map<std::string, std::unique_ptr<CSemaphore> >::const_iterator itLimit = mapMethodLimits.find(pcmd->name);
+    if (itLimit != mapMethodLimits.end()) {
+        CSemaphoreGrant tryGrant(*itLimit->second, true);
+        if (!tryGrant)
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("Too many concurrent %s calls, try again later", pcmd->name));
+        tryGrant.MoveTo(grant);
+    }
+
     g_rpcSignals.PreCommand(*pcmd);
 
     try
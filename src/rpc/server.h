@@ -10,6 +10,7 @@
 #include <rpc/protocol.h>
 #include <uint256.h>
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -130,10 +131,19 @@ typedef UniValue(*rpcfn_type)(const JSONRPCRequest& jsonRequest);
 class CRPCCommand
 {
 public:
+    CRPCCommand(std::string categoryIn, std::string nameIn, rpcfn_type actorIn, std::vector<std::string> argNamesIn,
+                bool fReadOnlyIn = false, int nMaxConcurrencyIn = 0)
+        : category(std::move(categoryIn)), name(std::move(nameIn)), actor(actorIn), argNames(std::move(argNamesIn)),
+          fReadOnly(fReadOnlyIn), nMaxConcurrency(nMaxConcurrencyIn) {}
+
     std::string category;
     std::string name;
     rpcfn_type actor;
     std::vector<std::string> argNames;
+    //! Has no side effects, so calls in a batch may run concurrently and out of order
+    bool fReadOnly;
+    //! Default limit on concurrent calls of this method, 0 for none (see -rpcmethodlimit)
+    int nMaxConcurrency;
 };
 
 /**
@@ -188,10 +198,21 @@ extern CAmount AmountFromValue(const UniValue& value);
 extern std::string HelpExampleCli(const std::string& methodname, const std::string& args);
 extern std::string HelpExampleRpc(const std::string& methodname, const std::string& args);
 
+/** Set up the per-method concurrency limits from the command table and -rpcmethodlimit. Call after all commands are registered. */
+bool InitRPCMethodLimits(std::string& strError);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+
+/** Runs func(0) .. func(nCount - 1), possibly concurrently, and returns when all have finished */
+typedef std::function<void(size_t nCount, const std::function<void(size_t)>& func)> RPCParallelFor;
+
+/**
+ * Execute a JSON-RPC batch. Consecutive read-only calls are handed to
+ * parallelFor when one is given; any other call waits for the calls before
+ * it and runs alone, so side effects keep the order of the batch.
+ */
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCParallelFor& parallelFor = nullptr);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
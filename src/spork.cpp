@@ -9,6 +9,7 @@
 #include <chainparams.h>
 #include <globaltoken/hardfork.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <wallet/wallet.h>
 #include <messagesigner.h>
 #include <net_processing.h>
@@ -18,7 +19,6 @@
 
 CSporkManager sporkManager;
 
-std::map<uint256, CSporkMessage> mapSporks;
 std::map<int, int64_t> mapSporkDefaults = {
     {SPORK_1_INSTANTSEND_ENABLED,            0},             // ON
     {SPORK_2_INSTANTSEND_BLOCK_FILTERING,    0},             // ON
@@ -43,20 +43,23 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
         std::string strLogMsg;
         {
             LOCK(cs_main);
-            pfrom->setAskFor.erase(hash);
+            pfrom->RemoveAskFor(hash);
             if(!chainActive.Tip()) return;
             strLogMsg = strprintf("SPORK -- hash: %s id: %d value: %10d bestHeight: %d peer=%d", hash.ToString(), spork.nSporkID, spork.nValue, chainActive.Height(), pfrom->GetId());
         }
 
-        if(mapSporksActive.count(spork.nSporkID)) {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
-                LogPrint(BCLog::SPORK, "%s seen\n", strLogMsg);
-                return;
+        {
+            LOCK(cs);
+            if(mapSporksActive.count(spork.nSporkID)) {
+                if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
+                    LogPrint(BCLog::SPORK, "%s seen\n", strLogMsg);
+                    return;
+                } else {
+                    LogPrintf("%s updated\n", strLogMsg);
+                }
             } else {
-                LogPrintf("%s updated\n", strLogMsg);
+                LogPrintf("%s new\n", strLogMsg);
             }
-        } else {
-            LogPrintf("%s new\n", strLogMsg);
         }
 
         if(!spork.CheckSignature(sporkPubKeyID)) {
@@ -66,15 +69,20 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             return;
         }
 
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        {
+            LOCK(cs);
+            mapSporksByHash[hash] = spork;
+            mapSporksActive[spork.nSporkID] = spork;
+        }
         spork.Relay(connman);
+        GetMainSignals().NotifySpork(spork);
 
         //does a task if needed
         ExecuteSpork(spork.nSporkID, spork.nValue);
 
     } else if (strCommand == NetMsgType::GETSPORKS) {
 
+        LOCK(cs);
         std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
 
         while(it != mapSporksActive.end()) {
@@ -121,8 +129,12 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
 
     if(spork.Sign(sporkPrivKey)) {
         spork.Relay(connman);
-        mapSporks[spork.GetHash()] = spork;
-        mapSporksActive[nSporkID] = spork;
+        {
+            LOCK(cs);
+            mapSporksByHash[spork.GetHash()] = spork;
+            mapSporksActive[nSporkID] = spork;
+        }
+        GetMainSignals().NotifySpork(spork);
         return true;
     }
 
@@ -135,6 +147,7 @@ bool CSporkManager::IsSporkActive(int nSporkID)
     if(!Params().GetConsensus().Hardfork1.IsActivated((uint32_t)GetAdjustedTime()))
         return false;
     
+    LOCK(cs);
     int64_t r = -1;
 
     if(mapSporksActive.count(nSporkID)){
@@ -152,6 +165,7 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
+    LOCK(cs);
     if (mapSporksActive.count(nSporkID))
         return mapSporksActive[nSporkID].nValue;
 
@@ -163,6 +177,18 @@ int64_t CSporkManager::GetSporkValue(int nSporkID)
     return -1;
 }
 
+bool CSporkManager::GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet) const
+{
+    LOCK(cs);
+
+    const auto it = mapSporksByHash.find(hash);
+    if (it == mapSporksByHash.end())
+        return false;
+
+    sporkRet = it->second;
+    return true;
+}
+
 int CSporkManager::GetSporkIDByName(const std::string& strName)
 {
     if (strName == "SPORK_1_INSTANTSEND_ENABLED")               return SPORK_1_INSTANTSEND_ENABLED;
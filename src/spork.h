@@ -30,7 +30,6 @@ static const int SPORK_START                                            = SPORK_
 static const int SPORK_END                                              = SPORK_7_RECONSIDER_BLOCKS;
 
 extern std::map<int, int64_t> mapSporkDefaults;
-extern std::map<uint256, CSporkMessage> mapSporks;
 extern CSporkManager sporkManager;
 
 //
@@ -85,7 +84,11 @@ public:
 class CSporkManager
 {
 private:
+    // critical section to protect the inner data structures, spork messages
+    // are handled on their own thread
+    mutable CCriticalSection cs;
     std::vector<unsigned char> vchSig;
+    std::map<uint256, CSporkMessage> mapSporksByHash;
     std::map<int, CSporkMessage> mapSporksActive;
 
     CKeyID sporkPubKeyID;
@@ -101,6 +104,7 @@ public:
 
     bool IsSporkActive(int nSporkID);
     int64_t GetSporkValue(int nSporkID);
+    bool GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet) const;
     int GetSporkIDByName(const std::string& strName);
     std::string GetSporkNameByID(int nSporkID);
 
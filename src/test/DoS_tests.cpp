@@ -5,9 +5,12 @@
 // Unit tests for denial-of-service detection/prevention code
 
 #include <chainparams.h>
+#include <consensus/validation.h>
+#include <hash.h>
 #include <keystore.h>
 #include <net.h>
 #include <net_processing.h>
+#include <netmessagemaker.h>
 #include <pow.h>
 #include <script/sign.h>
 #include <serialize.h>
@@ -30,6 +33,7 @@ struct COrphanTx {
     int64_t nTimeExpire;
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern void ChargePowCheck(NodeId nodeid, int64_t nTime);
 
 CService ip(uint32_t i)
 {
@@ -258,6 +262,207 @@ BOOST_AUTO_TEST_CASE(DoS_banscore)
     peerLogic->FinalizeNode(dummyNode1.GetId(), dummy);
 }
 
+BOOST_AUTO_TEST_CASE(DoS_message_worker_queue)
+{
+    CAddress addr(ip(0xa0b0c005), NODE_NONE);
+    CNode dummyNode(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr, 5, 5, CAddress(), "", true);
+
+    std::mutex gate;
+    std::vector<int> vHandled;
+    CMessageWorkerQueue worker("test", 2, 2, [&](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) {
+        std::lock_guard<std::mutex> lock(gate);
+        int n;
+        vRecv >> n;
+        vHandled.push_back(n);
+    });
+    const auto push = [&](int n) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << n;
+        return worker.Push(&dummyNode, NetMsgType::MNPING, std::move(ss));
+    };
+
+    // Not running: the caller has to handle the message itself
+    BOOST_CHECK(!push(0));
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+
+    worker.Start();
+    {
+        std::unique_lock<std::mutex> lock(gate);
+        // The first message gets picked up and blocks the worker
+        BOOST_CHECK(push(1));
+        while (worker.Size() != 0)
+            MilliSleep(1);
+        // The next two fill the queue, the last one is dropped
+        BOOST_CHECK(push(2));
+        BOOST_CHECK(push(3));
+        BOOST_CHECK(push(4));
+        BOOST_CHECK_EQUAL(worker.Size(), 2U);
+        BOOST_CHECK_EQUAL(worker.GetDroppedCount(), 1U);
+        BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 3);
+    }
+    while (worker.Size() != 0)
+        MilliSleep(1);
+    worker.Stop();
+
+    BOOST_CHECK(vHandled == std::vector<int>({1, 2, 3}));
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+    BOOST_CHECK(!push(5));
+}
+
+BOOST_AUTO_TEST_CASE(DoS_message_worker_queue_per_peer)
+{
+    CAddress addr1(ip(0xa0b0c007), NODE_NONE);
+    CNode dummyNode1(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr1, 7, 7, CAddress(), "", true);
+    CAddress addr2(ip(0xa0b0c008), NODE_NONE);
+    CNode dummyNode2(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr2, 8, 8, CAddress(), "", true);
+
+    std::mutex gate;
+    std::vector<std::pair<NodeId, int>> vHandled;
+    CMessageWorkerQueue worker("test", 4, 2, [&](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) {
+        std::lock_guard<std::mutex> lock(gate);
+        int n;
+        vRecv >> n;
+        vHandled.emplace_back(pfrom->GetId(), n);
+    });
+    const auto push = [&](CNode& node, int n) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << n;
+        return worker.Push(&node, NetMsgType::MNPING, std::move(ss));
+    };
+
+    worker.Start();
+    {
+        std::unique_lock<std::mutex> lock(gate);
+        // The first message gets picked up and blocks the worker
+        BOOST_CHECK(push(dummyNode1, 1));
+        while (worker.Size() != 0)
+            MilliSleep(1);
+        // Peer 1 floods: only its share of the queue is taken
+        for (int n = 2; n < 10; n++)
+            BOOST_CHECK(push(dummyNode1, n));
+        BOOST_CHECK_EQUAL(worker.Size(), 2U);
+        BOOST_CHECK_EQUAL(worker.GetDroppedCount(), 6U);
+        // Peer 2's messages still get through
+        BOOST_CHECK(push(dummyNode2, 1));
+        BOOST_CHECK(push(dummyNode2, 2));
+        BOOST_CHECK_EQUAL(worker.Size(), 4U);
+        BOOST_CHECK_EQUAL(worker.GetDroppedCount(), 6U);
+        BOOST_CHECK_EQUAL(dummyNode2.GetRefCount(), 2);
+    }
+    while (worker.Size() != 0)
+        MilliSleep(1);
+    // Once its messages are handled, peer 1 may queue again
+    BOOST_CHECK(push(dummyNode1, 10));
+    while (worker.Size() != 0)
+        MilliSleep(1);
+    worker.Stop();
+
+    const std::vector<std::pair<NodeId, int>> vExpected{
+        {dummyNode1.GetId(), 1}, {dummyNode1.GetId(), 2}, {dummyNode1.GetId(), 3},
+        {dummyNode2.GetId(), 1}, {dummyNode2.GetId(), 2}, {dummyNode1.GetId(), 10}};
+    BOOST_CHECK(vHandled == vExpected);
+    BOOST_CHECK_EQUAL(dummyNode1.GetRefCount(), 0);
+    BOOST_CHECK_EQUAL(dummyNode2.GetRefCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(DoS_header_checks_before_pow)
+{
+    const CChainParams& chainparams = Params();
+    CBlockHeader header;
+    header.SetAlgo(ALGO_SHA256D);
+    unsigned int nBitsRequired;
+    {
+        LOCK(cs_main);
+        header.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+        header.nTime = chainActive.Tip()->GetMedianTimePast() + 1;
+        nBitsRequired = GetNextWorkRequired(chainActive.Tip(), &header, chainparams.GetConsensus(), header.GetAlgo());
+    }
+    // A target this header cannot meet: the wrong nBits is reported, not
+    // the proof of work, which is no longer computed
+    header.nBits = 0x1b0404cb;
+    BOOST_CHECK(header.nBits != nBitsRequired);
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(!PreCheckBlockHeader(header, state, chainparams));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-diffbits");
+    }
+    state = CValidationState();
+    BOOST_CHECK(!ProcessNewBlockHeaders({header}, state, chainparams));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-diffbits");
+
+    header.hashPrevBlock = InsecureRand256();
+    state = CValidationState();
+    BOOST_CHECK(!ProcessNewBlockHeaders({header}, state, chainparams));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "prev-blk-not-found");
+
+    LOCK(cs_main);
+    state = CValidationState();
+    BOOST_CHECK(PreCheckBlockHeader(chainActive.Tip()->GetBlockHeader(chainparams.GetConsensus()), state, chainparams));
+}
+
+/** Hand a message to the node as if it had been received */
+static void QueueMessage(CNode& node, const CSerializedNetMsg& msg)
+{
+    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+    uint256 hash = Hash(msg.data.begin(), msg.data.end());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream ssHeader(SER_NETWORK, INIT_PROTO_VERSION);
+    ssHeader << hdr;
+
+    CNetMessage netmsg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    netmsg.readHeader(ssHeader.data(), ssHeader.size());
+    netmsg.readData((const char*)msg.data.data(), msg.data.size());
+    LOCK(node.cs_vProcessMsg);
+    node.nProcessQueueSize += msg.data.size() + CMessageHeader::HEADER_SIZE;
+    node.vProcessMsg.push_back(std::move(netmsg));
+}
+
+BOOST_AUTO_TEST_CASE(DoS_pow_check_budget)
+{
+    std::atomic<bool> interruptDummy(false);
+    CAddress addr(ip(0xa0b0c006), NODE_NONE);
+    CNode dummyNode(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr, 6, 6, CAddress(), "", true);
+    dummyNode.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode);
+    dummyNode.nVersion = 1;
+    dummyNode.fSuccessfullyConnected = true;
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+
+    // Within its budget, headers are handled right away
+    {
+        LOCK(cs_main);
+        ChargePowCheck(dummyNode.GetId(), POW_CHECK_BUDGET_MAX / 2);
+    }
+    QueueMessage(dummyNode, msgMaker.Make(NetMsgType::HEADERS, std::vector<CBlockHeader>()));
+    peerLogic->ProcessMessages(&dummyNode, interruptDummy);
+    BOOST_CHECK(dummyNode.vProcessMsg.empty());
+
+    // Once it is used up they wait, and so does everything queued behind them
+    {
+        LOCK(cs_main);
+        ChargePowCheck(dummyNode.GetId(), POW_CHECK_BUDGET_MAX);
+    }
+    QueueMessage(dummyNode, msgMaker.Make(NetMsgType::PING, (uint64_t)1));
+    QueueMessage(dummyNode, msgMaker.Make(NetMsgType::HEADERS, std::vector<CBlockHeader>()));
+    QueueMessage(dummyNode, msgMaker.Make(NetMsgType::PING, (uint64_t)2));
+    BOOST_CHECK(peerLogic->ProcessMessages(&dummyNode, interruptDummy));
+    BOOST_CHECK(!peerLogic->ProcessMessages(&dummyNode, interruptDummy));
+    BOOST_CHECK_EQUAL(dummyNode.vProcessMsg.size(), 2U);
+    BOOST_CHECK_EQUAL(dummyNode.vProcessMsg.front().hdr.GetCommand(), NetMsgType::HEADERS);
+    BOOST_CHECK_EQUAL(dummyNode.vProcessMsg.back().hdr.GetCommand(), NetMsgType::PING);
+
+    // Unless the peer is whitelisted
+    dummyNode.fWhitelisted = true;
+    BOOST_CHECK(peerLogic->ProcessMessages(&dummyNode, interruptDummy));
+    BOOST_CHECK(!peerLogic->ProcessMessages(&dummyNode, interruptDummy));
+    BOOST_CHECK(dummyNode.vProcessMsg.empty());
+    BOOST_CHECK(!dummyNode.fDisconnect);
+
+    bool dummy;
+    peerLogic->FinalizeNode(dummyNode.GetId(), dummy);
+}
+
 BOOST_AUTO_TEST_CASE(DoS_bantime)
 {
     std::atomic<bool> interruptDummy(false);
@@ -0,0 +1,150 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <addressindex.h>
+#include <chain.h>
+#include <coins.h>
+#include <key.h>
+#include <primitives/block.h>
+#include <script/standard.h>
+#include <undo.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(addressindex_keys)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+
+    uint8_t type;
+    uint160 hashBytes;
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForDestination(pubkey.GetID()), type, hashBytes));
+    BOOST_CHECK(type == ADDRESSINDEX_P2PKH && hashBytes == pubkey.GetID());
+    // Pay-to-pubkey outputs are indexed under the key's address
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForRawPubKey(pubkey), type, hashBytes));
+    BOOST_CHECK(type == ADDRESSINDEX_P2PKH && hashBytes == pubkey.GetID());
+    BOOST_CHECK(GetAddressIndexDestination(type, hashBytes) == CTxDestination(pubkey.GetID()));
+
+    const CScriptID scriptID(GetScriptForDestination(pubkey.GetID()));
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForDestination(scriptID), type, hashBytes));
+    BOOST_CHECK(type == ADDRESSINDEX_P2SH && hashBytes == scriptID);
+    BOOST_CHECK(GetAddressIndexDestination(type, hashBytes) == CTxDestination(scriptID));
+
+    BOOST_CHECK(!GetAddressIndexKey(CScript() << OP_RETURN, type, hashBytes));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_connect_disconnect)
+{
+    LOCK(cs_main);
+
+    CAddressIndexDB addressindex(1 << 20, true);
+    CSpentIndexDB spentindex(1 << 20, true);
+    BOOST_CHECK(addressindex.Init());
+    BOOST_CHECK(spentindex.Init());
+
+    CKey keyA, keyB;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    const CKeyID idA = keyA.GetPubKey().GetID();
+    const CScriptID idB(GetScriptForDestination(keyB.GetPubKey().GetID()));
+    const CScript scriptA = GetScriptForDestination(idA);
+    const CScript scriptB = GetScriptForDestination(idB);
+    const COutPoint prevout(InsecureRand256(), 0);
+
+    // coinbase pays A; tx2 spends an older output of A to B and back to A;
+    // tx3 spends tx2's change within the same block
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.emplace_back(50 * COIN, scriptA);
+    CMutableTransaction tx2;
+    tx2.vin.emplace_back(prevout);
+    tx2.vout.emplace_back(7 * COIN, scriptB);
+    tx2.vout.emplace_back(3 * COIN, scriptA);
+    CMutableTransaction tx3;
+    tx3.vin.emplace_back(COutPoint(tx2.GetHash(), 1));
+    tx3.vout.emplace_back(3 * COIN, scriptB);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(tx2));
+    block.vtx.push_back(MakeTransactionRef(tx3));
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(2);
+    blockundo.vtxundo[0].vprevout.emplace_back(CTxOut(10 * COIN, scriptA), 0, false);
+    blockundo.vtxundo[1].vprevout.emplace_back(CTxOut(3 * COIN, scriptA), 1, false);
+
+    const uint256 hash0 = InsecureRand256();
+    const uint256 hash1 = InsecureRand256();
+    CBlockIndex index0;
+    index0.phashBlock = &hash0;
+    CBlockIndex index1;
+    index1.phashBlock = &hash1;
+    index1.pprev = &index0;
+    index1.nHeight = 1;
+
+    // Blocks not on top of the index's best block are ignored
+    BOOST_CHECK(addressindex.ConnectBlock(block, blockundo, &index1));
+    BOOST_CHECK(addressindex.GetBestBlock() == nullptr);
+
+    BOOST_CHECK(addressindex.ConnectBlock(CBlock(), CBlockUndo(), &index0));
+    BOOST_CHECK(spentindex.ConnectBlock(CBlock(), CBlockUndo(), &index0));
+    BOOST_CHECK(addressindex.ConnectBlock(block, blockundo, &index1));
+    BOOST_CHECK(spentindex.ConnectBlock(block, blockundo, &index1));
+    BOOST_CHECK(addressindex.GetBestBlock() == &index1);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(ADDRESSINDEX_P2PKH, idA, vUnspent));
+    BOOST_REQUIRE_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first.txhash == coinbase.GetHash());
+    BOOST_CHECK_EQUAL(vUnspent[0].second.nValue, 50 * COIN);
+    vUnspent.clear();
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(ADDRESSINDEX_P2SH, idB, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 2U);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vHistory;
+    BOOST_CHECK(addressindex.ReadAddressIndex(ADDRESSINDEX_P2PKH, idA, vHistory));
+    BOOST_REQUIRE_EQUAL(vHistory.size(), 4U);
+    CAmount nBalance = 0;
+    for (const auto& entry : vHistory)
+        nBalance += entry.second;
+    BOOST_CHECK_EQUAL(nBalance, 40 * COIN);
+    BOOST_CHECK_EQUAL(vHistory[0].first.nTxIndex, 0U);
+    BOOST_CHECK_EQUAL(vHistory[3].first.nTxIndex, 2U);
+    vHistory.clear();
+    BOOST_CHECK(addressindex.ReadAddressIndex(ADDRESSINDEX_P2PKH, idA, vHistory, 2, 0));
+    BOOST_CHECK(vHistory.empty());
+
+    CSpentIndexValue spent;
+    BOOST_CHECK(spentindex.ReadSpentIndex(CSpentIndexKey(prevout.hash, prevout.n), spent));
+    BOOST_CHECK(spent.txid == tx2.GetHash() && spent.inputIndex == 0 && spent.nHeight == 1);
+    BOOST_CHECK(spent.addressType == ADDRESSINDEX_P2PKH && spent.addressHash == idA);
+    BOOST_CHECK(spentindex.ReadSpentIndex(CSpentIndexKey(tx2.GetHash(), 1), spent));
+    BOOST_CHECK(spent.txid == tx3.GetHash());
+
+    // Disconnecting restores the spent output and drops everything else
+    BOOST_CHECK(addressindex.DisconnectBlock(block, blockundo, &index1));
+    BOOST_CHECK(spentindex.DisconnectBlock(block, blockundo, &index1));
+    BOOST_CHECK(addressindex.GetBestBlock() == &index0);
+
+    vUnspent.clear();
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(ADDRESSINDEX_P2PKH, idA, vUnspent));
+    BOOST_REQUIRE_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first.txhash == prevout.hash);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.nValue, 10 * COIN);
+    vUnspent.clear();
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(ADDRESSINDEX_P2SH, idB, vUnspent));
+    BOOST_CHECK(vUnspent.empty());
+    vHistory.clear();
+    BOOST_CHECK(addressindex.ReadAddressIndex(ADDRESSINDEX_P2PKH, idA, vHistory));
+    BOOST_CHECK(vHistory.empty());
+    BOOST_CHECK(!spentindex.ReadSpentIndex(CSpentIndexKey(prevout.hash, prevout.n), spent));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
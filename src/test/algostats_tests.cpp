@@ -0,0 +1,84 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algostats.h>
+#include <chain.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <undo.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(algostats_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(algostats_connect_disconnect)
+{
+    LOCK(cs_main);
+
+    CAlgoStatsIndexDB algostats(1 << 20, true);
+    BOOST_CHECK(algostats.Init());
+
+    // sha256d, sha256d, merge-mined scrypt, sha256d, scrypt
+    const uint8_t algos[] = {ALGO_SHA256D, ALGO_SHA256D, ALGO_SCRYPT, ALGO_SHA256D, ALGO_SCRYPT};
+    const bool auxpow[] = {false, false, true, false, false};
+    const int nBlocks = 5;
+    uint256 hashes[nBlocks];
+    CBlockIndex blocks[nBlocks];
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.SetAlgo(algos[i]);
+        header.SetAuxpowVersion(auxpow[i]);
+        hashes[i] = InsecureRand256();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nVersion = header.nVersion;
+        blocks[i].nTime = 1500000000 + 100 * i * i;
+        blocks[i].nBits = 0x1d00ffff - i;
+        BOOST_CHECK(algostats.ConnectBlock(CBlock(), CBlockUndo(), &blocks[i]));
+    }
+
+    std::vector<CAlgoStatsTotals> vTotals;
+    int nHeight;
+    uint256 hashBest;
+    algostats.GetTotals(vTotals, nHeight, hashBest);
+    BOOST_CHECK_EQUAL(nHeight, 4);
+    BOOST_CHECK(hashBest == hashes[4]);
+    // The genesis block is not counted
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SHA256D].nBlocks, 2U);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SHA256D].nLastHeight, 3);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nBlocks, 2U);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nAuxpowBlocks, 1U);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nLastHeight, 4);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nLastBits, blocks[4].nBits);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_X11].nBlocks, 0U);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_X11].nLastHeight, -1);
+
+    std::vector<std::pair<int, CAlgoStatsEntry> > vEntries;
+    BOOST_CHECK(algostats.ReadRange(2, 3, vEntries));
+    BOOST_REQUIRE_EQUAL(vEntries.size(), 2U);
+    BOOST_CHECK_EQUAL(vEntries[0].first, 2);
+    BOOST_CHECK(vEntries[0].second.nAlgo == ALGO_SCRYPT && vEntries[0].second.fAuxpow);
+    BOOST_CHECK_EQUAL(vEntries[0].second.nPrevAlgoHeight, -1);
+    BOOST_CHECK_EQUAL(vEntries[0].second.nTimeDelta, 0);
+    BOOST_CHECK_EQUAL(vEntries[1].second.nPrevAlgoHeight, 1);
+    BOOST_CHECK_EQUAL(vEntries[1].second.nTimeDelta, (int64_t)blocks[3].nTime - blocks[1].nTime);
+
+    // Disconnecting the tip restores the previous scrypt block as the last one
+    BOOST_CHECK(algostats.DisconnectBlock(CBlock(), CBlockUndo(), &blocks[4]));
+    algostats.GetTotals(vTotals, nHeight, hashBest);
+    BOOST_CHECK_EQUAL(nHeight, 3);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nBlocks, 1U);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nAuxpowBlocks, 1U);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nLastHeight, 2);
+    BOOST_CHECK_EQUAL(vTotals[ALGO_SCRYPT].nLastTime, blocks[2].nTime);
+    vEntries.clear();
+    BOOST_CHECK(algostats.ReadRange(0, 10, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
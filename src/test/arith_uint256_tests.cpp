@@ -366,6 +366,11 @@ BOOST_AUTO_TEST_CASE( divide )
     BOOST_CHECK(R2L / MaxL == ZeroL);
     BOOST_CHECK(MaxL / R2L == 1);
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
+    // Single limb divisors
+    BOOST_CHECK((R1L / 104).ToString() == "0133fad37d7a5210d1b63d62f57068a055b82cd220e78f2a42a2a0d5b0e0b6f2");
+    BOOST_CHECK((R2L / 100).ToString() == "0227b2aac4f6e697c6422e87efb678ccff5b6d1625ca584d2eb9657e27a421c8");
+    BOOST_CHECK((MaxL / 0xffffffff).ToString() == "0000000100000001000000010000000100000001000000010000000100000001");
+    BOOST_CHECK(arith_uint256(0xffffffff) / arith_uint256(0x10000) == 0xffff);
 }
 
 
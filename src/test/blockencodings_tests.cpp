@@ -139,6 +139,10 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        if (s.GetVersion() >= COMPACT_HEADER_VERSION) {
+            uint8_t header_flags = 0;
+            READWRITE(header_flags);
+        }
         READWRITE(header);
         READWRITE(nonce);
         size_t shorttxids_size = shorttxids.size();
@@ -317,6 +321,73 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(OmittedHeaderDataRoundTripTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+    pool.addUnchecked(block.vtx[1]->GetHash(), entry.FromTx(*block.vtx[1]));
+    pool.addUnchecked(block.vtx[2]->GetHash(), entry.FromTx(*block.vtx[2]));
+
+    // Turn the test block into a merge-mined Equihash block
+    block.nVersion = 0;
+    block.SetAlgo(ALGO_EQUIHASH);
+    block.nSolution.assign(1344, 0x5a);
+    CAuxPow::initAuxPow(block, AUXPOW_EQUIHASH_FLAG);
+    BOOST_CHECK(block.IsAuxpow());
+    boost::shared_ptr<CAuxPow> auxpow = block.auxpow;
+    const std::vector<unsigned char> solution = block.nSolution;
+
+    CBlockHeaderAndShortTxIDs full(block, true);
+    CBlockHeaderAndShortTxIDs compact(full);
+    compact.OmitKnownHeaderData();
+    BOOST_CHECK(compact.IsSolutionOmitted());
+    BOOST_CHECK(compact.IsAuxpowOmitted());
+
+    CDataStream fullStream(SER_NETWORK, PROTOCOL_VERSION);
+    fullStream << full;
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << compact;
+    // The block hash replaces the solution (down to an empty vector) and the auxpow
+    const size_t nSavedBytes = GetSerializeSize(solution, SER_NETWORK, PROTOCOL_VERSION) - 1 + GetSerializeSize(*auxpow, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(stream.size(), fullStream.size() + 32 - nSavedBytes);
+
+    // Peers without the new encoding always get the full header
+    CDataStream oldStream(SER_NETWORK, COMPACT_HEADER_VERSION - 1);
+    BOOST_CHECK_THROW(oldStream << compact, std::ios_base::failure);
+
+    CBlockHeaderAndShortTxIDs received;
+    stream >> received;
+    BOOST_CHECK(!received.IsHeaderComplete());
+    BOOST_CHECK_EQUAL(received.GetOmittedHeaderHash().ToString(), block.GetHash().ToString());
+    {
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(received, extra_txn) == READ_STATUS_FAILED);
+    }
+
+    // Restoring needs both the solution and the auxpow, and must match the hash
+    CBlockHeaderAndShortTxIDs missingAuxpow(received);
+    BOOST_CHECK(missingAuxpow.FillOmittedHeaderData(&solution, boost::shared_ptr<CAuxPow>()) == READ_STATUS_FAILED);
+    std::vector<unsigned char> wrongSolution(solution);
+    wrongSolution[0] ^= 1;
+    CBlockHeaderAndShortTxIDs badSolution(received);
+    BOOST_CHECK(badSolution.FillOmittedHeaderData(&wrongSolution, auxpow) == READ_STATUS_FAILED);
+
+    BOOST_CHECK(received.FillOmittedHeaderData(&solution, auxpow) == READ_STATUS_OK);
+    BOOST_CHECK(received.IsHeaderComplete());
+    BOOST_CHECK_EQUAL(received.header.GetHash().ToString(), block.GetHash().ToString());
+    BOOST_CHECK(received.header.auxpow == auxpow);
+
+    // Short IDs derived from the restored header match the sender's
+    BOOST_CHECK_EQUAL(received.GetShortID(block.vtx[1]->GetWitnessHash()), full.GetShortID(block.vtx[1]->GetWitnessHash()));
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(received, extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -855,4 +855,162 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+
+BOOST_AUTO_TEST_CASE(ccoins_flush_background)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 101; i++) {
+        outpoints.emplace_back(InsecureRand256(), i);
+    }
+    auto makeCoin = [](int i) {
+        Coin coin;
+        coin.out.nValue = 1000 + i;
+        coin.out.scriptPubKey.assign(40, (unsigned char)i);
+        coin.nHeight = i;
+        return coin;
+    };
+    for (int i = 0; i < 100; i++) {
+        cache.AddCoin(outpoints[i], makeCoin(i), false);
+    }
+    const uint256 hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+
+    // The cache can be used while the write runs; the base is not touched
+    // here since the test view is not thread safe.
+    BOOST_CHECK(cache.FlushInBackground());
+    BOOST_CHECK(cache.IsFlushing());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 100U);
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    BOOST_CHECK(!cache.HaveCoin(outpoints[0]));
+    cache.AddCoin(outpoints[100], makeCoin(100), false);
+    BOOST_CHECK(cache.FinishFlush(true));
+    BOOST_CHECK(!cache.IsFlushing());
+    cache.SelfTest();
+
+    // The base got the coins as of the flush, the later changes stay dirty
+    Coin coin;
+    BOOST_CHECK(base.GetBestBlock() == hashBlock);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(base.GetCoin(outpoints[i], coin));
+        BOOST_CHECK(coin == makeCoin(i));
+    }
+    BOOST_CHECK(!base.GetCoin(outpoints[100], coin));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 101U);
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[1]).flags, 0);
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[0]).flags, CCoinsCacheEntry::DIRTY);
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[100]).flags, CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH);
+
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!base.GetCoin(outpoints[0], coin) || coin.IsSpent());
+    BOOST_CHECK(base.GetCoin(outpoints[100], coin));
+    BOOST_CHECK(coin == makeCoin(100));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_flush_modified)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::vector<COutPoint> outpoints;
+    auto makeCoin = [](int i) {
+        Coin coin;
+        coin.out.nValue = 1000 + i;
+        coin.out.scriptPubKey.assign(40, (unsigned char)i);
+        coin.nHeight = i;
+        return coin;
+    };
+    for (int i = 0; i < 110; i++) {
+        outpoints.emplace_back(InsecureRand256(), i);
+    }
+    for (int i = 0; i < 100; i++) {
+        cache.AddCoin(outpoints[i], makeCoin(i), false);
+    }
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.EstimateFlushCopyUsage(), 0U);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(cache.HaveCoin(outpoints[i]));
+    }
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+        cache.AddCoin(outpoints[100 + i], makeCoin(100 + i), false);
+    }
+    const uint256 hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+
+    // The estimate covers what a background flush copies, up to the buckets
+    const size_t nEstimate = cache.EstimateFlushCopyUsage();
+    const size_t nUsage = cache.DynamicMemoryUsage();
+    BOOST_CHECK(cache.FlushInBackground());
+    const size_t nCopyUsage = cache.DynamicMemoryUsage() - nUsage;
+    BOOST_CHECK(nEstimate > 0);
+    BOOST_CHECK(nEstimate <= nCopyUsage && nCopyUsage < 2 * nEstimate);
+    BOOST_CHECK(cache.FinishFlush(true));
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= nUsage);
+
+    // Writing in place drops the modified entries only
+    for (int i = 10; i < 20; i++) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    BOOST_CHECK(cache.FlushModified());
+    BOOST_CHECK(!cache.IsFlushing());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.EstimateFlushCopyUsage(), 0U);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 90U);
+    for (const auto& entry : cache.map()) {
+        BOOST_CHECK_EQUAL(entry.second.flags, 0);
+    }
+    Coin coin;
+    BOOST_CHECK(base.GetBestBlock() == hashBlock);
+    for (int i = 0; i < 110; i++) {
+        BOOST_CHECK_EQUAL(base.GetCoin(outpoints[i], coin) && !coin.IsSpent(), i >= 20);
+        BOOST_CHECK_EQUAL(cache.HaveCoin(outpoints[i]), i >= 20);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_evict)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 100; i++) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        Coin coin;
+        coin.out.nValue = 1000 + i;
+        coin.out.scriptPubKey.assign(40, (unsigned char)i);
+        cache.AddCoin(outpoints[i], std::move(coin), false);
+    }
+    BOOST_CHECK(cache.Flush());
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(cache.HaveCoin(outpoints[i]));
+    }
+    BOOST_CHECK(cache.SpendCoin(outpoints[99]));
+
+    // Cold entries go first
+    for (int i = 10; i < 20; i++) {
+        cache.map().at(outpoints[i]).accessed = false;
+    }
+    cache.Evict(cache.DynamicMemoryUsage() - 1, COutPointSet());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 99U);
+    int nEvicted = 0;
+    for (int i = 0; i < 100; i++) {
+        if (!cache.map().count(outpoints[i])) {
+            BOOST_CHECK(i >= 10 && i < 20);
+            nEvicted++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nEvicted, 1);
+
+    // Modified and pinned entries are never evicted
+    COutPointSet setPinned;
+    setPinned.insert(outpoints[0]);
+    cache.Evict(0, setPinned);
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 2U);
+    BOOST_CHECK(cache.map().count(outpoints[0]));
+    BOOST_CHECK(cache.map().count(outpoints[99]));
+    BOOST_CHECK(cache.HaveCoin(outpoints[50]));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
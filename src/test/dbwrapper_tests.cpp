@@ -317,4 +317,40 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_dbopts)
+{
+    std::string strError;
+    const char* argv[] = {"ignored", "-dbopts=index:blocksize=65536,bloombits=0", "-dbopts=index:filesize=4194304", "-dbopts=spent:writebuffer=1048576"};
+    gArgs.ParseParameters(4, argv);
+    BOOST_CHECK(CheckDBOptions(strError));
+
+    CDBOptions dbopts = GetDBOptions("index");
+    BOOST_CHECK_EQUAL(dbopts.nBlockSize, 65536U);
+    BOOST_CHECK_EQUAL(dbopts.nBloomBits, 0);
+    BOOST_CHECK_EQUAL(dbopts.nMaxFileSize, 4194304U);
+    BOOST_CHECK_EQUAL(dbopts.nWriteBufferSize, 0U);
+    dbopts = GetDBOptions("spent");
+    BOOST_CHECK_EQUAL(dbopts.nBlockSize, CDBOptions().nBlockSize);
+    BOOST_CHECK_EQUAL(dbopts.nWriteBufferSize, 1048576U);
+
+    // Databases opened with and without a bloom filter read back what they wrote
+    for (const CDBOptions& profile : {GetDBOptions("index"), GetDBOptions("chainstate")}) {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, profile);
+        for (int i = 0; i < 1000; i++)
+            BOOST_CHECK(dbw.Write(std::make_pair('b', i), std::vector<unsigned char>(i, (unsigned char)i)));
+        std::vector<unsigned char> value;
+        BOOST_CHECK(dbw.Read(std::make_pair('b', 999), value));
+        BOOST_CHECK(value == std::vector<unsigned char>(999, (unsigned char)999));
+        BOOST_CHECK(!dbw.Read(std::make_pair('b', 1000), value));
+    }
+
+    for (const char* arg : {"-dbopts=undo:blocksize=65536", "-dbopts=index", "-dbopts=index:blocksize=10", "-dbopts=index:cache=1", "-dbopts=index:bloombits=-1"}) {
+        const char* argvBad[] = {"ignored", arg};
+        gArgs.ParseParameters(2, argvBad);
+        BOOST_CHECK(!CheckDBOptions(strError));
+    }
+    gArgs.ParseParameters(1, argv);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <core_io.h>
+#include <jsonwriter.h>
+#include <key.h>
+#include <primitives/transaction.h>
+#include <rpc/blockchain.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <validation.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonwriter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(jsonwriter_matches_univalue)
+{
+    // A tiny flush size makes every value cross a chunk boundary
+    std::string strOut;
+    size_t nChunks = 0;
+    CJSONStreamWriter writer([&](const char* data, size_t size) { strOut.append(data, size); nChunks++; }, 4);
+
+    const std::string strOdd = std::string("quote\" back\\slash \b\f\n\r\t ") + '\x01' + '\x7f' + " \xc3\xa9";
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("str", strOdd);
+    expected.pushKV("neg", (int64_t)-42);
+    expected.pushKV("big", (uint64_t)18446744073709551615ULL);
+    expected.pushKV("t", true);
+    expected.pushKV("dbl", 1234.5678);
+    UniValue arr(UniValue::VARR);
+    arr.push_back(UniValue(UniValue::VOBJ));
+    arr.push_back(UniValue(UniValue::VARR));
+    arr.push_back("x");
+    expected.pushKV("arr", arr);
+
+    writer.BeginObject();
+    writer.KV("str", strOdd);
+    writer.KV("neg", (int64_t)-42);
+    writer.KV("big", (uint64_t)18446744073709551615ULL);
+    writer.KV("t", true);
+    writer.KV("dbl", UniValue(1234.5678));
+    writer.Key("arr");
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.EndObject();
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Value("x");
+    writer.EndArray();
+    writer.EndObject();
+    writer.Flush();
+
+    BOOST_CHECK_EQUAL(strOut, expected.write());
+    BOOST_CHECK(nChunks > 1);
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_tx)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CMutableTransaction mtx;
+    mtx.vin.resize(2);
+    mtx.vin[0].prevout = COutPoint(InsecureRand256(), 3);
+    mtx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(71, 0x30) << ToByteVector(key.GetPubKey());
+    mtx.vin[1].prevout = COutPoint(InsecureRand256(), 0);
+    mtx.vin[1].scriptWitness.stack.push_back(std::vector<unsigned char>(72, 0x01));
+    mtx.vin[1].scriptWitness.stack.push_back(ToByteVector(key.GetPubKey()));
+    mtx.vout.emplace_back(123456789, GetScriptForDestination(key.GetPubKey().GetID()));
+    mtx.vout.emplace_back(0, CScript() << OP_RETURN << std::vector<unsigned char>(10, 0xaa));
+    mtx.vout.emplace_back(1, GetScriptForMultisig(1, {key.GetPubKey(), key.GetPubKey()}));
+    const CTransaction tx(mtx);
+    const uint256 hashBlock = InsecureRand256();
+
+    for (const bool fIncludeHex : {true, false}) {
+        UniValue expected(UniValue::VOBJ);
+        TxToUniv(tx, hashBlock, expected, fIncludeHex);
+
+        std::string strOut;
+        CJSONStreamWriter writer([&strOut](const char* data, size_t size) { strOut.append(data, size); });
+        TxToJSONWriter(writer, tx, hashBlock, fIncludeHex);
+        writer.Flush();
+        BOOST_CHECK_EQUAL(strOut, expected.write());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(jsonwriter_block, TestChain100Setup)
+{
+    LOCK(cs_main);
+    // A block in the middle of the chain has a next block, as well as the tip
+    for (const CBlockIndex* pindex : {chainActive[chainActive.Height() / 2], chainActive.Tip()}) {
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        for (const bool fTxDetails : {false, true}) {
+            std::string strOut;
+            CJSONStreamWriter writer([&strOut](const char* data, size_t size) { strOut.append(data, size); });
+            blockToJSON(writer, block, pindex, fTxDetails);
+            writer.Flush();
+            BOOST_CHECK_EQUAL(strOut, blockToJSON(block, pindex, fTxDetails).write());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+// Copyright (c) 2018 The GlobalToken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <key.h>
+#include <masternode-payments.h>
+#include <script/standard.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternode_payments_tests, BasicTestingSetup)
+
+static CScript RandomPayee()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return GetScriptForDestination(key.GetPubKey().GetID());
+}
+
+BOOST_AUTO_TEST_CASE(coinbase_payees)
+{
+    const int nHeight = 100000;
+    const CScript scriptVoted = RandomPayee();
+    const CScript scriptOther = RandomPayee();
+
+    CMasternodeBlockPayees blockPayees(nHeight);
+    for (int i = 0; i < MNPAYMENTS_SIGNATURES_REQUIRED; i++)
+        blockPayees.AddPayee(CMasternodePaymentVote(COutPoint(InsecureRand256(), 0), nHeight, scriptVoted));
+    blockPayees.AddPayee(CMasternodePaymentVote(COutPoint(InsecureRand256(), 0), nHeight, scriptOther));
+
+    CCoinbasePayees payees(nHeight);
+    blockPayees.FillCoinbasePayees(payees);
+    BOOST_CHECK(payees.fMasternodeRequired);
+    BOOST_CHECK(payees.scriptBestPayee == scriptVoted);
+    BOOST_CHECK(payees.GetTreasuryScript(false) == Params().GetFoundersRewardScriptAtHeight(nHeight, false));
+
+    const CAmount nReward = 50 * COIN;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.emplace_back(nReward, RandomPayee());
+    coinbase.vout.emplace_back(Params().GetTreasuryAmount(nReward), payees.GetTreasuryScript(false));
+    coinbase.vout[0].nValue -= coinbase.vout[1].nValue;
+
+    bool fTreasuryPaid, fMasternodePaid;
+    payees.CheckCoinbase(CTransaction(coinbase), Params().GetTreasuryAmount(nReward), false, fTreasuryPaid, fMasternodePaid);
+    BOOST_CHECK(fTreasuryPaid && !fMasternodePaid);
+
+    // Paying a payee without enough votes does not count
+    const CAmount nMasternodePayment = GetMasternodePayment(nHeight, nReward);
+    coinbase.vout[0].nValue -= nMasternodePayment;
+    coinbase.vout.emplace_back(nMasternodePayment, scriptOther);
+    payees.CheckCoinbase(CTransaction(coinbase), Params().GetTreasuryAmount(nReward), false, fTreasuryPaid, fMasternodePaid);
+    BOOST_CHECK(fTreasuryPaid && !fMasternodePaid);
+
+    coinbase.vout.back().scriptPubKey = scriptVoted;
+    payees.CheckCoinbase(CTransaction(coinbase), Params().GetTreasuryAmount(nReward), false, fTreasuryPaid, fMasternodePaid);
+    BOOST_CHECK(fTreasuryPaid && fMasternodePaid);
+
+    // A wrong treasury amount is rejected
+    payees.CheckCoinbase(CTransaction(coinbase), Params().GetTreasuryAmount(nReward) + 1, false, fTreasuryPaid, fMasternodePaid);
+    BOOST_CHECK(!fTreasuryPaid && fMasternodePaid);
+}
+
+BOOST_AUTO_TEST_CASE(coinbase_payees_no_votes)
+{
+    CCoinbasePayees payees(1000);
+    CMasternodeBlockPayees(1000).FillCoinbasePayees(payees);
+    BOOST_CHECK(!payees.fMasternodeRequired);
+    BOOST_CHECK(payees.scriptBestPayee.empty());
+    BOOST_CHECK(payees.GetMasternodePayeesString().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
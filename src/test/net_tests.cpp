@@ -9,6 +9,7 @@
 #include <serialize.h>
 #include <streams.h>
 #include <net.h>
+#include <netmessagemaker.h>
 #include <netbase.h>
 #include <chainparams.h>
 #include <util.h>
@@ -185,4 +186,103 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    CRecvBufferPool pool(150000);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+
+    // Small buffers are not pooled
+    ss.reserve(100);
+    pool.Release(ss);
+    BOOST_CHECK_EQUAL(ss.capacity(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetPooledBuffers(), 0U);
+
+    // Pooling stops at the byte limit
+    ss.reserve(100000);
+    pool.Release(ss);
+    BOOST_CHECK_EQUAL(pool.GetPooledBuffers(), 1U);
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), 100000U);
+    ss.reserve(100000);
+    pool.Release(ss);
+    BOOST_CHECK_EQUAL(pool.GetPooledBuffers(), 1U);
+
+    // Only buffers that fit the message are handed out
+    BOOST_CHECK(!pool.Acquire(ss, 10000));
+    BOOST_CHECK(!pool.Acquire(ss, 200000));
+    BOOST_CHECK(pool.Acquire(ss, 70000));
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(ss.capacity() >= 70000U);
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), 0U);
+    BOOST_CHECK(!pool.Acquire(ss, 70000));
+}
+
+BOOST_AUTO_TEST_CASE(netmessage_pooled_buffers)
+{
+    std::vector<unsigned char> payload(300000);
+    for (size_t i = 0; i < payload.size(); i++)
+        payload[i] = i % 251;
+    CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+    ssMsg << CMessageHeader(Params().MessageStart(), "block", payload.size());
+    ssMsg.insert(ssMsg.end(), (const char*)payload.data(), (const char*)payload.data() + payload.size());
+
+    for (int nRound = 0; nRound < 2; nRound++) {
+        size_t nPooledBefore = GetRecvBufferPool().GetPooledBuffers();
+        {
+            CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+
+            // Feed the message in socket-sized pieces
+            for (size_t nPos = 0; nPos < ssMsg.size(); ) {
+                size_t nBytes = std::min<size_t>(0x10000, ssMsg.size() - nPos);
+                int nHandled = msg.in_data ? msg.readData(&ssMsg[nPos], nBytes) : msg.readHeader(&ssMsg[nPos], nBytes);
+                BOOST_REQUIRE(nHandled > 0);
+                nPos += nHandled;
+            }
+            BOOST_CHECK(msg.complete());
+            BOOST_CHECK_EQUAL(msg.vRecv.size(), payload.size());
+            BOOST_CHECK(std::equal(payload.begin(), payload.end(), (const unsigned char*)msg.vRecv.data()));
+            BOOST_CHECK(msg.GetMessageHash() == Hash(payload.begin(), payload.end()));
+
+            // The second message reuses the buffer of the first one
+            if (nRound == 1)
+                BOOST_CHECK_EQUAL(GetRecvBufferPool().GetPooledBuffers(), nPooledBefore - 1);
+        }
+        if (nRound == 1)
+            BOOST_CHECK_EQUAL(GetRecvBufferPool().GetPooledBuffers(), nPooledBefore);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shared_netmsg)
+{
+    // A shared message carries the same framing PushMessage would add
+    CSharedNetMsgRef msg = CNetMsgMaker(PROTOCOL_VERSION).MakeShared(0, NetMsgType::PING, uint64_t(42));
+    BOOST_CHECK_EQUAL(msg->command, NetMsgType::PING);
+    BOOST_CHECK_EQUAL(msg->data.size(), CMessageHeader::HEADER_SIZE + 8);
+
+    CDataStream ss(msg->data, SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader hdr(Params().MessageStart());
+    ss >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::PING);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, 8U);
+    uint256 hash = Hash(ss.begin(), ss.end());
+    BOOST_CHECK(memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+    uint64_t nonce;
+    ss >> nonce;
+    BOOST_CHECK_EQUAL(nonce, 42U);
+
+    // Every peer it is pushed to queues the same buffer
+    CConnman connman(0x1337, 0x1337);
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    CNode node1(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+    CNode node2(1, NODE_NETWORK, 0, INVALID_SOCKET, addr, 1, 1, CAddress(), "", true);
+    connman.PushMessage(&node1, msg);
+    connman.PushMessage(&node2, msg);
+    BOOST_CHECK_EQUAL(msg.use_count(), 3);
+    BOOST_CHECK_EQUAL(node1.vSendMsg.size(), 1U);
+    BOOST_CHECK(node1.vSendMsg.front().begin() == node2.vSendMsg.front().begin());
+    BOOST_CHECK_EQUAL(node2.nSendSize, msg->data.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
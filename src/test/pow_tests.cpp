@@ -4,8 +4,11 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <globaltoken/multihasher.h>
+#include <miner.h>
 #include <pow.h>
 #include <random.h>
+#include <streams.h>
 #include <util.h>
 #include <test/test_bitcoin.h>
 
@@ -83,4 +86,67 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(header_nonce_hasher)
+{
+    const int nHashVersion = LoadMultiHasherVersionFlags(true);
+    CDefaultBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = 1577365200 + InsecureRandRange(1000000);
+    header.nBits = 0x1d00ffff;
+    header.nNonce = InsecureRand32();
+    std::vector<unsigned char> vHeader;
+    CVectorWriter(SER_GETHASH, nHashVersion, vHeader, 0, header);
+
+    for (const uint8_t nAlgo : {ALGO_SHA256D, ALGO_X11, ALGO_GROESTL, ALGO_TIMETRAVEL10, ALGO_KECCAKC}) {
+        CHeaderNonceHasher hasher(vHeader.data(), nAlgo, nHashVersion);
+        for (int i = 0; i < 4; i++) {
+            header.nNonce = InsecureRand32();
+            BOOST_CHECK(hasher.GetHash(header.nNonce) == header.GetPoWHash(nAlgo, SER_GETHASH, nHashVersion));
+        }
+    }
+    // The sha256d proof of work hash is the block hash
+    BOOST_CHECK(header.GetPoWHash(ALGO_SHA256D, SER_GETHASH, nHashVersion) == header.GetHash());
+}
+
+static CBlock SearchTemplate(const Consensus::Params& params, uint8_t nAlgo, uint32_t nBits)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.SetAlgo(nAlgo);
+    block.hashPrevBlock = InsecureRand256();
+    block.hashMerkleRoot = InsecureRand256();
+    block.nTime = params.Hardfork3.GetActivationTime() + 1;
+    block.nBits = nBits;
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(search_proof_of_work)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    const int nHashVersion = LoadMultiHasherVersionFlags(true);
+
+    for (const uint8_t nAlgo : {ALGO_SHA256D, ALGO_X11}) {
+        for (const int nThreads : {1, 4}) {
+            CBlock block = SearchTemplate(params, nAlgo, 0x207fffff);
+            uint64_t nMaxTries = 1000;
+            BOOST_CHECK(SearchProofOfWork(block, nullptr, *chainParams, nThreads, 0x10000, nMaxTries) == PoWSearchResult::FOUND);
+            BOOST_CHECK(nMaxTries < 1000);
+            BOOST_CHECK(CheckProofOfWork(block.GetDefaultBlockHeader().GetPoWHash(nAlgo, SER_GETHASH, nHashVersion), block.nBits, params, nAlgo));
+        }
+    }
+
+    // Each nonce of the range is tried exactly once, spread over the threads
+    CBlock block = SearchTemplate(params, ALGO_SHA256D, 0x1d00ffff);
+    uint64_t nMaxTries = 1000;
+    BOOST_CHECK(SearchProofOfWork(block, nullptr, *chainParams, 3, 100, nMaxTries) == PoWSearchResult::EXHAUSTED);
+    BOOST_CHECK_EQUAL(nMaxTries, 900U);
+
+    // The budget is shared between the threads
+    BOOST_CHECK(SearchProofOfWork(block, nullptr, *chainParams, 3, 0x10000, nMaxTries) == PoWSearchResult::MAX_TRIES);
+    BOOST_CHECK_EQUAL(nMaxTries, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <base58.h>
 #include <core_io.h>
 #include <netbase.h>
+#include <validation.h>
 
 #include <test/test_bitcoin.h>
 
@@ -314,6 +315,42 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_parallel)
+{
+    SetRPCWarmupFinished();
+
+    // Two runs of read-only calls, split by a call that is not marked read-only
+    const std::vector<std::string> vMethods = {"getblockcount", "getbestblockhash", "ping", "getdifficulty", "uptime"};
+    UniValue vReq(UniValue::VARR);
+    for (size_t i = 0; i < vMethods.size(); i++) {
+        UniValue req(UniValue::VOBJ);
+        req.pushKV("method", vMethods[i]);
+        req.pushKV("params", UniValue(UniValue::VARR));
+        req.pushKV("id", (int)i);
+        vReq.push_back(req);
+    }
+
+    std::vector<size_t> vRuns;
+    RPCParallelFor parallelFor = [&vRuns](size_t nCount, const std::function<void(size_t)>& func) {
+        vRuns.push_back(nCount);
+        // Backwards, the replies must still come out in request order
+        for (size_t i = nCount; i-- > 0;)
+            func(i);
+    };
+
+    UniValue reply;
+    BOOST_CHECK(reply.read(JSONRPCExecBatch(JSONRPCRequest(), vReq, parallelFor)));
+    BOOST_REQUIRE_EQUAL(reply.size(), vMethods.size());
+    for (size_t i = 0; i < vMethods.size(); i++) {
+        BOOST_CHECK_EQUAL(find_value(reply[i], "id").get_int(), (int)i);
+        BOOST_CHECK(find_value(reply[i], "error").isNull());
+    }
+    BOOST_CHECK_EQUAL(find_value(reply[0], "result").get_int(), chainActive.Height());
+    BOOST_REQUIRE_EQUAL(vRuns.size(), 2U);
+    BOOST_CHECK_EQUAL(vRuns[0], 2U);
+    BOOST_CHECK_EQUAL(vRuns[1], 2U);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
 {
     UniValue result;
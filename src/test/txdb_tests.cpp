@@ -0,0 +1,129 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <clientversion.h>
+#include <random.h>
+#include <streams.h>
+#include <txdb.h>
+#include <util.h>
+#include <test/test_bitcoin.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, TestingSetup)
+
+/** An equihash block index entry with a random solution */
+static CBlockIndex* NewEquihashIndex(std::vector<std::unique_ptr<CBlockIndex> >& vIndex, std::vector<std::unique_ptr<uint256> >& vHash)
+{
+    CBlockHeader header;
+    header.SetAlgo(ALGO_EQUIHASH);
+    header.nTime = InsecureRand32();
+    header.nSolution.resize(1344);
+    for (unsigned char& c : header.nSolution)
+        c = InsecureRandBits(8);
+    vIndex.emplace_back(new CBlockIndex(header));
+    vHash.emplace_back(new uint256(header.GetHash()));
+    vIndex.back()->phashBlock = vHash.back().get();
+    vIndex.back()->nStatus = BLOCK_VALID_TREE;
+    return vIndex.back().get();
+}
+
+BOOST_AUTO_TEST_CASE(blocktree_solution_written_once)
+{
+    const fs::path pathJournal = GetDataDir() / "blocks" / "index.journal";
+    std::vector<std::unique_ptr<CBlockIndex> > vIndex;
+    std::vector<std::unique_ptr<uint256> > vHash;
+    CBlockIndex* pindex = NewEquihashIndex(vIndex, vHash);
+    const std::vector<unsigned char> vSolution = pindex->nSolution;
+    {
+        CBlockTreeDB db(1 << 20, false, true);
+        BOOST_CHECK(db.WriteBatchSync({}, 0, {pindex}));
+        BOOST_CHECK(pindex->nStatus & BLOCK_SEPARATE_SOLUTION);
+        const uint64_t nSizeFirst = fs::file_size(pathJournal);
+        BOOST_CHECK(nSizeFirst > vSolution.size());
+
+        // A status change does not write the solution again
+        pindex->nStatus |= BLOCK_HAVE_DATA;
+        BOOST_CHECK(db.WriteBatchSync({}, 0, {pindex}));
+        BOOST_CHECK(fs::file_size(pathJournal) - nSizeFirst < vSolution.size());
+    }
+    // A clean close leaves no journal behind
+    BOOST_CHECK(!fs::exists(pathJournal));
+
+    CBlockTreeDB db(1 << 20, false, false);
+    CDiskBlockIndex diskindex;
+    BOOST_CHECK(db.Read(std::make_pair('b', pindex->GetBlockHash()), diskindex));
+    BOOST_CHECK_EQUAL(diskindex.nStatus, BLOCK_VALID_TREE | BLOCK_HAVE_DATA | BLOCK_SEPARATE_SOLUTION);
+    BOOST_CHECK(diskindex.nSolution.empty());
+    std::vector<unsigned char> vSolutionRead;
+    BOOST_CHECK(db.Read(std::make_pair('e', pindex->GetBlockHash()), vSolutionRead));
+    BOOST_CHECK(vSolutionRead == vSolution);
+    diskindex.nSolution = vSolutionRead;
+    BOOST_CHECK(diskindex.GetBlockHash() == pindex->GetBlockHash());
+}
+
+BOOST_AUTO_TEST_CASE(blocktree_journal_replay)
+{
+    const fs::path pathJournal = GetDataDir() / "blocks" / "index.journal";
+    const fs::path pathSaved = GetDataDir() / "index.journal.saved";
+    std::vector<std::unique_ptr<CBlockIndex> > vIndex;
+    std::vector<std::unique_ptr<uint256> > vHash;
+    CBlockIndex* pindex = NewEquihashIndex(vIndex, vHash);
+    {
+        CBlockTreeDB db(1 << 20, false, true);
+        BOOST_CHECK(db.WriteBatchSync({}, 0, {pindex}));
+        fs::copy_file(pathJournal, pathSaved);
+    }
+    {
+        CBlockTreeDB db(1 << 20, false, true);
+        BOOST_CHECK(!db.Exists(std::make_pair('b', pindex->GetBlockHash())));
+    }
+
+    // The journal of a node that crashed, with an entry it did not finish
+    fs::rename(pathSaved, pathJournal);
+    {
+        CAutoFile file(fsbridge::fopen(pathJournal, "ab"), SER_DISK, CLIENT_VERSION);
+        file << (uint32_t)1000 << 'x';
+    }
+    CBlockTreeDB db(1 << 20, false, false);
+    BOOST_CHECK(!fs::exists(pathJournal));
+    BOOST_CHECK(db.Exists(std::make_pair('b', pindex->GetBlockHash())));
+    BOOST_CHECK(db.Exists(std::make_pair('e', pindex->GetBlockHash())));
+}
+
+BOOST_AUTO_TEST_CASE(blocktree_journal_compaction)
+{
+    const fs::path pathJournal = GetDataDir() / "blocks" / "index.journal";
+    std::vector<std::unique_ptr<CBlockIndex> > vIndex;
+    std::vector<std::unique_ptr<uint256> > vHash;
+    CBlockTreeDB db(1 << 20, false, true);
+    // Enough solutions to pass the compaction size a few times
+    const int nBatches = 3 * BLOCK_INDEX_JOURNAL_COMPACT_SIZE / (500 * 1344) + 1;
+    for (int i = 0; i < nBatches; i++) {
+        std::vector<CBlockIndex*> vBlocks;
+        for (int j = 0; j < 500; j++)
+            vBlocks.push_back(NewEquihashIndex(vIndex, vHash));
+        BOOST_CHECK(db.WriteBatchSync({}, 0, vBlocks));
+        // Handed to the background at the compaction size
+        BOOST_CHECK(!fs::exists(pathJournal) || fs::file_size(pathJournal) < BLOCK_INDEX_JOURNAL_COMPACT_SIZE * 2);
+    }
+    BOOST_CHECK(db.FlushJournal());
+    BOOST_CHECK(!fs::exists(pathJournal));
+
+    int nEntries = 0;
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    for (pcursor->Seek(std::make_pair('b', uint256())); pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != 'b')
+            break;
+        nEntries++;
+    }
+    BOOST_CHECK_EQUAL(nEntries, nBatches * 500);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,206 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <coinstats.h>
+#include <random.h>
+#include <streams.h>
+#include <txdb.h>
+#include <utxosnapshot.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, TestingSetup)
+
+static Coin RandomCoin(int nHeight, bool fCoinBase)
+{
+    Coin coin;
+    coin.out.nValue = InsecureRandRange(100000000);
+    coin.out.scriptPubKey.assign(1 + InsecureRandRange(40), (unsigned char)InsecureRand32());
+    coin.nHeight = nHeight;
+    coin.fCoinBase = fCoinBase;
+    return coin;
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_roundtrip)
+{
+    uint256 hashBlock;
+    {
+        LOCK(cs_main);
+        hashBlock = chainActive.Tip()->GetBlockHash();
+    }
+
+    CCoinsViewDB view(1 << 20, true);
+    std::map<COutPoint, Coin> mapExpected;
+    CCoinsMap mapCoins;
+    for (int i = 0; i < 200; i++) {
+        uint256 txid = InsecureRand256();
+        int nOutputs = 1 + InsecureRandRange(5);
+        bool fCoinBase = InsecureRandBits(1);
+        for (int n = 0; n < nOutputs; n++) {
+            COutPoint outpoint(txid, n * 3);
+            Coin coin = RandomCoin(i, fCoinBase);
+            mapExpected[outpoint] = coin;
+            CCoinsCacheEntry& entry = mapCoins[outpoint];
+            entry.coin = coin;
+            entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+        }
+    }
+    BOOST_CHECK(view.BatchWrite(mapCoins, hashBlock));
+
+    fs::path path = GetDataDir() / "utxo.snapshot";
+    CCoinsStats stats;
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+        BOOST_CHECK(WriteUTXOSnapshot(pcursor.get(), file, stats));
+    }
+    BOOST_CHECK(stats.hashBlock == hashBlock);
+    BOOST_CHECK_EQUAL(stats.nTransactions, 200U);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, mapExpected.size());
+
+    // The snapshot hash is the gettxoutsetinfo hash of the same view, which
+    // is computed by several threads over txid ranges
+    CCoinsStats statsView;
+    BOOST_CHECK(GetUTXOStats(&view, statsView));
+    BOOST_CHECK(stats.hashSerialized == statsView.hashSerialized);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, statsView.nTotalAmount);
+
+    // Reading it back gives the same coins, in outpoint order (all output
+    // indexes are small enough to sort numerically in the database)
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    CSnapshotReader reader(file);
+    BOOST_CHECK(reader.GetMetadata().IsValid());
+    BOOST_CHECK(reader.GetMetadata().hashBlock == hashBlock);
+    std::vector<std::pair<COutPoint, Coin> > vCoins;
+    std::map<COutPoint, Coin>::const_iterator it = mapExpected.begin();
+    while (reader.ReadChunk(vCoins)) {
+        for (const auto& item : vCoins) {
+            BOOST_REQUIRE(it != mapExpected.end());
+            BOOST_CHECK(item.first == it->first);
+            BOOST_CHECK(item.second.out == it->second.out);
+            BOOST_CHECK_EQUAL(item.second.nHeight, it->second.nHeight);
+            BOOST_CHECK_EQUAL(item.second.fCoinBase, it->second.fCoinBase);
+            ++it;
+        }
+    }
+    BOOST_CHECK(it == mapExpected.end());
+}
+
+BOOST_AUTO_TEST_CASE(stats_hasher_order)
+{
+    CCoinsStats stats;
+    CCoinsStatsHasher hasher(stats);
+    uint256 txid = InsecureRand256();
+    BOOST_CHECK(hasher.Add(COutPoint(txid, 1), RandomCoin(1, false)));
+    BOOST_CHECK(!hasher.Add(COutPoint(txid, 1), RandomCoin(1, false)));
+    // Outputs of one transaction may come in any order
+    BOOST_CHECK(hasher.Add(COutPoint(txid, 0), RandomCoin(1, false)));
+    BOOST_CHECK(hasher.Add(COutPoint(txid, 2), RandomCoin(1, false)));
+    uint256 txidNext = txid;
+    *txidNext.begin() ^= 0x80;
+    if (txidNext < txid) {
+        std::swap(txid, txidNext);
+    }
+    BOOST_CHECK(hasher.Add(COutPoint(txidNext, 0), RandomCoin(1, false)));
+    BOOST_CHECK(!hasher.Add(COutPoint(txid, 3), RandomCoin(1, false)));
+    hasher.Finalize();
+    BOOST_CHECK_EQUAL(stats.nTransactions, 2U);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 4U);
+}
+
+BOOST_AUTO_TEST_CASE(stats_many_outputs)
+{
+    uint256 hashBlock;
+    {
+        LOCK(cs_main);
+        hashBlock = chainActive.Tip()->GetBlockHash();
+    }
+
+    // Output indexes from 16512 on are stored in database keys that sort
+    // before those of smaller indexes, as their VARINT is one byte longer
+    const uint32_t nOutputs = 16600;
+    const uint256 txid = InsecureRand256();
+    CCoinsViewDB view(1 << 20, true);
+    std::map<COutPoint, Coin> mapExpected;
+    CCoinsMap mapCoins;
+    for (uint32_t n = 0; n < nOutputs; n++) {
+        Coin coin = RandomCoin(1, false);
+        mapExpected[COutPoint(txid, n)] = coin;
+        CCoinsCacheEntry& entry = mapCoins[COutPoint(txid, n)];
+        entry.coin = coin;
+        entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+    }
+    BOOST_CHECK(view.BatchWrite(mapCoins, hashBlock));
+
+    // Hash of the coins added in numeric order
+    CCoinsStats statsExpected;
+    statsExpected.hashBlock = hashBlock;
+    {
+        CCoinsStatsHasher hasher(statsExpected);
+        for (const auto& item : mapExpected) {
+            BOOST_CHECK(hasher.Add(item.first, item.second));
+        }
+        hasher.Finalize();
+    }
+    BOOST_CHECK_EQUAL(statsExpected.nTransactions, 1U);
+    BOOST_CHECK_EQUAL(statsExpected.nTransactionOutputs, nOutputs);
+
+    CCoinsStats statsView;
+    BOOST_CHECK(GetUTXOStats(&view, statsView));
+    BOOST_CHECK(statsView.hashSerialized == statsExpected.hashSerialized);
+    BOOST_CHECK_EQUAL(statsView.nTransactionOutputs, nOutputs);
+
+    fs::path path = GetDataDir() / "many.snapshot";
+    CCoinsStats stats;
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+        BOOST_CHECK(WriteUTXOSnapshot(pcursor.get(), file, stats));
+    }
+    BOOST_CHECK(stats.hashSerialized == statsExpected.hashSerialized);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, nOutputs);
+
+    // Reading it back hashes the same and gives every coin
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    CSnapshotReader reader(file);
+    CCoinsStats statsRead;
+    statsRead.hashBlock = hashBlock;
+    CCoinsStatsHasher hasher(statsRead);
+    std::vector<std::pair<COutPoint, Coin> > vCoins;
+    size_t nRead = 0;
+    while (reader.ReadChunk(vCoins)) {
+        for (const auto& item : vCoins) {
+            BOOST_CHECK(hasher.Add(item.first, item.second));
+            BOOST_CHECK(mapExpected.count(item.first));
+            nRead++;
+        }
+    }
+    hasher.Finalize();
+    BOOST_CHECK_EQUAL(nRead, nOutputs);
+    BOOST_CHECK(statsRead.hashSerialized == statsExpected.hashSerialized);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_bad_header)
+{
+    fs::path path = GetDataDir() / "bad.snapshot";
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        file << CSnapshotMetadata(uint256()) << (int)0;
+    }
+    {
+        CAutoFile file(fsbridge::fopen(path, "r+b"), SER_DISK, CLIENT_VERSION);
+        file << 'x';
+    }
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK_THROW(CSnapshotReader reader(file), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,7 @@
 #include <pow.h>
 #include <uint256.h>
 #include <util.h>
+#include <utiltime.h>
 #include <ui_interface.h>
 #include <init.h>
 
@@ -24,12 +25,14 @@ static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_SOLUTION = 'e';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SNAPSHOT_BASE = 'S';
 
 std::vector<uint256> vAuxpowValidation;
 
@@ -57,7 +60,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, GetDBOptions("chainstate")) 
 {
 }
 
@@ -150,7 +153,142 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+namespace {
+
+/** The block index changes of one CBlockTreeDB::WriteBatchSync, one journal entry */
+struct CBlockTreeDelta
+{
+    std::vector<std::pair<int, CBlockFileInfo> > vFiles;
+    int nLastFile;
+    std::vector<std::pair<uint256, CDiskBlockIndex> > vBlocks;
+    std::vector<std::pair<uint256, std::vector<unsigned char> > > vSolutions;
+
+    CBlockTreeDelta() : nLastFile(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vFiles);
+        READWRITE(nLastFile);
+        READWRITE(vBlocks);
+        READWRITE(vSolutions);
+    }
+
+    void Write(CDBBatch& batch) const
+    {
+        for (const auto& file : vFiles)
+            batch.Write(std::make_pair(DB_BLOCK_FILES, file.first), file.second);
+        batch.Write(DB_LAST_BLOCK, nLastFile);
+        for (const auto& solution : vSolutions)
+            batch.Write(std::make_pair(DB_BLOCK_SOLUTION, solution.first), solution.second);
+        for (const auto& block : vBlocks)
+            batch.Write(std::make_pair(DB_BLOCK_INDEX, block.first), block.second);
+    }
+};
+
+} // namespace
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, GetDBOptions("index")),
+    fileJournal(nullptr), nJournalSize(0), fCompactDone(false), fCompactOk(true)
+{
+    if (fMemory)
+        return;
+    pathJournal = GetDataDir() / "blocks" / "index.journal";
+    pathJournalOld = GetDataDir() / "blocks" / "index.journal.old";
+    if (fWipe) {
+        fs::remove(pathJournalOld);
+        fs::remove(pathJournal);
+    }
+    // The older journal first, its entries may be overwritten by the other
+    if (!ReplayJournal(pathJournalOld) || !ReplayJournal(pathJournal))
+        throw dbwrapper_error("Failed to write the block index journal into the database");
+}
+
+CBlockTreeDB::~CBlockTreeDB()
+{
+    // Leave nothing to replay behind after a clean shutdown
+    try {
+        if (!FlushJournal())
+            LogPrintf("%s: failed to write the block index journal, it is replayed on the next start\n", __func__);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    if (compactThread.joinable())
+        compactThread.join();
+    if (fileJournal)
+        fclose(fileJournal);
+}
+
+bool CBlockTreeDB::ReplayJournal(const fs::path& path)
+{
+    if (!fs::exists(path))
+        return true;
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: cannot open %s", __func__, path.string());
+
+    const int64_t nStart = GetTimeMicros();
+    int nEntries = 0;
+    CDBBatch batch(*this);
+    while (true) {
+        // An entry is its size, the serialized delta and its hash. One that
+        // is cut short was not synced, nothing refers to it yet.
+        uint32_t nSize;
+        std::vector<char> vData;
+        uint256 hash;
+        try {
+            file >> nSize;
+        } catch (const std::ios_base::failure&) {
+            break;
+        }
+        try {
+            vData.resize(nSize);
+            file.read(vData.data(), nSize);
+            file >> hash;
+        } catch (const std::ios_base::failure&) {
+            LogPrintf("%s: ignoring incomplete entry at the end of %s\n", __func__, path.string());
+            break;
+        }
+        if (hash != Hash(vData.begin(), vData.end())) {
+            LogPrintf("%s: ignoring corrupt entry at the end of %s\n", __func__, path.string());
+            break;
+        }
+        CBlockTreeDelta delta;
+        CDataStream(vData, SER_DISK, CLIENT_VERSION) >> delta;
+        delta.Write(batch);
+        nEntries++;
+        if (batch.SizeEstimate() > (size_t)nDefaultDbBatchSize) {
+            if (!WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+    if (!WriteBatch(batch, true))
+        return false;
+    file.fclose();
+    fs::remove(path);
+    LogPrint(BCLog::BENCH, "%s: %d entries of %s written in %.2fms\n", __func__, nEntries, path.filename().string(), (GetTimeMicros() - nStart) * 0.001);
+    return true;
+}
+
+bool CBlockTreeDB::FinishCompaction(bool fWait)
+{
+    if (compactThread.joinable() && (fWait || fCompactDone))
+        compactThread.join();
+    return fCompactOk;
+}
+
+bool CBlockTreeDB::FlushJournal()
+{
+    if (!FinishCompaction(true))
+        return false;
+    if (fileJournal) {
+        fclose(fileJournal);
+        fileJournal = nullptr;
+    }
+    nJournalSize = 0;
+    return pathJournal.empty() || ReplayJournal(pathJournal);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -173,21 +311,13 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
-CCoinsViewCursor *CCoinsViewDB::Cursor() const
+CCoinsViewDBCursor *CCoinsViewDB::Cursor() const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
-    // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
-    }
+    i->Seek(uint256());
     return i;
 }
 
@@ -216,6 +346,19 @@ bool CCoinsViewDBCursor::Valid() const
     return keyTmp.first == DB_COIN;
 }
 
+void CCoinsViewDBCursor::Seek(const uint256 &hash)
+{
+    COutPoint outpoint(hash, 0);
+    pcursor->Seek(CoinEntry(&outpoint));
+    // Cache key of first record
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+        keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+    } else {
+        keyTmp.first = entry.key;
+    }
+}
+
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
@@ -227,16 +370,68 @@ void CCoinsViewDBCursor::Next()
     }
 }
 
-bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
-    CDBBatch batch(*this);
+bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<CBlockIndex*>& blockinfo) {
+    if (!FinishCompaction(false))
+        return false;
+
+    CBlockTreeDelta delta;
     for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it=fileInfo.begin(); it != fileInfo.end(); it++) {
-        batch.Write(std::make_pair(DB_BLOCK_FILES, it->first), *it->second);
+        delta.vFiles.emplace_back(it->first, *it->second);
+    }
+    delta.nLastFile = nLastFile;
+    for (CBlockIndex* pindex : blockinfo) {
+        // Status changes do not write the solution again
+        if (IsEquihashBasedAlgo(pindex->GetAlgo()) && !(pindex->nStatus & BLOCK_SEPARATE_SOLUTION)) {
+            delta.vSolutions.emplace_back(pindex->GetBlockHash(), pindex->nSolution);
+            pindex->nStatus |= BLOCK_SEPARATE_SOLUTION;
+        }
+        delta.vBlocks.emplace_back(pindex->GetBlockHash(), CDiskBlockIndex(pindex));
+    }
+
+    if (pathJournal.empty()) {
+        CDBBatch batch(*this);
+        delta.Write(batch);
+        return WriteBatch(batch, true);
     }
-    batch.Write(DB_LAST_BLOCK, nLastFile);
-    for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
-        batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+
+    CDataStream ssEntry(SER_DISK, CLIENT_VERSION);
+    ssEntry << delta;
+    CDataStream ssFrame(SER_DISK, CLIENT_VERSION);
+    ssFrame << (uint32_t)ssEntry.size();
+    ssFrame.write(ssEntry.data(), ssEntry.size());
+    ssFrame << Hash(ssEntry.begin(), ssEntry.end());
+    if (!fileJournal) {
+        fileJournal = fsbridge::fopen(pathJournal, "ab");
+        if (!fileJournal)
+            return error("%s: cannot open %s", __func__, pathJournal.string());
+    }
+    if (fwrite(ssFrame.data(), 1, ssFrame.size(), fileJournal) != ssFrame.size())
+        return error("%s: failed to write to %s", __func__, pathJournal.string());
+    FileCommit(fileJournal);
+    nJournalSize += ssFrame.size();
+
+    // Hand a large journal to the background, unless it is still busy with the last one
+    if (nJournalSize >= BLOCK_INDEX_JOURNAL_COMPACT_SIZE && !compactThread.joinable()) {
+        fclose(fileJournal);
+        fileJournal = nullptr;
+        nJournalSize = 0;
+        if (!RenameOver(pathJournal, pathJournalOld))
+            return error("%s: failed to rename %s", __func__, pathJournal.string());
+        fCompactDone = false;
+        compactThread = std::thread([this]() {
+            RenameThread("globaltoken-indexjournal");
+            bool fOk = false;
+            try {
+                fOk = ReplayJournal(pathJournalOld);
+            } catch (const std::exception& e) {
+                LogPrintf("CBlockTreeDB::WriteBatchSync: %s\n", e.what());
+            }
+            if (!fOk)
+                fCompactOk = false;
+            fCompactDone = true;
+        });
     }
-    return WriteBatch(batch, true);
+    return true;
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
@@ -262,11 +457,32 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+bool CBlockTreeDB::WriteSnapshotBase(const uint256 &hashBlock, unsigned int nChainTx) {
+    return Write(DB_SNAPSHOT_BASE, std::make_pair(hashBlock, nChainTx), true);
+}
+
+bool CBlockTreeDB::ReadSnapshotBase(uint256 &hashBlock, unsigned int &nChainTx) {
+    std::pair<uint256, unsigned int> base;
+    if (!Read(DB_SNAPSHOT_BASE, base))
+        return false;
+    hashBlock = base.first;
+    nChainTx = base.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseSnapshotBase() {
+    return Erase(DB_SNAPSHOT_BASE, true);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+
+    // Separately stored solutions are in the same block hash order
+    std::unique_ptr<CDBIterator> pcursorSolution(NewIterator());
+    pcursorSolution->Seek(std::make_pair(DB_BLOCK_SOLUTION, uint256()));
     
     vAuxpowValidation.reserve(445724); // the estimated amount of auxpow blocks between hardfork 1 and hardfork 2
 
@@ -277,6 +493,14 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
         if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
+                if (diskindex.nStatus & BLOCK_SEPARATE_SOLUTION) {
+                    std::pair<char, uint256> keySolution;
+                    while (pcursorSolution->Valid() && pcursorSolution->GetKey(keySolution) && keySolution.first == DB_BLOCK_SOLUTION && keySolution.second < key.second)
+                        pcursorSolution->Next();
+                    if (!pcursorSolution->Valid() || !pcursorSolution->GetKey(keySolution) || keySolution.first != DB_BLOCK_SOLUTION ||
+                        keySolution.second != key.second || !pcursorSolution->GetValue(diskindex.nSolution))
+                        return error("%s: solution of block %s not found", __func__, key.second.ToString());
+                }
                 // Construct block index object
                 CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
@@ -10,13 +10,15 @@
 #include <dbwrapper.h>
 #include <chain.h>
 
+#include <atomic>
 #include <map>
+#include <stdio.h>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 class CBlockIndex;
-class CCoinsViewDBCursor;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
@@ -37,6 +39,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Size of the block index journal at which it is written into the block tree DB in the background (bytes)
+static const uint64_t BLOCK_INDEX_JOURNAL_COMPACT_SIZE = 8 << 20;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -63,26 +67,6 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
-class CCoinsViewDB final : public CCoinsView
-{
-protected:
-    CDBWrapper db;
-public:
-    explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
-
-    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
-    bool HaveCoin(const COutPoint &outpoint) const override;
-    uint256 GetBestBlock() const override;
-    std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
-    CCoinsViewCursor *Cursor() const override;
-
-    //! Attempt to update from an older database format. Returns whether an error occurred.
-    bool Upgrade();
-    size_t EstimateSize() const override;
-};
-
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -96,6 +80,9 @@ public:
     bool Valid() const override;
     void Next() override;
 
+    /** Move to the first coin of txid hash or the first one after it. The cursor keeps reading the same database state. */
+    void Seek(const uint256 &hash);
+
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
@@ -105,16 +92,54 @@ private:
     friend class CCoinsViewDB;
 };
 
-/** Access to the block database (blocks/index/) */
+/** CCoinsView backed by the coin database (chainstate/) */
+class CCoinsViewDB final : public CCoinsView
+{
+protected:
+    CDBWrapper db;
+public:
+    explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    std::vector<uint256> GetHeadBlocks() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewDBCursor *Cursor() const override;
+
+    //! Attempt to update from an older database format. Returns whether an error occurred.
+    bool Upgrade();
+    size_t EstimateSize() const override;
+};
+
+
+/**
+ * Access to the block database (blocks/index/)
+ *
+ * Block index changes are appended to a journal (blocks/index.journal) and
+ * synced; that is all WriteBatchSync does while cs_main is held. Once the
+ * journal is BLOCK_INDEX_JOURNAL_COMPACT_SIZE large it is renamed and written
+ * into the database by a background thread. Journals left behind by a crash
+ * are written into the database when it is opened, before anything is read.
+ * An in-memory database has no journal.
+ */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CBlockTreeDB();
 
     CBlockTreeDB(const CBlockTreeDB&) = delete;
     CBlockTreeDB& operator=(const CBlockTreeDB&) = delete;
 
-    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
+    /**
+     * Journal the given block file infos and block index entries. The
+     * nSolution of an equihash block is only written the first time, the
+     * entry is marked BLOCK_SEPARATE_SOLUTION.
+     */
+    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<CBlockIndex*>& blockinfo);
+    //! Write the whole journal into the database, waiting for a background write
+    bool FlushJournal();
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
@@ -123,7 +148,27 @@ public:
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! The block a -loadsnapshot UTXO set was loaded at, and its nChainTx
+    bool WriteSnapshotBase(const uint256 &hashBlock, unsigned int nChainTx);
+    bool ReadSnapshotBase(uint256 &hashBlock, unsigned int &nChainTx);
+    bool EraseSnapshotBase();
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+
+private:
+    //! The journal appended to, and the one being written into the database
+    fs::path pathJournal;
+    fs::path pathJournalOld;
+    FILE* fileJournal;
+    uint64_t nJournalSize;
+
+    std::thread compactThread;
+    std::atomic<bool> fCompactDone;
+    std::atomic<bool> fCompactOk;
+
+    //! Write a journal file into the database and remove it
+    bool ReplayJournal(const fs::path& path);
+    //! Join the background write once it is done, or wait for it if fWait is set
+    bool FinishCompaction(bool fWait);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -0,0 +1,313 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxosnapshot.h>
+
+#include <addressindex.h>
+#include <algostats.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coinstats.h>
+#include <consensus/validation.h>
+#include <init.h>
+#include <streams.h>
+#include <sync.h>
+#include <txdb.h>
+#include <ui_interface.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+#include <warnings.h>
+
+#include <atomic>
+#include <memory>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+static std::atomic<bool> fSnapshotPending(false);
+//! A LoadUTXOSnapshot call is writing coins (guarded by cs_main)
+static bool fSnapshotWriting = false;
+
+CSnapshotReader::CSnapshotReader(CAutoFile& fileIn) : file(fileIn)
+{
+    file >> metadata;
+    if (!metadata.IsValid())
+        throw std::ios_base::failure("not a UTXO snapshot of a supported version");
+}
+
+bool CSnapshotReader::ReadChunk(std::vector<std::pair<COutPoint, Coin> >& vCoins)
+{
+    vCoins.clear();
+    uint64_t nTxids = ReadCompactSize(file);
+    if (nTxids == 0)
+        return false;
+    for (uint64_t i = 0; i < nTxids; i++) {
+        uint256 txid;
+        file >> txid;
+        uint64_t nOutputs = ReadCompactSize(file);
+        for (uint64_t j = 0; j < nOutputs; j++) {
+            uint32_t n;
+            Coin coin;
+            file >> VARINT(n);
+            file >> coin;
+            vCoins.emplace_back(COutPoint(txid, n), std::move(coin));
+        }
+    }
+    return true;
+}
+
+bool WriteUTXOSnapshot(CCoinsViewCursor* pcursor, CAutoFile& file, CCoinsStats& stats)
+{
+    stats.hashBlock = pcursor->GetBestBlock();
+    file << CSnapshotMetadata(stats.hashBlock);
+
+    CCoinsStatsHasher hasher(stats);
+    CDataStream chunk(SER_DISK, CLIENT_VERSION);
+    uint64_t nChunkTxids = 0;
+    uint64_t nChunkCoins = 0;
+    uint256 txid;
+    std::vector<std::pair<uint32_t, Coin> > outputs;
+
+    auto writeTx = [&]() {
+        chunk << txid;
+        WriteCompactSize(chunk, outputs.size());
+        for (const auto& output : outputs) {
+            chunk << VARINT(output.first);
+            chunk << output.second;
+        }
+        nChunkTxids++;
+        nChunkCoins += outputs.size();
+        outputs.clear();
+    };
+    auto writeChunk = [&]() {
+        WriteCompactSize(file, nChunkTxids);
+        file.write(chunk.data(), chunk.size());
+        chunk.clear();
+        nChunkTxids = 0;
+        nChunkCoins = 0;
+    };
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+            return error("%s: unable to read value", __func__);
+        if (!outputs.empty() && key.hash != txid) {
+            writeTx();
+            if (nChunkCoins >= SNAPSHOT_CHUNK_COINS)
+                writeChunk();
+        }
+        if (!hasher.Add(key, coin))
+            return error("%s: coins database is not in outpoint order", __func__);
+        txid = key.hash;
+        outputs.emplace_back(key.n, std::move(coin));
+        pcursor->Next();
+    }
+    if (!outputs.empty())
+        writeTx();
+    if (nChunkTxids)
+        writeChunk();
+    WriteCompactSize(file, 0);
+
+    hasher.Finalize();
+    return true;
+}
+
+bool VerifyUTXOSnapshot(const fs::path& path, const CChainParams& chainparams, CCoinsStats& stats, std::string& strError)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf(_("Cannot open UTXO snapshot %s"), path.string());
+        return false;
+    }
+
+    try {
+        CSnapshotReader reader(file);
+        stats.hashBlock = reader.GetMetadata().hashBlock;
+
+        const CSnapshotCommitment* commitment = chainparams.SnapshotCommitment(stats.hashBlock);
+        if (!commitment) {
+            strError = strprintf(_("UTXO snapshot base block %s has no commitment in the chain parameters"), stats.hashBlock.ToString());
+            return false;
+        }
+
+        CCoinsStatsHasher hasher(stats);
+        std::vector<std::pair<COutPoint, Coin> > vCoins;
+        while (reader.ReadChunk(vCoins)) {
+            boost::this_thread::interruption_point();
+            for (const auto& item : vCoins) {
+                if (!hasher.Add(item.first, item.second)) {
+                    strError = strprintf(_("UTXO snapshot %s is not in outpoint order"), path.string());
+                    return false;
+                }
+            }
+        }
+        hasher.Finalize();
+
+        if (stats.hashSerialized != commitment->hashSerialized) {
+            strError = strprintf(_("UTXO snapshot %s does not match the commitment for block %s (hash %s, expected %s)"),
+                path.string(), stats.hashBlock.ToString(), stats.hashSerialized.ToString(), commitment->hashSerialized.ToString());
+            return false;
+        }
+        stats.nHeight = commitment->nHeight;
+        LogPrintf("%s: snapshot %s at block %s verified, %u transactions, %u outputs\n", __func__,
+            path.string(), stats.hashBlock.ToString(), stats.nTransactions, stats.nTransactionOutputs);
+    } catch (const std::exception& e) {
+        strError = strprintf(_("Error reading UTXO snapshot %s: %s"), path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+/** The chainstate is unusable after a failed load, stop like AbortNode */
+static void AbortSnapshot(const std::string& strError)
+{
+    fSnapshotPending = false;
+    SetMiscWarning(strError);
+    LogPrintf("*** %s\n", strError);
+    uiInterface.ThreadSafeMessageBox(strError, "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, const CChainParams& chainparams, std::string& strError)
+{
+    // Once coins are written the chainstate belongs to no block until the
+    // load completes, so any failure from then on stops the node.
+    bool fWriting = false;
+    auto fail = [&](const std::string& strMessage) {
+        strError = strMessage;
+        if (fWriting && !ShutdownRequested())
+            AbortSnapshot(strError);
+        return false;
+    };
+
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return fail(strprintf(_("Cannot open UTXO snapshot %s"), path.string()));
+
+    CBlockIndex* pindexBase;
+    try {
+        CSnapshotReader reader(file);
+        const uint256& hashBlock = reader.GetMetadata().hashBlock;
+        const CSnapshotCommitment* commitment = chainparams.SnapshotCommitment(hashBlock);
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            if (!commitment || mi == mapBlockIndex.end() || !mi->second->IsValid(BLOCK_VALID_TREE))
+                return fail(strprintf(_("The header of UTXO snapshot base block %s is not known"), hashBlock.ToString()));
+            pindexBase = mi->second;
+            if (pindexBase->nHeight != commitment->nHeight)
+                return fail(strprintf(_("UTXO snapshot base block %s is at height %d, not %d"), hashBlock.ToString(), pindexBase->nHeight, commitment->nHeight));
+            if (chainActive.Height() != 0 || pindexSnapshotBase || fSnapshotWriting)
+                return fail(_("A UTXO snapshot can only be loaded before any block past genesis is connected"));
+            if (fTxIndex || paddressindex || pspentindex || palgostatsindex)
+                return fail(_("A UTXO snapshot cannot be loaded with -txindex or the optional indexes enabled"));
+
+            if (!pcoinsTip->Flush())
+                return fail(_("Failed to write to coin database"));
+            pblocktree->WriteFlag("snapshotloading", true);
+            fWriting = true;
+            fSnapshotWriting = true;
+            fSnapshotPending = true;
+        }
+
+        // The coins are written without holding cs_main, which could be held
+        // for minutes otherwise. Block download is held back meanwhile, and
+        // the tip is checked again once all coins are in.
+        LogPrintf("%s: loading UTXO snapshot at block %s (height %d)\n", __func__, hashBlock.ToString(), pindexBase->nHeight);
+        CCoinsStats stats;
+        stats.hashBlock = hashBlock;
+        CCoinsStatsHasher hasher(stats);
+        std::vector<std::pair<COutPoint, Coin> > vCoins;
+        while (reader.ReadChunk(vCoins)) {
+            if (ShutdownRequested())
+                return fail(_("Loading the UTXO snapshot was interrupted"));
+            CCoinsMap mapCoins;
+            for (auto& item : vCoins) {
+                if (!hasher.Add(item.first, item.second))
+                    return fail(strprintf(_("UTXO snapshot %s is not in outpoint order"), path.string()));
+                CCoinsCacheEntry& entry = mapCoins[item.first];
+                entry.coin = std::move(item.second);
+                entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+            }
+            if (!pcoinsdbview->BatchWrite(mapCoins, hashBlock))
+                return fail(_("Failed to write to coin database"));
+            LogPrintf("%s: %u transactions, %u outputs loaded\n", __func__, stats.nTransactions, stats.nTransactionOutputs);
+        }
+        hasher.Finalize();
+        if (stats.hashSerialized != commitment->hashSerialized)
+            return fail(strprintf(_("UTXO snapshot %s changed while it was loaded"), path.string()));
+
+        LOCK(cs_main);
+        if (chainActive.Height() != 0 || pindexSnapshotBase)
+            return fail(_("A block was connected while the UTXO snapshot was loaded"));
+        pcoinsTip->SetBestBlock(hashBlock);
+        if (!ActivateSnapshotBase(pindexBase, commitment->nChainTx, chainparams))
+            return fail(_("Failed to activate the UTXO snapshot"));
+        pblocktree->WriteFlag("snapshotloading", false);
+        fSnapshotWriting = false;
+        fSnapshotPending = false;
+    } catch (const std::exception& e) {
+        return fail(strprintf(_("Error reading UTXO snapshot %s: %s"), path.string(), e.what()));
+    }
+    LogPrintf("%s: UTXO snapshot loaded, new tip %s (height %d)\n", __func__, pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+
+    const bool fInitialDownload = IsInitialBlockDownload();
+    GetMainSignals().UpdatedBlockTip(pindexBase, nullptr, fInitialDownload);
+    uiInterface.NotifyBlockTip(fInitialDownload, pindexBase);
+
+    // Connect any blocks after the base we already have
+    CValidationState state;
+    ActivateBestChain(state, chainparams);
+    return true;
+}
+
+static void ThreadLoadUTXOSnapshot(fs::path path)
+{
+    RenameThread("globaltoken-snapshot");
+    const CChainParams& chainparams = Params();
+
+    std::string strError;
+    CCoinsStats stats;
+    LogPrintf("Verifying UTXO snapshot %s...\n", path.string());
+    if (!VerifyUTXOSnapshot(path, chainparams, stats, strError)) {
+        AbortSnapshot(strError);
+        return;
+    }
+
+    // Headers are synced and PoW checked as usual, the snapshot is only
+    // loaded once its base block is part of the best header chain.
+    LogPrintf("Waiting for the header of UTXO snapshot base block %s...\n", stats.hashBlock.ToString());
+    while (true) {
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(stats.hashBlock);
+            if (chainActive.Tip() && mi != mapBlockIndex.end() && pindexBestHeader && pindexBestHeader->GetAncestor(mi->second->nHeight) == mi->second)
+                break;
+        }
+        MilliSleep(1000);
+    }
+
+    if (!LoadUTXOSnapshot(path, chainparams, strError)) {
+        if (!ShutdownRequested())
+            AbortSnapshot(strError);
+        return;
+    }
+    fSnapshotPending = false;
+}
+
+void StartLoadUTXOSnapshot(boost::thread_group& threadGroup, const fs::path& path)
+{
+    fSnapshotPending = true;
+    threadGroup.create_thread(boost::bind(&ThreadLoadUTXOSnapshot, path));
+}
+
+bool IsUTXOSnapshotPending()
+{
+    return fSnapshotPending;
+}
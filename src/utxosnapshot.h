@@ -0,0 +1,116 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include <coins.h>
+#include <fs.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CAutoFile;
+class CChainParams;
+class CCoinsViewCursor;
+struct CCoinsStats;
+
+namespace boost {
+class thread_group;
+} // namespace boost
+
+/** A snapshot chunk is closed after the transaction that brings it to this many coins */
+static const unsigned int SNAPSHOT_CHUNK_COINS = 100000;
+
+/**
+ * Header of a UTXO set snapshot file.
+ *
+ * It is followed by chunks of coins in outpoint order, so that a snapshot can
+ * be written from a coins database cursor and loaded without holding it all
+ * in memory. Each chunk is COMPACTSIZE(number of transactions) followed by,
+ * per transaction, the txid, COMPACTSIZE(number of outputs) and VARINT(n) +
+ * Coin for every unspent output. An empty chunk ends the snapshot.
+ */
+class CSnapshotMetadata
+{
+public:
+    static const int CURRENT_VERSION = 1;
+
+    char pchMagic[4];
+    int nVersion;
+    //! The block the UTXO set was taken at
+    uint256 hashBlock;
+
+    CSnapshotMetadata() : CSnapshotMetadata(uint256()) {}
+    explicit CSnapshotMetadata(const uint256& hashBlockIn) : pchMagic{'u', 't', 'x', 'o'}, nVersion(CURRENT_VERSION), hashBlock(hashBlockIn) {}
+
+    bool IsValid() const { return memcmp(pchMagic, "utxo", sizeof(pchMagic)) == 0 && nVersion == CURRENT_VERSION; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(FLATDATA(pchMagic));
+        READWRITE(nVersion);
+        READWRITE(hashBlock);
+    }
+};
+
+/** Reads the coins of a snapshot file chunk by chunk */
+class CSnapshotReader
+{
+public:
+    /** Reads the metadata, throws std::ios_base::failure if it is not a snapshot */
+    explicit CSnapshotReader(CAutoFile& fileIn);
+
+    const CSnapshotMetadata& GetMetadata() const { return metadata; }
+
+    /** Read the next chunk of coins, returns false after the last one */
+    bool ReadChunk(std::vector<std::pair<COutPoint, Coin> >& vCoins);
+
+private:
+    CAutoFile& file;
+    CSnapshotMetadata metadata;
+};
+
+/**
+ * Write the coins of a cursor as a snapshot at its best block and fill stats
+ * like GetUTXOStats (except nHeight and nDiskSize). The cursor must be
+ * created under cs_main so that its coins belong to its best block.
+ */
+bool WriteUTXOSnapshot(CCoinsViewCursor* pcursor, CAutoFile& file, CCoinsStats& stats);
+
+/**
+ * Hash a snapshot file and check it against the chain params commitment for
+ * its base block, whose hash is returned in stats.hashBlock. Does not touch
+ * the chainstate.
+ */
+bool VerifyUTXOSnapshot(const fs::path& path, const CChainParams& chainparams, CCoinsStats& stats, std::string& strError);
+
+/**
+ * Write a snapshot into the coins database of a node that has not connected
+ * any block past genesis yet, and make its base block the tip. The header of
+ * the base block must be known. The file is hashed again while it is written;
+ * call VerifyUTXOSnapshot first so that a bad file fails before anything is
+ * written. Once writing has begun, a failure shuts the node down; a load that
+ * does not complete leaves a flag behind that makes the next start wipe the
+ * chainstate.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, const CChainParams& chainparams, std::string& strError);
+
+/**
+ * Start loading a snapshot in the background (-loadsnapshot). The thread
+ * verifies the file, waits until the base block header is on the best header
+ * chain and then loads it. Blocks are not downloaded in the meantime.
+ */
+void StartLoadUTXOSnapshot(boost::thread_group& threadGroup, const fs::path& path);
+
+/** True while a -loadsnapshot UTXO set is waiting for its base header, or any UTXO snapshot is being loaded */
+bool IsUTXOSnapshotPending();
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
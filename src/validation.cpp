@@ -7,6 +7,8 @@
 
 #include <validation.h>
 
+#include <addressindex.h>
+#include <algostats.h>
 #include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -186,6 +188,7 @@ public:
     bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
     bool RewindBlockIndex(const CChainParams& params);
     bool LoadGenesisBlock(const CChainParams& chainparams);
+    bool ActivateSnapshotBase(CBlockIndex* pindexBase, unsigned int nChainTx, const CChainParams& chainparams);
 
     void PruneBlockIndexCandidates();
 
@@ -221,6 +224,7 @@ CCriticalSection cs_treasury;
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
 CChain& chainActive = g_chainstate.chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
+CBlockIndex *pindexSnapshotBase = nullptr;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
@@ -301,6 +305,10 @@ std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
+/** Outpoints whose coins eviction keeps in pcoinsTip. Only ever locked last. */
+static CCriticalSection cs_pinnedCoins;
+static COutPointSet setPinnedCoins;
+
 enum FlushStateMode {
     FLUSH_STATE_NONE,
     FLUSH_STATE_IF_NEEDED,
@@ -447,6 +455,19 @@ bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin)
     return true;
 }
 
+void PinCoin(const COutPoint& outpoint)
+{
+    LOCK(cs_pinnedCoins);
+    setPinnedCoins.insert(outpoint);
+}
+
+void SetPinnedCoins(const std::vector<COutPoint>& vOutpoints)
+{
+    LOCK(cs_pinnedCoins);
+    setPinnedCoins.clear();
+    setPinnedCoins.insert(vOutpoints.begin(), vOutpoints.end());
+}
+
 int GetUTXOHeight(const COutPoint& outpoint)
 {
     // -1 means UTXO is yet unknown or already spent
@@ -1163,7 +1184,7 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
 }
 
 template<typename T>
-static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPoW = true)
 {    
     block.SetNull();
 
@@ -1181,6 +1202,8 @@ static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensu
     }
     
     // Check the header
+    if (!fCheckPoW)
+        return true;
     if (!CheckProofOfWork(block, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
     
@@ -1189,7 +1212,7 @@ static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensu
 }
 
 template<typename T>
-static bool ReadBlockOrHeader(T& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+static bool ReadBlockOrHeader(T& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPoW = true)
 {
     CDiskBlockPos blockPos;
     {
@@ -1197,7 +1220,7 @@ static bool ReadBlockOrHeader(T& block, const CBlockIndex* pindex, const Consens
         blockPos = pindex->GetBlockPos();
     }
 
-    if (!ReadBlockOrHeader(block, blockPos, consensusParams))
+    if (!ReadBlockOrHeader(block, blockPos, consensusParams, fCheckPoW))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
@@ -1205,14 +1228,14 @@ static bool ReadBlockOrHeader(T& block, const CBlockIndex* pindex, const Consens
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPoW)
 {
-    return ReadBlockOrHeader(block, pos, consensusParams);
+    return ReadBlockOrHeader(block, pos, consensusParams, fCheckPoW);
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPoW)
 {
-    return ReadBlockOrHeader(block, pindex, consensusParams);
+    return ReadBlockOrHeader(block, pindex, consensusParams, fCheckPoW);
 }
 
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
@@ -1562,7 +1585,9 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1593,6 +1618,8 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1943,8 +1970,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
             view.SetBestBlock(pindex->GetBlockHash());
+            if (!IndexesConnectBlock(block, CBlockUndo(), pindex))
+                return AbortNode(state, "Failed to write the chain indexes");
+        }
         return true;
     }
 
@@ -2114,22 +2144,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if(chainparams.GetConsensus().Hardfork1.IsActivated(block.nTime))
     {
         // Coinbase transaction must include the Treasury amount to the given Reward address, if Hardfork is activated.
-        bool found = false;
+        CCoinbasePayeesRef payees = mnpayments.GetCoinbasePayees(pindex->nHeight);
+        bool fTreasuryPaid, fMasternodePaid;
+        payees->CheckCoinbase(*block.vtx[0], chainparams.GetTreasuryAmount(blockReward), chainparams.GetConsensus().Hardfork3.IsActivated(block.nTime), fTreasuryPaid, fMasternodePaid);
 
-        for(const CTxOut& output : block.vtx[0]->vout) {
-            if (output.scriptPubKey == Params().GetFoundersRewardScriptAtHeight(pindex->nHeight, chainparams.GetConsensus().Hardfork3.IsActivated(block.nTime))) {
-                if (output.nValue == Params().GetTreasuryAmount(blockReward)) {
-                    found = true;
-                    break;
-                }
-            }
-        }
-
-        if (!found) {
+        if (!fTreasuryPaid) {
             return state.DoS(100, error("ConnectBlock(): couldn't find treasury payment"), REJECT_INVALID, "bad-cb-treasury");
         }
         
-        if (!IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, blockReward)) {
+        if (!IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, *payees, fMasternodePaid)) {
             mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
             return state.DoS(0, error("ConnectBlock(): couldn't find masternode payment"),
                                     REJECT_INVALID, "bad-cb-payee");
@@ -2162,6 +2185,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (!WriteTxIndexDataForBlock(block, state, pindex))
         return false;
 
+    // Only applies when the indexes are built up to pindex->pprev, which
+    // leaves out VerifyDB's reconnection of old blocks
+    if (!IndexesConnectBlock(block, blockundo, pindex))
+        return AbortNode(state, "Failed to write the chain indexes");
+
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2175,11 +2203,29 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     return true;
 }
 
+/** Evict cold coins from pcoinsTip down to nTargetUsage bytes */
+static void EvictCoins(size_t nTargetUsage)
+{
+    if (pcoinsTip->DynamicMemoryUsage() <= nTargetUsage)
+        return;
+    const int64_t nStart = GetTimeMicros();
+    const size_t nCoinsBefore = pcoinsTip->GetCacheSize();
+    {
+        LOCK(cs_pinnedCoins);
+        pcoinsTip->Evict(nTargetUsage, setPinnedCoins);
+    }
+    LogPrint(BCLog::COINDB, "Evicted %u cold coins in %.2fms, %u coins (%.1fMiB) left in the cache\n", nCoinsBefore - pcoinsTip->GetCacheSize(),
+        (GetTimeMicros() - nStart) * 0.001, pcoinsTip->GetCacheSize(), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)));
+}
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with
  * if they're too large, if it's been a while since the last write,
  * or always and in all cases if we're in prune mode and are deleting files.
+ * The coins cache is written in the background unless we are called with
+ * FLUSH_STATE_ALWAYS or prune; only when the cache is over its budget, or a
+ * copy of its dirty coins would not fit, does the caller wait for the write.
  */
 bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight) {
     int64_t nMempoolUsage = mempool.DynamicMemoryUsage();
@@ -2221,8 +2267,15 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             nLastSetChain = nNow;
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
+        // Pick up a background chainstate flush that has completed, then make room for new coins.
+        if (pcoinsTip->IsFlushing()) {
+            if (!pcoinsTip->FinishFlush(false))
+                return AbortNode(state, "Failed to write to coin database");
+            if (!pcoinsTip->IsFlushing())
+                EvictCoins(nTotalSpace / 100 * COINS_CACHE_EVICT_TARGET);
+        }
+        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
         // The cache is over the limit, we have to write now.
@@ -2248,7 +2301,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     vFiles.push_back(std::make_pair(*it, &vinfoBlockFile[*it]));
                     setDirtyFileInfo.erase(it++);
                 }
-                std::vector<const CBlockIndex*> vBlocks;
+                std::vector<CBlockIndex*> vBlocks;
                 vBlocks.reserve(setDirtyBlockIndex.size());
                 for (std::set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
                     vBlocks.push_back(*it);
@@ -2273,9 +2326,38 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
-                return AbortNode(state, "Failed to write to coin database");
-            nLastFlush = nNow;
+            if (mode == FLUSH_STATE_ALWAYS || fFlushForPrune) {
+                if (!pcoinsTip->Flush())
+                    return AbortNode(state, "Failed to write to coin database");
+                nLastFlush = nNow;
+            } else if (!pcoinsTip->IsFlushing() || fCacheCritical) {
+                // Validation continues while a copy of the dirty coins is
+                // written, and the warm ones stay cached. The copy has to fit
+                // in the budget next to the cache, cold coins make room for
+                // it. Over the budget, or without room, the dirty coins are
+                // written in place and we wait.
+                const int64_t nStart = GetTimeMicros();
+                bool fBackground = false;
+                if (!fCacheCritical) {
+                    const size_t nCopyUsage = pcoinsTip->EstimateFlushCopyUsage();
+                    if (nCopyUsage < (size_t)nTotalSpace) {
+                        if (pcoinsTip->DynamicMemoryUsage() + nCopyUsage > (size_t)nTotalSpace)
+                            EvictCoins(nTotalSpace - nCopyUsage);
+                        fBackground = pcoinsTip->DynamicMemoryUsage() + nCopyUsage <= (size_t)nTotalSpace;
+                    }
+                }
+                if (fBackground) {
+                    if (!pcoinsTip->FlushInBackground())
+                        return AbortNode(state, "Failed to write to coin database");
+                    LogPrint(BCLog::COINDB, "Started a background chainstate flush, %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
+                } else {
+                    if (!pcoinsTip->FlushModified())
+                        return AbortNode(state, "Failed to write to coin database");
+                    LogPrint(BCLog::COINDB, "Wrote the chainstate in place, %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
+                    EvictCoins(nTotalSpace / 100 * COINS_CACHE_EVICT_TARGET);
+                }
+                nLastFlush = nNow;
+            }
         }
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
@@ -2399,6 +2481,11 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         bool flushed = view.Flush();
         assert(flushed);
     }
+    if (paddressindex || pspentindex || palgostatsindex) {
+        CBlockUndo blockUndo;
+        if (((paddressindex || pspentindex) && !UndoReadFromDisk(blockUndo, pindexDelete)) || !IndexesDisconnectBlock(block, blockUndo, pindexDelete))
+            return AbortNode(state, "Failed to revert the chain indexes");
+    }
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * MILLI);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_IF_NEEDED))
@@ -3199,8 +3286,11 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
         }
     }
     
-    if (fCheckPOW)
+    if (fCheckPOW) {
+        const int64_t nTimeStart = GetTimeMicros();
         checkresult = CheckProofOfWork(block, consensusParams, equihashvalidator);
+        state.AddPowCheckTime(GetTimeMicros() - nTimeStart);
+    }
     
     if (fCheckPOW && IsEquihashBasedAlgo(nAlgo) && !equihashvalidator) 
     {
@@ -3514,6 +3604,32 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
+/** The checks of a header against its parent that do not compute its proof of work */
+static bool CheckBlockHeaderParent(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindexPrev)
+{
+    AssertLockHeld(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+    if (mi == mapBlockIndex.end())
+        return state.DoS(10, error("%s: prev block not found", __func__), 0, "prev-blk-not-found");
+    CBlockIndex* pindexPrev = (*mi).second;
+    if (pindexPrev->nStatus & BLOCK_FAILED_MASK)
+        return state.DoS(100, error("%s: prev block invalid", __func__), REJECT_INVALID, "bad-prevblk");
+    if (!ContextualCheckBlockHeader(block, state, chainparams, pindexPrev, GetAdjustedTime()))
+        return error("%s: Consensus::ContextualCheckBlockHeader: %s, %s", __func__, block.GetHash().ToString(), FormatStateMessage(state));
+    *ppindexPrev = pindexPrev;
+    return true;
+}
+
+bool PreCheckBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams)
+{
+    AssertLockHeld(cs_main);
+    const uint256 hash = block.GetHash();
+    if (hash == chainparams.GetConsensus().hashGenesisBlock || mapBlockIndex.count(hash))
+        return true;
+    CBlockIndex* pindexPrev = nullptr;
+    return CheckBlockHeaderParent(block, state, chainparams, &pindexPrev);
+}
+
 bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
@@ -3533,20 +3649,17 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
+        // The proof of work of some algos takes milliseconds and lots of
+        // memory to compute, so it is checked last: a header that does not
+        // connect, or claims another target than its algo requires, is
+        // rejected without it.
+        CBlockIndex* pindexPrev = nullptr;
+        if (!CheckBlockHeaderParent(block, state, chainparams, &pindexPrev))
+            return false;
+
         if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
-        // Get prev block index
-        CBlockIndex* pindexPrev = nullptr;
-        BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
-        if (mi == mapBlockIndex.end())
-            return state.DoS(10, error("%s: prev block not found", __func__), 0, "prev-blk-not-found");
-        pindexPrev = (*mi).second;
-        if (pindexPrev->nStatus & BLOCK_FAILED_MASK)
-            return state.DoS(100, error("%s: prev block invalid", __func__), REJECT_INVALID, "bad-prevblk");
-        if (!ContextualCheckBlockHeader(block, state, chainparams, pindexPrev, GetAdjustedTime()))
-            return error("%s: Consensus::ContextualCheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
-
         if (!pindexPrev->IsValid(BLOCK_VALID_SCRIPTS)) {
             for (const CBlockIndex* failedit : g_failed_blocks) {
                 if (pindexPrev->GetAncestor(failedit->nHeight) == failedit) {
@@ -3698,7 +3811,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     return true;
 }
 
-bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock)
+bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock, int64_t *pnPowCheckTime)
 {
     AssertLockNotHeld(cs_main);
 
@@ -3716,6 +3829,7 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
             // Store to disk
             ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
         }
+        if (pnPowCheckTime) *pnPowCheckTime = state.GetPowCheckTime();
         if (!ret) {
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED (%s)", __func__, state.GetDebugMessage());
@@ -3989,6 +4103,13 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
         vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
     }
     sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // A node started from a UTXO snapshot never received the blocks below its
+    // base, so the base block's nChainTx comes from the snapshot instead.
+    uint256 hashSnapshotBase;
+    unsigned int nSnapshotChainTx = 0;
+    blocktree.ReadSnapshotBase(hashSnapshotBase, nSnapshotChainTx);
+
     for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
     {
         CBlockIndex* pindex = item.second;
@@ -4008,6 +4129,19 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
                 pindex->nChainTx = pindex->nTx;
             }
         }
+        if (!hashSnapshotBase.IsNull() && pindex->GetBlockHash() == hashSnapshotBase) {
+            pindex->nChainTx = nSnapshotChainTx;
+            pindexSnapshotBase = pindex;
+            // Linked through the snapshot, whatever its parents have
+            std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex->pprev);
+            while (range.first != range.second) {
+                if (range.first->second == pindex) {
+                    mapBlocksUnlinked.erase(range.first++);
+                } else {
+                    ++range.first;
+                }
+            }
+        }
         if (!(pindex->nStatus & BLOCK_FAILED_MASK) && pindex->pprev && (pindex->pprev->nStatus & BLOCK_FAILED_MASK)) {
             pindex->nStatus |= BLOCK_FAILED_CHILD;
             setDirtyBlockIndex.insert(pindex);
@@ -4111,6 +4245,33 @@ bool LoadChainTip(const CChainParams& chainparams)
     return true;
 }
 
+bool CChainState::ActivateSnapshotBase(CBlockIndex* pindexBase, unsigned int nChainTx, const CChainParams& chainparams)
+{
+    AssertLockHeld(cs_main);
+    assert(pcoinsTip->GetBestBlock() == pindexBase->GetBlockHash());
+
+    // The snapshot stands in for validating everything up to and including the base
+    pindexBase->nChainTx = nChainTx;
+    pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+    setDirtyBlockIndex.insert(pindexBase);
+    if (!pblocktree->WriteSnapshotBase(pindexBase->GetBlockHash(), nChainTx))
+        return AbortNode("Failed to write the UTXO snapshot base");
+    pindexSnapshotBase = pindexBase;
+
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    PruneBlockIndexCandidates();
+    UpdateTip(pindexBase, chainparams);
+
+    CValidationState state;
+    return FlushStateToDisk(chainparams, state, FLUSH_STATE_ALWAYS);
+}
+
+bool ActivateSnapshotBase(CBlockIndex* pindexBase, unsigned int nChainTx, const CChainParams& chainparams)
+{
+    return g_chainstate.ActivateSnapshotBase(pindexBase, nChainTx, chainparams);
+}
+
 bool VerifyAuxpowBlockIndex(std::string &strErrMsg, const Consensus::Params& consensusParams)
 {
     LOCK(cs_main);
@@ -4213,6 +4374,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (pindexSnapshotBase && pindex->nHeight <= pindexSnapshotBase->nHeight) {
+            // Blocks up to the snapshot base were never downloaded
+            LogPrintf("VerifyDB(): block verification stopping at height %d (UTXO snapshot base)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -4368,7 +4534,8 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
 
     // Note that during -reindex-chainstate we are called with an empty chainActive!
 
-    int nHeight = 1;
+    // Blocks up to a UTXO snapshot base count as validated, they have no data to rewind with
+    int nHeight = pindexSnapshotBase ? pindexSnapshotBase->nHeight + 1 : 1;
     while (nHeight <= chainActive.Height()) {
         if (IsWitnessEnabled(chainActive[nHeight - 1], params.GetConsensus()) && !(chainActive[nHeight]->nStatus & BLOCK_OPT_WITNESS)) {
             break;
@@ -4497,6 +4664,7 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    pindexSnapshotBase = nullptr;
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4719,13 +4887,21 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
     CBlockIndex* pindexFirstNotScriptsValid = nullptr; // Oldest ancestor of pindex which does not have BLOCK_VALID_SCRIPTS (regardless of being valid or not).
     while (pindex != nullptr) {
         nNodes++;
-        if (pindexFirstInvalid == nullptr && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
-        if (pindexFirstMissing == nullptr && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
-        if (pindexFirstNeverProcessed == nullptr && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotTreeValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotTransactionsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        // The blocks up to a UTXO snapshot base were never downloaded: the
+        // snapshot stands in for their data and validity. Those on the path to
+        // the base are not remembered as first lacking a property, and the
+        // data and validity checks are skipped up to the base's height.
+        const bool fSnapshotChain = pindexSnapshotBase && pindexSnapshotBase->GetAncestor(pindex->nHeight) == pindex;
+        const bool fBelowSnapshot = pindexSnapshotBase && pindex->nHeight <= pindexSnapshotBase->nHeight;
+        if (!fSnapshotChain) {
+            if (pindexFirstInvalid == nullptr && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
+            if (pindexFirstMissing == nullptr && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
+            if (pindexFirstNeverProcessed == nullptr && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
+            if (pindex->pprev != nullptr && pindexFirstNotTreeValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
+            if (pindex->pprev != nullptr && pindexFirstNotTransactionsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
+            if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
+            if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        }
 
         // Begin: actual consistency checks.
         if (pindex->pprev == nullptr) {
@@ -4733,80 +4909,82 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
             assert(pindex->GetBlockHash() == consensusParams.hashGenesisBlock); // Genesis block's hash must match.
             assert(pindex == chainActive.Genesis()); // The current active chain's genesis block must be this block.
         }
-        if (pindex->nChainTx == 0) assert(pindex->nSequenceId <= 0);  // nSequenceId can't be set positive for blocks that aren't linked (negative is used for preciousblock)
-        // VALID_TRANSACTIONS is equivalent to nTx > 0 for all nodes (whether or not pruning has occurred).
-        // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
-        if (!fHavePruned) {
-            // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
-            assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
-            assert(pindexFirstMissing == pindexFirstNeverProcessed);
-        } else {
-            // If we have pruned, then we can only say that HAVE_DATA implies nTx > 0
-            if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
-        }
-        if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
-        assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
-        // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
-        assert((pindexFirstNeverProcessed != nullptr) == (pindex->nChainTx == 0)); // nChainTx != 0 is used to signal that all parent blocks have been processed (but may have been pruned).
-        assert((pindexFirstNotTransactionsValid != nullptr) == (pindex->nChainTx == 0));
         assert(pindex->nHeight == nHeight); // nHeight must be consistent.
         assert(pindex->pprev == nullptr || pindex->nChainWork >= pindex->pprev->nChainWork); // For every block except the genesis block, the chainwork must be larger than the parent's.
         assert(nHeight < 2 || (pindex->pskip && (pindex->pskip->nHeight < nHeight))); // The pskip pointer must point back for all but the first 2 blocks.
         assert(pindexFirstNotTreeValid == nullptr); // All mapBlockIndex entries must at least be TREE valid
         if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TREE) assert(pindexFirstNotTreeValid == nullptr); // TREE valid implies all parents are TREE valid
-        if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_CHAIN) assert(pindexFirstNotChainValid == nullptr); // CHAIN valid implies all parents are CHAIN valid
-        if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_SCRIPTS) assert(pindexFirstNotScriptsValid == nullptr); // SCRIPTS valid implies all parents are SCRIPTS valid
-        if (pindexFirstInvalid == nullptr) {
-            // Checks for not-invalid blocks.
-            assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0); // The failed mask cannot be set for blocks without invalid parents.
-        }
-        if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstNeverProcessed == nullptr) {
+        if (!fBelowSnapshot) {
+            if (pindex->nChainTx == 0) assert(pindex->nSequenceId <= 0);  // nSequenceId can't be set positive for blocks that aren't linked (negative is used for preciousblock)
+            // VALID_TRANSACTIONS is equivalent to nTx > 0 for all nodes (whether or not pruning has occurred).
+            // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
+            if (!fHavePruned) {
+                // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
+                assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+                assert(pindexFirstMissing == pindexFirstNeverProcessed);
+            } else {
+                // If we have pruned, then we can only say that HAVE_DATA implies nTx > 0
+                if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
+            }
+            if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
+            assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
+            // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
+            assert((pindexFirstNeverProcessed != nullptr) == (pindex->nChainTx == 0)); // nChainTx != 0 is used to signal that all parent blocks have been processed (but may have been pruned).
+            assert((pindexFirstNotTransactionsValid != nullptr) == (pindex->nChainTx == 0));
+            if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_CHAIN) assert(pindexFirstNotChainValid == nullptr); // CHAIN valid implies all parents are CHAIN valid
+            if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_SCRIPTS) assert(pindexFirstNotScriptsValid == nullptr); // SCRIPTS valid implies all parents are SCRIPTS valid
             if (pindexFirstInvalid == nullptr) {
-                // If this block sorts at least as good as the current tip and
-                // is valid and we have all data for its parents, it must be in
-                // setBlockIndexCandidates.  chainActive.Tip() must also be there
-                // even if some data has been pruned.
-                if (pindexFirstMissing == nullptr || pindex == chainActive.Tip()) {
-                    assert(setBlockIndexCandidates.count(pindex));
+                // Checks for not-invalid blocks.
+                assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0); // The failed mask cannot be set for blocks without invalid parents.
+            }
+            if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstNeverProcessed == nullptr) {
+                if (pindexFirstInvalid == nullptr) {
+                    // If this block sorts at least as good as the current tip and
+                    // is valid and we have all data for its parents, it must be in
+                    // setBlockIndexCandidates.  chainActive.Tip() must also be there
+                    // even if some data has been pruned.
+                    if (pindexFirstMissing == nullptr || pindex == chainActive.Tip()) {
+                        assert(setBlockIndexCandidates.count(pindex));
+                    }
+                    // If some parent is missing, then it could be that this block was in
+                    // setBlockIndexCandidates but had to be removed because of the missing data.
+                    // In this case it must be in mapBlocksUnlinked -- see test below.
                 }
-                // If some parent is missing, then it could be that this block was in
-                // setBlockIndexCandidates but had to be removed because of the missing data.
-                // In this case it must be in mapBlocksUnlinked -- see test below.
+            } else { // If this block sorts worse than the current tip or some ancestor's block has never been seen, it cannot be in setBlockIndexCandidates.
+                assert(setBlockIndexCandidates.count(pindex) == 0);
             }
-        } else { // If this block sorts worse than the current tip or some ancestor's block has never been seen, it cannot be in setBlockIndexCandidates.
-            assert(setBlockIndexCandidates.count(pindex) == 0);
-        }
-        // Check whether this block is in mapBlocksUnlinked.
-        std::pair<std::multimap<CBlockIndex*,CBlockIndex*>::iterator,std::multimap<CBlockIndex*,CBlockIndex*>::iterator> rangeUnlinked = mapBlocksUnlinked.equal_range(pindex->pprev);
-        bool foundInUnlinked = false;
-        while (rangeUnlinked.first != rangeUnlinked.second) {
-            assert(rangeUnlinked.first->first == pindex->pprev);
-            if (rangeUnlinked.first->second == pindex) {
-                foundInUnlinked = true;
-                break;
+            // Check whether this block is in mapBlocksUnlinked.
+            std::pair<std::multimap<CBlockIndex*,CBlockIndex*>::iterator,std::multimap<CBlockIndex*,CBlockIndex*>::iterator> rangeUnlinked = mapBlocksUnlinked.equal_range(pindex->pprev);
+            bool foundInUnlinked = false;
+            while (rangeUnlinked.first != rangeUnlinked.second) {
+                assert(rangeUnlinked.first->first == pindex->pprev);
+                if (rangeUnlinked.first->second == pindex) {
+                    foundInUnlinked = true;
+                    break;
+                }
+                rangeUnlinked.first++;
             }
-            rangeUnlinked.first++;
-        }
-        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed != nullptr && pindexFirstInvalid == nullptr) {
-            // If this block has block data available, some parent was never received, and has no invalid parents, it must be in mapBlocksUnlinked.
-            assert(foundInUnlinked);
-        }
-        if (!(pindex->nStatus & BLOCK_HAVE_DATA)) assert(!foundInUnlinked); // Can't be in mapBlocksUnlinked if we don't HAVE_DATA
-        if (pindexFirstMissing == nullptr) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in mapBlocksUnlinked.
-        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == nullptr && pindexFirstMissing != nullptr) {
-            // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
-            assert(fHavePruned); // We must have pruned.
-            // This block may have entered mapBlocksUnlinked if:
-            //  - it has a descendant that at some point had more work than the
-            //    tip, and
-            //  - we tried switching to that descendant but were missing
-            //    data for some intermediate block between chainActive and the
-            //    tip.
-            // So if this block is itself better than chainActive.Tip() and it wasn't in
-            // setBlockIndexCandidates, then it must be in mapBlocksUnlinked.
-            if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && setBlockIndexCandidates.count(pindex) == 0) {
-                if (pindexFirstInvalid == nullptr) {
-                    assert(foundInUnlinked);
+            if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed != nullptr && pindexFirstInvalid == nullptr) {
+                // If this block has block data available, some parent was never received, and has no invalid parents, it must be in mapBlocksUnlinked.
+                assert(foundInUnlinked);
+            }
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA)) assert(!foundInUnlinked); // Can't be in mapBlocksUnlinked if we don't HAVE_DATA
+            if (pindexFirstMissing == nullptr) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in mapBlocksUnlinked.
+            if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == nullptr && pindexFirstMissing != nullptr) {
+                // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
+                assert(fHavePruned); // We must have pruned.
+                // This block may have entered mapBlocksUnlinked if:
+                //  - it has a descendant that at some point had more work than the
+                //    tip, and
+                //  - we tried switching to that descendant but were missing
+                //    data for some intermediate block between chainActive and the
+                //    tip.
+                // So if this block is itself better than chainActive.Tip() and it wasn't in
+                // setBlockIndexCandidates, then it must be in mapBlocksUnlinked.
+                if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && setBlockIndexCandidates.count(pindex) == 0) {
+                    if (pindexFirstInvalid == nullptr) {
+                        assert(foundInUnlinked);
+                    }
                 }
             }
         }
@@ -37,6 +37,7 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
@@ -107,6 +108,8 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** Percentage of the coins cache budget that cold coins are evicted down to after a chainstate flush. */
+static const int COINS_CACHE_EVICT_TARGET = 80;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Average delay between local address broadcasts in seconds. */
@@ -205,6 +208,9 @@ extern arith_uint256 nMinimumChainWork;
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
 
+/** The block a -loadsnapshot UTXO set was loaded at. There is no block data below it. */
+extern CBlockIndex *pindexSnapshotBase;
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -250,9 +256,10 @@ static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 550 * 1024 * 1024;
  * @param[in]   pblock  The block we want to process.
  * @param[in]   fForceProcessing Process this block even if unrequested; used for non-network block sources and whitelisted peers.
  * @param[out]  fNewBlock A boolean which is set to indicate if the block was first received via this call
+ * @param[out]  pnPowCheckTime If non-null, set to the microseconds spent checking proof of work for this block
  * @return True if state.IsValid()
  */
-bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock);
+bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock, int64_t* pnPowCheckTime = nullptr);
 
 /**
  * Process incoming block headers.
@@ -267,6 +274,16 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  */
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex=nullptr, CBlockHeader *first_invalid=nullptr);
 
+/**
+ * Check a header against its parent without computing its proof of work:
+ * the parent must be known and valid, nBits the target its algo requires,
+ * and timestamps, version and checkpoints in order. Headers we already have
+ * pass, AcceptBlockHeader deals with them.
+ *
+ * Requires cs_main.
+ */
+bool PreCheckBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams);
+
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -282,6 +299,8 @@ bool LoadGenesisBlock(const CChainParams& chainparams);
 bool LoadBlockIndex(const CChainParams& chainparams);
 /** Update the chain tip based on database information. */
 bool LoadChainTip(const CChainParams& chainparams);
+/** Make pindexBase the tip once the coins database holds the UTXO set at it */
+bool ActivateSnapshotBase(CBlockIndex* pindexBase, unsigned int nChainTx, const CChainParams& chainparams);
 /** Verify the auxpow blockchain data */
 bool VerifyAuxpowBlockIndex(std::string &strErrMsg, const Consensus::Params& consensusParams);
 /** Clear the auxpow validation cached block hashes. */
@@ -331,6 +350,10 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin);
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetUTXOConfirmations(const COutPoint& outpoint);
+/** Keep the coin of outpoint in pcoinsTip when cold coins are evicted, for masternode collaterals */
+void PinCoin(const COutPoint& outpoint);
+/** Replace the set of outpoints kept in pcoinsTip by eviction */
+void SetPinnedCoins(const std::vector<COutPoint>& vOutpoints);
 
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
@@ -417,9 +440,17 @@ void InitScriptExecutionCache();
 
 
 /** Functions for disk access for blocks */
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPoW = true);
+/**
+ * Read the block stored for pindex. Proof of work is re-checked unless
+ * fCheckPoW is false, which callers may only pass for blocks whose header was
+ * already validated when it was added to the index (the block hash is still
+ * compared against pindex). Callers reading by position with fCheckPoW false
+ * must compare the hash themselves.
+ */
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPoW = true);
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -6,6 +6,8 @@
 #include <validationinterface.h>
 
 #include <init.h>
+#include <masternode-payments.h>
+#include <spork.h>
 #include <primitives/block.h>
 #include <scheduler.h>
 #include <sync.h>
@@ -25,6 +27,9 @@ struct MainSignalsInstance {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
     boost::signals2::signal<void (const CTransactionRef &)> NotifyTransactionLock;
+    boost::signals2::signal<void (const COutPoint &, int nState)> NotifyMasternodeState;
+    boost::signals2::signal<void (const CMasternodePaymentVote &)> NotifyPaymentVote;
+    boost::signals2::signal<void (const CSporkMessage &)> NotifySpork;
     boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
     boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
     boost::signals2::signal<void (const CTransactionRef &)> TransactionRemovedFromMempool;
@@ -83,6 +88,9 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
     g_signals.m_internals->NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.m_internals->NotifyMasternodeState.connect(boost::bind(&CValidationInterface::NotifyMasternodeState, pwalletIn, _1, _2));
+    g_signals.m_internals->NotifyPaymentVote.connect(boost::bind(&CValidationInterface::NotifyPaymentVote, pwalletIn, _1));
+    g_signals.m_internals->NotifySpork.connect(boost::bind(&CValidationInterface::NotifySpork, pwalletIn, _1));
     g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
     g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
     g_signals.m_internals->TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
@@ -100,6 +108,9 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
     g_signals.m_internals->NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.m_internals->NotifyMasternodeState.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeState, pwalletIn, _1, _2));
+    g_signals.m_internals->NotifyPaymentVote.disconnect(boost::bind(&CValidationInterface::NotifyPaymentVote, pwalletIn, _1));
+    g_signals.m_internals->NotifySpork.disconnect(boost::bind(&CValidationInterface::NotifySpork, pwalletIn, _1));
     g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
     g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
     g_signals.m_internals->TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
@@ -119,6 +130,9 @@ void UnregisterAllValidationInterfaces() {
     g_signals.m_internals->SetBestChain.disconnect_all_slots();
     g_signals.m_internals->TransactionAddedToMempool.disconnect_all_slots();
     g_signals.m_internals->NotifyTransactionLock.disconnect_all_slots();
+    g_signals.m_internals->NotifyMasternodeState.disconnect_all_slots();
+    g_signals.m_internals->NotifyPaymentVote.disconnect_all_slots();
+    g_signals.m_internals->NotifySpork.disconnect_all_slots();
     g_signals.m_internals->BlockConnected.disconnect_all_slots();
     g_signals.m_internals->BlockDisconnected.disconnect_all_slots();
     g_signals.m_internals->TransactionRemovedFromMempool.disconnect_all_slots();
@@ -168,6 +182,24 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     });
 }
 
+void CMainSignals::NotifyMasternodeState(const COutPoint &outpoint, int nState) {
+    m_internals->m_schedulerClient.AddToProcessQueue([outpoint, nState, this] {
+        m_internals->NotifyMasternodeState(outpoint, nState);
+    });
+}
+
+void CMainSignals::NotifyPaymentVote(const CMasternodePaymentVote &vote) {
+    m_internals->m_schedulerClient.AddToProcessQueue([vote, this] {
+        m_internals->NotifyPaymentVote(vote);
+    });
+}
+
+void CMainSignals::NotifySpork(const CSporkMessage &spork) {
+    m_internals->m_schedulerClient.AddToProcessQueue([spork, this] {
+        m_internals->NotifySpork(spork);
+    });
+}
+
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
     m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
         m_internals->TransactionAddedToMempool(ptx);
@@ -16,6 +16,9 @@ class CBlockIndex;
 struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
+class CMasternodePaymentVote;
+class COutPoint;
+class CSporkMessage;
 class CReserveScript;
 class CValidationInterface;
 class CValidationState;
@@ -79,6 +82,25 @@ protected:
      * Called on a background thread.
      */
     virtual void NotifyTransactionLock(const CTransactionRef &ptx) {}
+    /**
+     * Notifies listeners of a masternode entering a new state (see
+     * CMasternode::StateToString), including when it is first added.
+     *
+     * Called on a background thread.
+     */
+    virtual void NotifyMasternodeState(const COutPoint &outpoint, int nState) {}
+    /**
+     * Notifies listeners of a new masternode payment vote.
+     *
+     * Called on a background thread.
+     */
+    virtual void NotifyPaymentVote(const CMasternodePaymentVote &vote) {}
+    /**
+     * Notifies listeners of a spork value being accepted.
+     *
+     * Called on a background thread.
+     */
+    virtual void NotifySpork(const CSporkMessage &spork) {}
     /**
      * Notifies listeners of a transaction having been added to mempool.
      *
@@ -170,6 +192,9 @@ public:
     void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload);
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *, bool fInitialDownload);
     void NotifyTransactionLock(const CTransactionRef &);
+    void NotifyMasternodeState(const COutPoint &, int nState);
+    void NotifyPaymentVote(const CMasternodePaymentVote &);
+    void NotifySpork(const CSporkMessage &);
     void TransactionAddedToMempool(const CTransactionRef &);
     void BlockConnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>> &);
     void BlockDisconnected(const std::shared_ptr<const CBlock> &);
@@ -10,7 +10,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 80002;
+static const int PROTOCOL_VERSION = 80003;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -43,4 +43,7 @@ static const int SHORT_IDS_BLOCKS_VERSION = 70001;
 //! not banning for invalid compact blocks starts with this version
 static const int INVALID_CB_NO_BAN_VERSION = 70002;
 
+//! cmpctblock headers may leave out Equihash solutions and auxpow the peer already has, starting with this version
+static const int COMPACT_HEADER_VERSION = 80003;
+
 #endif // BITCOIN_VERSION_H
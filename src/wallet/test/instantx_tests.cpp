@@ -0,0 +1,118 @@
+// Copyright (c) 2018 The Globaltoken Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <instantx.h>
+#include <validation.h>
+#include <validationinterface.h>
+#include <wallet/db.h>
+#include <wallet/wallet.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+/** Exposes lock candidates so that a lock can be completed without a masternode quorum */
+class CInstantSendTest : public CInstantSend
+{
+public:
+    void AddLockCandidate(const CTxLockRequest& txLockRequest, int nVotesPerOutpoint)
+    {
+        LOCK(cs_instantsend);
+        CTxLockCandidate txLockCandidate(txLockRequest);
+        for (const auto& txin : txLockRequest.tx->vin) {
+            txLockCandidate.AddOutPointLock(txin.prevout);
+            for (int i = 0; i < nVotesPerOutpoint; i++) {
+                COutPoint outpointMasternode(uint256S("0x01"), i);
+                txLockCandidate.AddVote(CTxLockVote(txLockRequest.GetHash(), txin.prevout, outpointMasternode));
+            }
+        }
+        mapTxLockCandidates.insert(std::make_pair(txLockRequest.GetHash(), txLockCandidate));
+    }
+
+    using CInstantSend::TryToFinalizeLockCandidate;
+};
+
+class InstantSendWalletSetup : public TestChain100Setup
+{
+public:
+    InstantSendWalletSetup()
+    {
+        ::bitdb.MakeMock();
+        g_address_type = OUTPUT_TYPE_DEFAULT;
+        g_change_type = OUTPUT_TYPE_DEFAULT;
+        wallet.reset(new CWallet(std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(&bitdb, "wallet_test.dat"))));
+        bool firstRun;
+        wallet->LoadWallet(firstRun);
+        {
+            LOCK(wallet->cs_wallet);
+            wallet->AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        }
+        RegisterValidationInterface(wallet.get());
+        wallet->NotifyTransactionChanged.connect([this](CWallet*, const uint256& hash, ChangeType status) {
+            if (status == CT_UPDATED) vNotified.push_back(hash);
+        });
+    }
+
+    ~InstantSendWalletSetup()
+    {
+        UnregisterValidationInterface(wallet.get());
+        wallet.reset();
+        ::bitdb.Flush(true);
+        ::bitdb.Reset();
+    }
+
+    /** A request spending the coinbase output of the given block back to the wallet */
+    CTxLockRequest CreateLockRequest(int nCoinbase)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(coinbaseTxns[nCoinbase].GetHash(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = coinbaseTxns[nCoinbase].vout[0].nValue - COIN / 100;
+        tx.vout[0].scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+        CTxLockRequest txLockRequest(tx);
+        BOOST_CHECK(wallet->AddToWallet(CWalletTx(wallet.get(), txLockRequest.tx)));
+        return txLockRequest;
+    }
+
+    std::unique_ptr<CWallet> wallet;
+    std::vector<uint256> vNotified;
+};
+
+BOOST_FIXTURE_TEST_SUITE(instantx_tests, InstantSendWalletSetup)
+
+BOOST_AUTO_TEST_CASE(lock_candidate_finalized_notifies_wallet)
+{
+    CInstantSendTest instantSendTest;
+    int nCompleteTXLocksBefore = nCompleteTXLocks;
+
+    // One vote short on the only outpoint: nothing is locked and nobody is told
+    CTxLockRequest txLockRequestShort = CreateLockRequest(0);
+    instantSendTest.AddLockCandidate(txLockRequestShort, COutPointLock::SIGNATURES_REQUIRED - 1);
+    instantSendTest.TryToFinalizeLockCandidate(txLockRequestShort.GetHash());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(!instantSendTest.IsLockedInstantSendTransaction(txLockRequestShort.GetHash()));
+    BOOST_CHECK(vNotified.empty());
+    BOOST_CHECK_EQUAL(nCompleteTXLocks, nCompleteTXLocksBefore);
+
+    // Enough votes: the inputs are locked and the wallet is notified once, off the finalizing thread
+    CTxLockRequest txLockRequest = CreateLockRequest(1);
+    instantSendTest.AddLockCandidate(txLockRequest, COutPointLock::SIGNATURES_REQUIRED);
+    instantSendTest.TryToFinalizeLockCandidate(txLockRequest.GetHash());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(instantSendTest.IsLockedInstantSendTransaction(txLockRequest.GetHash()));
+    uint256 hashLocked;
+    BOOST_CHECK(instantSendTest.GetLockedOutPointTxHash(txLockRequest.tx->vin[0].prevout, hashLocked));
+    BOOST_CHECK(hashLocked == txLockRequest.GetHash());
+    BOOST_CHECK_EQUAL(vNotified.size(), 1U);
+    BOOST_CHECK(vNotified[0] == txLockRequest.GetHash());
+    BOOST_CHECK_EQUAL(nCompleteTXLocks, nCompleteTXLocksBefore + 1);
+
+    // A completed lock is not finalized again
+    instantSendTest.TryToFinalizeLockCandidate(txLockRequest.GetHash());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(vNotified.size(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 
 #include <consensus/validation.h>
 #include <rpc/server.h>
+#include <script/interpreter.h>
 #include <test/test_bitcoin.h>
 #include <validation.h>
 #include <wallet/coincontrol.h>
@@ -445,6 +446,49 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+// Verify ScanForWalletTransactions works through more blocks than the rescan
+// pipeline prefetches, with several matching threads, while the caller holds
+// cs_main as importmulti and rescanblockchain do.
+BOOST_FIXTURE_TEST_CASE(rescan_multiple_blocks, TestChain100Setup)
+{
+    CBlockIndex* const nullBlock = nullptr;
+    gArgs.ForceSetArg("-rescanthreads", "4");
+
+    LOCK(cs_main);
+    BOOST_CHECK(coinbaseTxns.size() > RESCAN_PREFETCH_BLOCKS + 10);
+
+    // Stop short of the tip.
+    {
+        CWallet wallet;
+        AddKey(wallet, coinbaseKey);
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        CBlockIndex* const pindexStop = chainActive[(int)coinbaseTxns.size() - 10];
+        BOOST_CHECK_EQUAL(nullBlock, wallet.ScanForWalletTransactions(chainActive[1], pindexStop, reserver));
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(wallet.mapWallet.size(), (size_t)pindexStop->nHeight);
+        for (size_t i = 0; i < coinbaseTxns.size(); i++) {
+            BOOST_CHECK_EQUAL(wallet.mapWallet.count(coinbaseTxns[i].GetHash()), (int)i < pindexStop->nHeight ? 1U : 0U);
+        }
+    }
+
+    // Run up to the tip.
+    {
+        CWallet wallet;
+        AddKey(wallet, coinbaseKey);
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        BOOST_CHECK_EQUAL(nullBlock, wallet.ScanForWalletTransactions(chainActive[1], nullptr, reserver));
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(wallet.mapWallet.size(), coinbaseTxns.size());
+        for (const CTransaction& tx : coinbaseTxns) {
+            BOOST_CHECK_EQUAL(wallet.mapWallet.count(tx.GetHash()), 1U);
+        }
+    }
+
+    gArgs.ForceSetArg("-rescanthreads", std::to_string(DEFAULT_RESCAN_THREADS));
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
@@ -705,4 +749,220 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2);
 }
 
+/**
+ * Returns the coins AvailableCoins finds through the unspent transaction set
+ * as it was kept up to date, after checking them and the balance against a set
+ * rebuilt from the whole wallet.
+ */
+static std::set<COutPoint> CheckUnspentTxsAgainstFullScan(CWallet& wallet)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(vCoins);
+    CAmount nBalance = wallet.GetBalance();
+    std::set<COutPoint> setCoins;
+    for (const COutput& out : vCoins)
+        setCoins.insert(COutPoint(out.tx->GetHash(), out.i));
+
+    // MarkDirty makes the next query rebuild the set from mapWallet
+    wallet.MarkDirty();
+    std::vector<COutput> vCoinsFull;
+    wallet.AvailableCoins(vCoinsFull);
+    std::set<COutPoint> setCoinsFull;
+    for (const COutput& out : vCoinsFull)
+        setCoinsFull.insert(COutPoint(out.tx->GetHash(), out.i));
+
+    BOOST_CHECK(setCoins == setCoinsFull);
+    BOOST_CHECK_EQUAL(nBalance, wallet.GetBalance());
+    return setCoins;
+}
+
+/** Adds an unconfirmed transaction spending only the given coin, without relaying it */
+static CWalletTx AddUnconfirmedSpend(CWallet& wallet, const COutPoint& outpoint)
+{
+    CCoinControl coin_control;
+    coin_control.fAllowOtherInputs = false;
+    coin_control.Select(outpoint);
+    CWalletTx wtx;
+    CReserveKey reservekey(&wallet);
+    CAmount fee;
+    int changePos = -1;
+    std::string error;
+    BOOST_CHECK(wallet.CreateTransaction({CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */}}, wtx, reservekey, fee, changePos, error, coin_control));
+    BOOST_CHECK(wallet.AddToWallet(wtx));
+    return wtx;
+}
+
+BOOST_FIXTURE_TEST_CASE(UnspentTxsFollowWalletEvents, ListCoinsTestingSetup)
+{
+    const COutPoint coinbase0(coinbaseTxns[0].GetHash(), 0);
+    const COutPoint coinbase1(coinbaseTxns[1].GetHash(), 0);
+
+    std::set<COutPoint> setCoins = CheckUnspentTxsAgainstFullScan(*wallet);
+    BOOST_CHECK_EQUAL(setCoins.size(), 1U);
+    BOOST_CHECK(setCoins.count(coinbase0));
+
+    // Spending the mature coinbase leaves its change; the new block matures the next coinbase
+    const CWalletTx& wtxSpend = AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    setCoins = CheckUnspentTxsAgainstFullScan(*wallet);
+    BOOST_CHECK(!setCoins.count(coinbase0));
+    BOOST_CHECK(setCoins.count(coinbase1));
+    BOOST_CHECK_EQUAL(setCoins.size(), 2U);
+    BOOST_CHECK(setCoins.count(COutPoint(wtxSpend.GetHash(), 0)) || setCoins.count(COutPoint(wtxSpend.GetHash(), 1)));
+
+    // An unconfirmed spend hides the coin until it is abandoned
+    CWalletTx wtxAbandoned = AddUnconfirmedSpend(*wallet, coinbase1);
+    setCoins = CheckUnspentTxsAgainstFullScan(*wallet);
+    BOOST_CHECK(!setCoins.count(coinbase1));
+    BOOST_CHECK(wallet->AbandonTransaction(wtxAbandoned.GetHash()));
+    setCoins = CheckUnspentTxsAgainstFullScan(*wallet);
+    BOOST_CHECK(setCoins.count(coinbase1));
+
+    // A block spending the same coin elsewhere conflicts the unconfirmed spend
+    CWalletTx wtxConflicted = AddUnconfirmedSpend(*wallet, coinbase1);
+    CMutableTransaction txDoubleSpend;
+    txDoubleSpend.vin.resize(1);
+    txDoubleSpend.vin[0].prevout = coinbase1;
+    txDoubleSpend.vout.resize(1);
+    txDoubleSpend.vout[0].nValue = coinbaseTxns[1].vout[0].nValue - COIN / 100;
+    txDoubleSpend.vout[0].scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(coinbaseTxns[1].vout[0].scriptPubKey, txDoubleSpend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    txDoubleSpend.vin[0].scriptSig << vchSig;
+    const COutPoint outpointDoubleSpend(txDoubleSpend.GetHash(), 0);
+
+    std::shared_ptr<const CBlock> pblock = std::make_shared<const CBlock>(CreateAndProcessBlock({txDoubleSpend}, GetScriptForRawPubKey(coinbaseKey.GetPubKey())));
+    wallet->BlockConnected(pblock, chainActive.Tip(), {});
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        BOOST_CHECK(wallet->mapWallet.at(wtxConflicted.GetHash()).GetDepthInMainChain() < 0);
+    }
+    setCoins = CheckUnspentTxsAgainstFullScan(*wallet);
+    BOOST_CHECK(!setCoins.count(coinbase1));
+    BOOST_CHECK(setCoins.count(outpointDoubleSpend));
+
+    // Disconnecting that block takes its output away again
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+    }
+    wallet->BlockDisconnected(pblock);
+    setCoins = CheckUnspentTxsAgainstFullScan(*wallet);
+    BOOST_CHECK(!setCoins.count(outpointDoubleSpend));
+    BOOST_CHECK(!setCoins.count(coinbase1));
+}
+
+/** Collateral-sized coins AvailableCoins returns for the given coin type */
+static std::set<COutPoint> AvailableCollaterals(CWallet& wallet, AvailableCoinsType nCoinType)
+{
+    const CAmount nCollateral = Params().GetConsensus().nMasternodeColleteralPaymentAmount * COIN;
+    LOCK2(cs_main, wallet.cs_wallet);
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(vCoins, true, nullptr, nCollateral, nCollateral, MAX_MONEY, 0, 0, 9999999, nCoinType);
+    std::set<COutPoint> setCoins;
+    for (const COutput& out : vCoins)
+        setCoins.insert(COutPoint(out.tx->GetHash(), out.i));
+    return setCoins;
+}
+
+/** Adds a transaction paying the given amounts to scriptPubKey, confirmed in the tip */
+static uint256 AddConfirmedTx(CWallet& wallet, const COutPoint& prevout, const std::vector<CAmount>& vValues, const CScript& scriptPubKey)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    for (const CAmount& nValue : vValues)
+        tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+    CWalletTx wtx(&wallet, MakeTransactionRef(tx));
+    {
+        LOCK(cs_main);
+        wtx.hashBlock = chainActive.Tip()->GetBlockHash();
+        wtx.nIndex = 1;
+    }
+    BOOST_CHECK(wallet.AddToWallet(wtx));
+    return wtx.GetHash();
+}
+
+BOOST_FIXTURE_TEST_CASE(CollateralOutputsFollowLocksAndSpends, ListCoinsTestingSetup)
+{
+    const CAmount nCollateral = Params().GetConsensus().nMasternodeColleteralPaymentAmount * COIN;
+    const CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK(wallet->GetCollateralOutputs().empty());
+    }
+
+    // Two collateral outputs and one that is not
+    const uint256 hashA = AddConfirmedTx(*wallet, COutPoint(uint256S("0x01"), 0), {nCollateral, nCollateral, 1 * COIN}, scriptPubKey);
+    const COutPoint a0(hashA, 0), a1(hashA, 1);
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK_EQUAL(wallet->GetCollateralOutputs().size(), 2U);
+        BOOST_CHECK(!wallet->GetCollateralOutputs().at(a0));
+        BOOST_CHECK(!wallet->GetCollateralOutputs().at(a1));
+    }
+    // With nothing locked, the index returns what a scan of all coins of that amount does
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == AvailableCollaterals(*wallet, ALL_COINS));
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == std::set<COutPoint>({a0, a1}));
+
+    // Locked collaterals stay listed for masternodes but not for spending
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->LockCoin(a0);
+        BOOST_CHECK(wallet->GetCollateralOutputs().at(a0));
+        BOOST_CHECK(!wallet->GetCollateralOutputs().at(a1));
+        // A rebuild picks the lock state up from setLockedCoins
+        wallet->MarkDirty();
+        BOOST_CHECK(wallet->GetCollateralOutputs().at(a0));
+    }
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == std::set<COutPoint>({a0, a1}));
+    BOOST_CHECK(AvailableCollaterals(*wallet, ALL_COINS) == std::set<COutPoint>({a1}));
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockCoin(a0);
+        BOOST_CHECK(!wallet->GetCollateralOutputs().at(a0));
+        wallet->LockCoin(a0);
+        wallet->LockCoin(a1);
+        wallet->UnlockAllCoins();
+        BOOST_CHECK(!wallet->GetCollateralOutputs().at(a0));
+        BOOST_CHECK(!wallet->GetCollateralOutputs().at(a1));
+    }
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == AvailableCollaterals(*wallet, ALL_COINS));
+
+    // A coin locked before its transaction arrives is indexed as locked
+    CMutableTransaction txB;
+    txB.vin.resize(1);
+    txB.vin[0].prevout = COutPoint(uint256S("0x02"), 0);
+    txB.vout.push_back(CTxOut(nCollateral, scriptPubKey));
+    const COutPoint b0(txB.GetHash(), 0);
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->LockCoin(b0);
+    }
+    BOOST_CHECK(AddConfirmedTx(*wallet, txB.vin[0].prevout, {nCollateral}, scriptPubKey) == b0.hash);
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK(wallet->GetCollateralOutputs().at(b0));
+    }
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == std::set<COutPoint>({a0, a1, b0}));
+    BOOST_CHECK(AvailableCollaterals(*wallet, ALL_COINS) == std::set<COutPoint>({a0, a1}));
+
+    // Spent collaterals are no longer returned, although their transaction still holds an unspent output
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(a0));
+    txSpend.vin.push_back(CTxIn(a1));
+    txSpend.vout.push_back(CTxOut(2 * nCollateral - COIN, CScript() << OP_TRUE));
+    BOOST_CHECK(wallet->AddToWallet(CWalletTx(wallet.get(), MakeTransactionRef(txSpend))));
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == std::set<COutPoint>({b0}));
+    BOOST_CHECK(AvailableCollaterals(*wallet, ALL_COINS).empty());
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockAllCoins();
+    }
+    BOOST_CHECK(AvailableCollaterals(*wallet, ONLY_COLLATERAL) == AvailableCollaterals(*wallet, ALL_COINS));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
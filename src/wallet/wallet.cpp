@@ -36,7 +36,11 @@
 #include <spork.h>
 
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <mutex>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -588,6 +592,90 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+bool CWallet::HasUnspentOutputs(const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_wallet);
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) != ISMINE_NO && !IsSpent(hash, i))
+            return true;
+    }
+    return false;
+}
+
+void CWallet::AddCollateralOutputs(const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_wallet);
+    const CAmount nCollateral = Params().GetConsensus().nMasternodeColleteralPaymentAmount * COIN;
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        const CTxOut& txout = wtx.tx->vout[i];
+        if (txout.nValue != nCollateral || IsMine(txout) == ISMINE_NO)
+            continue;
+        COutPoint outpoint(wtx.GetHash(), i);
+        mapCollateralOutputs[outpoint] = setLockedCoins.count(outpoint) > 0;
+    }
+}
+
+void CWallet::RemoveCollateralOutputs(const uint256& hash) const
+{
+    AssertLockHeld(cs_wallet);
+    auto it = mapCollateralOutputs.lower_bound(COutPoint(hash, 0));
+    while (it != mapCollateralOutputs.end() && it->first.hash == hash)
+        it = mapCollateralOutputs.erase(it);
+}
+
+/**
+ * Called whenever a transaction is added or updated: it may bring new
+ * outputs of ours and may spend outputs of transactions already tracked.
+ */
+void CWallet::UpdateUnspentTxs(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (fUnspentTxsDirty)
+        return;
+
+    if (HasUnspentOutputs(wtx)) {
+        if (setUnspentTxs.insert(wtx.GetHash()).second)
+            AddCollateralOutputs(wtx);
+    } else if (setUnspentTxs.erase(wtx.GetHash())) {
+        RemoveCollateralOutputs(wtx.GetHash());
+    }
+
+    for (const CTxIn& txin : wtx.tx->vin) {
+        if (!setUnspentTxs.count(txin.prevout.hash))
+            continue;
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it == mapWallet.end() || !HasUnspentOutputs(it->second)) {
+            setUnspentTxs.erase(txin.prevout.hash);
+            RemoveCollateralOutputs(txin.prevout.hash);
+        }
+    }
+}
+
+const std::set<uint256>& CWallet::GetUnspentTxs() const
+{
+    AssertLockHeld(cs_wallet);
+    if (fUnspentTxsDirty) {
+        setUnspentTxs.clear();
+        mapCollateralOutputs.clear();
+        for (const auto& entry : mapWallet) {
+            if (HasUnspentOutputs(entry.second)) {
+                setUnspentTxs.insert(setUnspentTxs.end(), entry.first);
+                AddCollateralOutputs(entry.second);
+            }
+        }
+        fUnspentTxsDirty = false;
+        LogPrint(BCLog::BENCH, "%s: %u of %u wallet transactions hold unspent outputs, %u collateral outputs\n", __func__, setUnspentTxs.size(), mapWallet.size(), mapCollateralOutputs.size());
+    }
+    return setUnspentTxs;
+}
+
+const std::map<COutPoint, bool>& CWallet::GetCollateralOutputs() const
+{
+    GetUnspentTxs();
+    return mapCollateralOutputs;
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
@@ -870,6 +958,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        fUnspentTxsDirty = true;
     }
 }
 
@@ -970,6 +1059,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    UpdateUnspentTxs(wtx);
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1104,6 +1194,8 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
     }
 
     todo.insert(hashTx);
+    // Outputs spent by the transactions below become spendable again
+    fUnspentTxsDirty = true;
 
     while (!todo.empty()) {
         uint256 now = *todo.begin();
@@ -1172,6 +1264,8 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
     std::set<uint256> done;
 
     todo.insert(hashTx);
+    // Outputs spent by the transactions below become spendable again
+    fUnspentTxsDirty = true;
 
     while (!todo.empty()) {
         uint256 now = *todo.begin();
@@ -1243,6 +1337,27 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     }
 }
 
+void CWallet::NotifyTransactionLock(const CTransactionRef &ptx) {
+    {
+        LOCK(cs_wallet);
+        // Only notify UI if this transaction is in this wallet
+        if (!mapWallet.count(ptx->GetHash()))
+            return;
+        NotifyTransactionChanged(this, ptx->GetHash(), CT_UPDATED);
+    }
+
+    // bumping this to update UI
+    nCompleteTXLocks++;
+
+    // notify an external script once threshold is reached
+    std::string strCmd = gArgs.GetArg("-instantsendnotify", "");
+    if (!strCmd.empty()) {
+        boost::replace_all(strCmd, "%s", ptx->GetHash().GetHex());
+        std::thread t(runCommand, strCmd);
+        t.detach(); // thread runs free
+    }
+}
+
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     LOCK2(cs_main, cs_wallet);
     // TODO: Temporarily ensure that mempool removals are notified before
@@ -1271,6 +1386,7 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx);
     }
+    fUnspentTxsDirty = true;
 }
 
 
@@ -1633,6 +1749,161 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+namespace {
+
+/** Where to find a block to rescan, recorded under cs_main */
+struct CRescanBlockPos
+{
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    uint256 hash;
+
+    CRescanBlockPos(CBlockIndex* pindexIn, const CDiskBlockPos& posIn, const uint256& hashIn) : pindex(pindexIn), pos(posIn), hash(hashIn) {}
+};
+
+/** A block travelling through the rescan pipeline */
+struct CRescanBlock
+{
+    CBlockIndex* const pindex;
+    CBlock block;
+    bool fRead;
+    bool fMatched;
+    //! Key epoch at the time the outputs were matched
+    uint64_t nKeyEpoch;
+    //! Per transaction: pays to one of our scripts
+    std::vector<bool> vIsMine;
+
+    explicit CRescanBlock(CBlockIndex* pindexIn) : pindex(pindexIn), fRead(false), fMatched(false), nKeyEpoch(0) {}
+};
+
+/**
+ * Rescan pipeline. A reader thread prefetches the given blocks, worker
+ * threads match their outputs against the wallet keystore (IsMine only
+ * needs the keystore lock), and the caller takes the blocks back in chain
+ * order to commit the matches under cs_main and cs_wallet.
+ *
+ * The threads never take cs_main, so the caller may hold it: the block list,
+ * with each block's disk position and hash, is recorded under cs_main up
+ * front, and whether a block is still active is checked when it is committed.
+ * Blocks come off disk by position without re-checking proof of work: they
+ * were on the active chain and their hash is compared against the recorded one.
+ */
+class CRescanPipeline
+{
+public:
+    CRescanPipeline(const CWallet& walletIn, std::vector<CRescanBlockPos>&& vBlocksIn, int nWorkers)
+        : wallet(walletIn), vBlocks(std::move(vBlocksIn)), fReadDone(false), fStop(false), nKeyEpoch(0)
+    {
+        threads.emplace_back(&CRescanPipeline::ThreadRead, this);
+        for (int i = 0; i < nWorkers; i++)
+            threads.emplace_back(&CRescanPipeline::ThreadMatch, this);
+    }
+
+    ~CRescanPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& t : threads)
+            t.join();
+    }
+
+    /** Next block in chain order once it has been matched, nullptr at the end of the scan */
+    std::shared_ptr<CRescanBlock> Next()
+    {
+        std::shared_ptr<CRescanBlock> blk;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [this] { return queueCommit.empty() ? fReadDone : queueCommit.front()->fMatched; });
+            if (queueCommit.empty())
+                return nullptr;
+            blk = queueCommit.front();
+            queueCommit.pop_front();
+        }
+        cond.notify_all();
+        return blk;
+    }
+
+    /** Keys were added to the wallet: blocks matched before now must be matched again */
+    void BumpKeyEpoch() { ++nKeyEpoch; }
+    uint64_t GetKeyEpoch() const { return nKeyEpoch; }
+
+private:
+    void ThreadRead()
+    {
+        RenameThread("globaltoken-rescanrd");
+        for (const CRescanBlockPos& blockPos : vBlocks) {
+            std::shared_ptr<CRescanBlock> blk = std::make_shared<CRescanBlock>(blockPos.pindex);
+            blk->fRead = ReadBlockFromDisk(blk->block, blockPos.pos, Params().GetConsensus(), false);
+            if (blk->fRead && blk->block.GetHash() != blockPos.hash) {
+                blk->fRead = error("%s: GetHash() doesn't match index for %s at %s", __func__, blockPos.hash.ToString(), blockPos.pos.ToString());
+            }
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                cond.wait(lock, [this] { return fStop || queueCommit.size() < RESCAN_PREFETCH_BLOCKS; });
+                if (fStop)
+                    break;
+                queueCommit.push_back(blk);
+                if (blk->fRead)
+                    queueMatch.push_back(blk);
+                else
+                    blk->fMatched = true;
+            }
+            cond.notify_all();
+        }
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fReadDone = true;
+        }
+        cond.notify_all();
+    }
+
+    void ThreadMatch()
+    {
+        RenameThread("globaltoken-rescan");
+        while (true) {
+            std::shared_ptr<CRescanBlock> blk;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                cond.wait(lock, [this] { return fStop || fReadDone || !queueMatch.empty(); });
+                if (fStop || queueMatch.empty())
+                    return;
+                blk = queueMatch.front();
+                queueMatch.pop_front();
+            }
+            blk->nKeyEpoch = nKeyEpoch;
+            blk->vIsMine.resize(blk->block.vtx.size());
+            for (size_t i = 0; i < blk->block.vtx.size(); i++)
+                blk->vIsMine[i] = wallet.IsMine(*blk->block.vtx[i]);
+            {
+                std::lock_guard<std::mutex> lock(cs);
+                blk->fMatched = true;
+            }
+            cond.notify_all();
+        }
+    }
+
+    const CWallet& wallet;
+    //! Blocks to scan, in chain order
+    const std::vector<CRescanBlockPos> vBlocks;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Prefetched blocks in chain order, waiting to be committed
+    std::deque<std::shared_ptr<CRescanBlock>> queueCommit;
+    //! Prefetched blocks waiting for a worker
+    std::deque<std::shared_ptr<CRescanBlock>> queueMatch;
+    bool fReadDone;
+    bool fStop;
+
+    std::atomic<uint64_t> nKeyEpoch;
+    std::vector<std::thread> threads;
+};
+
+} // namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1643,7 +1914,7 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
  * block that could not be scanned.
  *
  * If pindexStop is not a nullptr, the scan will stop at the block-index
- * defined by pindexStop
+ * defined by pindexStop, otherwise at the tip when the scan started
  *
  * Caller needs to make sure pindexStop (and the optional pindexStart) are on
  * the main chain after to the addition of any new keys you want to detect
@@ -1659,6 +1930,11 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
         assert(pindexStop->nHeight >= pindexStart->nHeight);
     }
 
+    int nWorkers = gArgs.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if (nWorkers <= 0)
+        nWorkers = GetNumCores();
+    nWorkers = std::max(1, std::min(nWorkers, MAX_RESCAN_THREADS));
+
     CBlockIndex* pindex = pindexStart;
     CBlockIndex* ret = nullptr;
     {
@@ -1667,15 +1943,24 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
         CBlockIndex* tip = nullptr;
         double dProgressStart;
         double dProgressTip;
+        std::vector<CRescanBlockPos> vBlocks;
         {
             LOCK(cs_main);
             tip = chainActive.Tip();
             dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
             dProgressTip = GuessVerificationProgress(chainParams.TxData(), tip);
+            for (CBlockIndex* pindexScan = pindexStart; pindexScan; pindexScan = chainActive.Next(pindexScan)) {
+                vBlocks.emplace_back(pindexScan, pindexScan->GetBlockPos(), pindexScan->GetBlockHash());
+                if (pindexScan == pindexStop)
+                    break;
+            }
         }
         double gvp = dProgressStart;
-        while (pindex && !fAbortRescan)
+        CRescanPipeline pipeline(*this, std::move(vBlocks), nWorkers);
+        std::shared_ptr<CRescanBlock> blk;
+        while (!fAbortRescan && (blk = pipeline.Next()))
         {
+            pindex = blk->pindex;
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((gvp - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
             }
@@ -1684,28 +1969,40 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, gvp);
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            if (blk->fRead) {
                 LOCK2(cs_main, cs_wallet);
-                if (pindex && !chainActive.Contains(pindex)) {
+                if (!chainActive.Contains(pindex)) {
                     // Abort scan if current block is no longer active, to prevent
                     // marking transactions as coming from the wrong block.
                     ret = pindex;
                     break;
                 }
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                // Keys added while the block was being matched (keypool top-ups
+                // after a used key was found) invalidate the worker's result
+                bool fRematch = blk->nKeyEpoch != pipeline.GetKeyEpoch();
+                for (size_t posInBlock = 0; posInBlock < blk->block.vtx.size(); ++posInBlock) {
+                    const CTransactionRef& ptx = blk->block.vtx[posInBlock];
+                    bool fCandidate = fRematch || blk->vIsMine[posInBlock] || mapWallet.count(ptx->GetHash());
+                    // Spends of our outputs, or conflicts with our spends
+                    for (size_t i = 0; !fCandidate && i < ptx->vin.size(); i++) {
+                        const COutPoint& prevout = ptx->vin[i].prevout;
+                        fCandidate = mapWallet.count(prevout.hash) || mapTxSpends.count(prevout);
+                    }
+                    if (!fCandidate)
+                        continue;
+                    const int64_t nMaxKeypoolIndex = m_max_keypool_index;
+                    AddToWalletIfInvolvingMe(ptx, pindex, posInBlock, fUpdate);
+                    if (m_max_keypool_index != nMaxKeypoolIndex) {
+                        pipeline.BumpKeyEpoch();
+                        fRematch = true;
+                    }
                 }
             } else {
                 ret = pindex;
             }
-            if (pindex == pindexStop) {
-                break;
-            }
             {
                 LOCK(cs_main);
-                pindex = chainActive.Next(pindex);
-                gvp = GuessVerificationProgress(chainParams.TxData(), pindex);
+                gvp = GuessVerificationProgress(chainParams.TxData(), chainActive.Next(pindex));
                 if (tip != chainActive.Tip()) {
                     tip = chainActive.Tip();
                     // in case the tip has changed, update progress max
@@ -2058,9 +2355,9 @@ CAmount CWallet::GetBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const uint256& hash : GetUnspentTxs())
         {
-            const CWalletTx* pcoin = &entry.second;
+            const CWalletTx* pcoin = &mapWallet.at(hash);
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -2074,9 +2371,9 @@ CAmount CWallet::GetUnconfirmedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const uint256& hash : GetUnspentTxs())
         {
-            const CWalletTx* pcoin = &entry.second;
+            const CWalletTx* pcoin = &mapWallet.at(hash);
             if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -2089,9 +2386,9 @@ CAmount CWallet::GetImmatureBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const uint256& hash : GetUnspentTxs())
         {
-            const CWalletTx* pcoin = &entry.second;
+            const CWalletTx* pcoin = &mapWallet.at(hash);
             nTotal += pcoin->GetImmatureCredit();
         }
     }
@@ -2103,9 +2400,9 @@ CAmount CWallet::GetWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const uint256& hash : GetUnspentTxs())
         {
-            const CWalletTx* pcoin = &entry.second;
+            const CWalletTx* pcoin = &mapWallet.at(hash);
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -2119,9 +2416,9 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const uint256& hash : GetUnspentTxs())
         {
-            const CWalletTx* pcoin = &entry.second;
+            const CWalletTx* pcoin = &mapWallet.at(hash);
             if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -2134,9 +2431,9 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const uint256& hash : GetUnspentTxs())
         {
-            const CWalletTx* pcoin = &entry.second;
+            const CWalletTx* pcoin = &mapWallet.at(hash);
             nTotal += pcoin->GetImmatureWatchOnlyCredit();
         }
     }
@@ -2211,10 +2508,16 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
     
     int nInstantSendConfirmationsRequired = Params().GetConsensus().nInstantSendConfirmationsRequired;
 
-    for (const auto& entry : mapWallet)
+    // Collateral lookups only need the transactions holding a collateral output
+    std::set<uint256> setCollateralTxs;
+    if (nCoinType == ONLY_COLLATERAL) {
+        for (const auto& collateral : GetCollateralOutputs())
+            setCollateralTxs.insert(collateral.first.hash);
+    }
+
+    for (const uint256& wtxid : nCoinType == ONLY_COLLATERAL ? setCollateralTxs : GetUnspentTxs())
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx* pcoin = &entry.second;
+        const CWalletTx* pcoin = &mapWallet.at(wtxid);
 
         if (!CheckFinalTx(*pcoin->tx))
             continue;
@@ -2288,10 +2591,10 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
             if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            if (IsLockedCoin(entry.first, i) && nCoinType != ONLY_COLLATERAL)
+            if (IsLockedCoin(wtxid, i) && nCoinType != ONLY_COLLATERAL)
                 continue;
 
             if (IsSpent(wtxid, i))
@@ -3205,6 +3508,7 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     DBErrors nZapSelectTxRet = CWalletDB(*dbw,"cr+").ZapSelectTx(vHashIn, vHashOut);
     for (uint256 hash : vHashOut)
         mapWallet.erase(hash);
+    fUnspentTxsDirty = true;
 
     if (nZapSelectTxRet == DB_NEED_REWRITE)
     {
@@ -3679,6 +3983,12 @@ bool CWallet::GetMasternodeOutpointAndKeys(COutPoint& outpointRet, CPubKey& pubK
     // wait for reindex and/or import to finish
     if (fImporting || fReindex) return false;
 
+    // Specific outpoint requested but it is not one of our collateral outputs
+    if (!strTxHash.empty() && !GetCollateralOutputs().count(COutPoint(uint256S(strTxHash), atoi(strOutputIndex)))) {
+        LogPrintf("CWallet::GetMasternodeOutpointAndKeys -- Could not locate specified masternode vin\n");
+        return false;
+    }
+
     // Find possible candidates
     std::vector<COutput> vPossibleCoins;
     AvailableCoins(vPossibleCoins, true, nullptr, 1, MAX_MONEY, MAX_MONEY, 0, 0, 9999999, ONLY_COLLATERAL, false);
@@ -3815,18 +4125,26 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    auto it = mapCollateralOutputs.find(output);
+    if (it != mapCollateralOutputs.end())
+        it->second = true;
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    auto it = mapCollateralOutputs.find(output);
+    if (it != mapCollateralOutputs.end())
+        it->second = false;
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    for (auto& collateral : mapCollateralOutputs)
+        collateral.second = false;
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -67,6 +67,12 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -rescanthreads default (number of rescan matching threads, 0 = auto)
+static const int DEFAULT_RESCAN_THREADS = 0;
+//! Maximum number of rescan matching threads
+static const int MAX_RESCAN_THREADS = 16;
+//! Number of blocks the rescan reader may prefetch ahead of the committed block
+static const unsigned int RESCAN_PREFETCH_BLOCKS = 64;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -721,6 +727,31 @@ private:
      */
     const CBlockIndex* m_last_block_processed;
 
+    /**
+     * Transactions that may still hold unspent outputs of ours. Balance
+     * queries and AvailableCoins walk only these instead of the whole wallet
+     * history. A transaction is dropped once every output of ours is spent;
+     * since spends can only come back through conflicts, abandonment or
+     * disconnected blocks, those events mark the set for a full rebuild on
+     * the next query. Protected by cs_wallet.
+     */
+    mutable std::set<uint256> setUnspentTxs;
+    mutable bool fUnspentTxsDirty;
+
+    /**
+     * Outputs of ours paying exactly the masternode collateral amount, kept
+     * alongside setUnspentTxs and mapped to their setLockedCoins state.
+     * Entries go away together with their transaction, so individual
+     * outputs may already be spent. Protected by cs_wallet.
+     */
+    mutable std::map<COutPoint, bool> mapCollateralOutputs;
+
+    bool HasUnspentOutputs(const CWalletTx& wtx) const;
+    void AddCollateralOutputs(const CWalletTx& wtx) const;
+    void RemoveCollateralOutputs(const uint256& hash) const;
+    void UpdateUnspentTxs(const CWalletTx& wtx);
+    const std::set<uint256>& GetUnspentTxs() const;
+
 public:
     /*
      * Main wallet lock.
@@ -793,6 +824,7 @@ public:
         nRelockTime = 0;
         fAbortRescan = false;
         fScanningWallet = false;
+        fUnspentTxsDirty = true;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -850,6 +882,8 @@ public:
     void UnlockCoin(const COutPoint& output);
     void UnlockAllCoins();
     void ListLockedCoins(std::vector<COutPoint>& vOutpts) const;
+    /** Masternode collateral outputs of this wallet and whether they are locked */
+    const std::map<COutPoint, bool>& GetCollateralOutputs() const;
 
     /*
      * Rescan abort properties
@@ -928,6 +962,7 @@ public:
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, CBlockIndex* pindexStop, const WalletRescanReserver& reserver, bool fUpdate = false);
     void TransactionRemovedFromMempool(const CTransactionRef &ptx) override;
+    void NotifyTransactionLock(const CTransactionRef &ptx) override;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
@@ -24,4 +24,18 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransactionRef &/*transaction*/)
 {
     return true;
-}
\ No newline at end of file
+}
+bool CZMQAbstractNotifier::NotifyMasternodeState(const COutPoint &/*outpoint*/, int /*nState*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyPaymentVote(const CMasternodePaymentVote &/*vote*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifySpork(const CSporkMessage &/*spork*/)
+{
+    return true;
+}
@@ -8,6 +8,9 @@
 #include <zmq/zmqconfig.h>
 
 class CBlockIndex;
+class CMasternodePaymentVote;
+class COutPoint;
+class CSporkMessage;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -35,6 +38,9 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransactionRef &transaction);
+    virtual bool NotifyMasternodeState(const COutPoint &outpoint, int nState);
+    virtual bool NotifyPaymentVote(const CMasternodePaymentVote &vote);
+    virtual bool NotifySpork(const CSporkMessage &spork);
 
 protected:
     void *psocket;
@@ -5,6 +5,8 @@
 #include <zmq/zmqnotificationinterface.h>
 #include <zmq/zmqpublishnotifier.h>
 
+#include <masternode-payments.h>
+#include <spork.h>
 #include <version.h>
 #include <validation.h>
 #include <streams.h>
@@ -15,7 +17,7 @@ void zmqError(const char *str)
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr), fStopPublishing(false), nDropped(0)
 {
 }
 
@@ -36,11 +38,15 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     std::list<CZMQAbstractNotifier*> notifiers;
 
     factories["pubhashblock"] = CZMQAbstractNotifier::Create<CZMQPublishHashBlockNotifier>;
+    factories["pubhashblockalgo"] = CZMQAbstractNotifier::Create<CZMQPublishHashBlockAlgoNotifier>;
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubhashtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionLockNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubmasternodestate"] = CZMQAbstractNotifier::Create<CZMQPublishMasternodeStateNotifier>;
+    factories["pubpaymentvote"] = CZMQAbstractNotifier::Create<CZMQPublishPaymentVoteNotifier>;
+    factories["pubspork"] = CZMQAbstractNotifier::Create<CZMQPublishSporkNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -105,6 +111,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    threadPublish = std::thread(&TraceThread<std::function<void ()> >, "zmqpub", std::function<void ()>(std::bind(&CZMQNotificationInterface::ThreadPublish, this)));
+
     return true;
 }
 
@@ -112,6 +120,15 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
+    if (threadPublish.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs_queue);
+            fStopPublishing = true;
+        }
+        cond_queue.notify_one();
+        threadPublish.join();
+    }
     if (pcontext)
     {
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
@@ -126,36 +143,43 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CZMQNotificationInterface::Enqueue(std::function<void ()> func)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
-
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
-        {
-            i++;
+        std::lock_guard<std::mutex> lock(cs_queue);
+        if (queue.size() >= MAX_ZMQ_QUEUE_SIZE) {
+            if (nDropped++ % 1000 == 0)
+                LogPrint(BCLog::ZMQ, "zmq: Publishing queue full, %u notifications dropped\n", nDropped);
+            return;
         }
-        else
+        queue.push_back(std::move(func));
+    }
+    cond_queue.notify_one();
+}
+
+void CZMQNotificationInterface::ThreadPublish()
+{
+    while (true) {
+        std::function<void ()> func;
         {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            std::unique_lock<std::mutex> lock(cs_queue);
+            cond_queue.wait(lock, [this]{ return fStopPublishing || !queue.empty(); });
+            // Whatever is still queued at shutdown is published before exiting
+            if (queue.empty())
+                break;
+            func = std::move(queue.front());
+            queue.pop_front();
         }
+        func();
     }
 }
 
-void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+void CZMQNotificationInterface::ForEachNotifier(const std::function<bool (CZMQAbstractNotifier*)>& func)
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
-    // all the same external callback.
-    const CTransaction& tx = *ptx;
-
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        if (func(notifier))
         {
             i++;
         }
@@ -167,6 +191,25 @@ void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef&
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    Enqueue([this, pindexNew] {
+        ForEachNotifier([pindexNew](CZMQAbstractNotifier* notifier) { return notifier->NotifyBlock(pindexNew); });
+    });
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    // Used by BlockConnected and BlockDisconnected as well, because they're
+    // all the same external callback.
+    Enqueue([this, ptx] {
+        ForEachNotifier([&ptx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransaction(*ptx); });
+    });
+}
+
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
@@ -185,17 +228,28 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransactionRef &ptx)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransactionLock(ptx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    Enqueue([this, ptx] {
+        ForEachNotifier([&ptx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransactionLock(ptx); });
+    });
+}
+
+void CZMQNotificationInterface::NotifyMasternodeState(const COutPoint &outpoint, int nState)
+{
+    Enqueue([this, outpoint, nState] {
+        ForEachNotifier([&](CZMQAbstractNotifier* notifier) { return notifier->NotifyMasternodeState(outpoint, nState); });
+    });
+}
+
+void CZMQNotificationInterface::NotifyPaymentVote(const CMasternodePaymentVote &vote)
+{
+    Enqueue([this, vote] {
+        ForEachNotifier([&vote](CZMQAbstractNotifier* notifier) { return notifier->NotifyPaymentVote(vote); });
+    });
+}
+
+void CZMQNotificationInterface::NotifySpork(const CSporkMessage &spork)
+{
+    Enqueue([this, spork] {
+        ForEachNotifier([&spork](CZMQAbstractNotifier* notifier) { return notifier->NotifySpork(spork); });
+    });
 }
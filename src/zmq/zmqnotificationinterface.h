@@ -6,13 +6,21 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include <validationinterface.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <string>
 #include <map>
 #include <list>
+#include <mutex>
+#include <thread>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Notifications waiting for the publishing thread beyond this are dropped */
+static const size_t MAX_ZMQ_QUEUE_SIZE = 10000;
+
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -30,12 +38,30 @@ protected:
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     void NotifyTransactionLock(const CTransactionRef &ptx) override;
+    void NotifyMasternodeState(const COutPoint &outpoint, int nState) override;
+    void NotifyPaymentVote(const CMasternodePaymentVote &vote) override;
+    void NotifySpork(const CSporkMessage &spork) override;
 
 private:
     CZMQNotificationInterface();
 
+    /** Queue a notification for the publishing thread */
+    void Enqueue(std::function<void ()> func);
+    /** Call func on every notifier, dropping the ones for which it fails. Publishing thread only. */
+    void ForEachNotifier(const std::function<bool (CZMQAbstractNotifier*)>& func);
+    void ThreadPublish();
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    // Sockets are only used from threadPublish, so a slow subscriber
+    // cannot hold up the validation interface queue
+    std::thread threadPublish;
+    std::mutex cs_queue;
+    std::condition_variable cond_queue;
+    std::deque<std::function<void ()>> queue;
+    bool fStopPublishing;
+    size_t nDropped;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -4,6 +4,9 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <masternode.h>
+#include <masternode-payments.h>
+#include <spork.h>
 #include <streams.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
@@ -13,11 +16,15 @@
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK = "hashblock";
+static const char *MSG_HASHBLOCKALGO = "hashblockalgo";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_RAWTXLOCK  = "rawtxlock";
+static const char *MSG_MASTERNODESTATE = "masternodestate";
+static const char *MSG_PAYMENTVOTE = "paymentvote";
+static const char *MSG_SPORKUPDATE = "spork";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -158,6 +165,18 @@ bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     return SendMessage(MSG_HASHBLOCK, data, 32);
 }
 
+bool CZMQPublishHashBlockAlgoNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    uint256 hash = pindex->GetBlockHash();
+    uint8_t nAlgo = pindex->GetAlgo();
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashblockalgo %s %s\n", hash.GetHex(), GetAlgoName(nAlgo));
+    char data[33];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = nAlgo;
+    return SendMessage(MSG_HASHBLOCKALGO, data, 33);
+}
+
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
@@ -218,3 +237,28 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << tx;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishMasternodeStateNotifier::NotifyMasternodeState(const COutPoint &outpoint, int nState)
+{
+    std::string strState = nState < 0 ? "REMOVED" : CMasternode::StateToString(nState);
+    LogPrint(BCLog::ZMQ, "zmq: Publish masternodestate %s %s\n", outpoint.ToStringShort(), strState);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << outpoint << strState;
+    return SendMessage(MSG_MASTERNODESTATE, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishPaymentVoteNotifier::NotifyPaymentVote(const CMasternodePaymentVote &vote)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish paymentvote %s\n", vote.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vote;
+    return SendMessage(MSG_PAYMENTVOTE, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishSporkNotifier::NotifySpork(const CSporkMessage &spork)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish spork %d %d\n", spork.nSporkID, spork.nValue);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << spork;
+    return SendMessage(MSG_SPORKUPDATE, &(*ss.begin()), ss.size());
+}
@@ -34,6 +34,12 @@ public:
     bool NotifyBlock(const CBlockIndex *pindex) override;
 };
 
+class CZMQPublishHashBlockAlgoNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+};
+
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
@@ -64,4 +70,22 @@ public:
     bool NotifyTransactionLock(const CTransactionRef &ptransaction) override;
 };
 
+class CZMQPublishMasternodeStateNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeState(const COutPoint &outpoint, int nState) override;
+};
+
+class CZMQPublishPaymentVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPaymentVote(const CMasternodePaymentVote &vote) override;
+};
+
+class CZMQPublishSporkNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySpork(const CSporkMessage &spork) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
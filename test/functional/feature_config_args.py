@@ -5,9 +5,10 @@
 """Test various command line arguments and configuration file parameters."""
 
 import os
+import sys
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import get_datadir_path
+from test_framework.util import assert_equal, get_datadir_path
 
 class ConfArgsTest(BitcoinTestFramework):
     def set_test_params(self):
@@ -16,6 +17,17 @@ class ConfArgsTest(BitcoinTestFramework):
 
     def run_test(self):
         self.stop_node(0)
+
+        # Check that an unknown -socketevents mode is rejected
+        self.assert_start_raises_init_error(0, ['-socketevents=invalid'], "Invalid -socketevents ('invalid') specified.")
+
+        # Both socket event backends must be able to serve RPC and shut down cleanly
+        for mode in ['select', 'epoll']:
+            if sys.platform.startswith('linux') or mode == 'select':
+                self.start_node(0, ['-socketevents=' + mode])
+                assert_equal(self.nodes[0].getconnectioncount(), 0)
+                self.stop_node(0)
+
         # Remove the -datadir argument so it doesn't override the config file
         self.nodes[0].args = [arg for arg in self.nodes[0].args if not arg.startswith("-datadir")]
 
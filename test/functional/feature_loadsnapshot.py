@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Globaltoken Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test starting a node from a UTXO snapshot with -loadsnapshot.
+
+- Mine a chain on node0, dump its UTXO set and mine a few more blocks.
+- Restart node1 with a -snapshotcommitment for the dump and -loadsnapshot.
+  Once it has node0's headers it loads the snapshot: the base block becomes
+  its tip with the committed nChainTx, and the blocks after it are synced.
+- Restart node1 again. The block index still marks the snapshot base, so
+  nChainTx and the UTXO set are unchanged, NODE_NETWORK stays off and new
+  blocks are still connected.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, sync_blocks
+
+NODE_NETWORK = 1
+
+class LoadSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        # Node1 is only connected once it can load the snapshot
+        self.setup_nodes()
+
+    def check_snapshot_base(self, dump):
+        node = self.nodes[1]
+        assert_equal(node.getchaintxstats(0, dump['base_hash'])['txcount'], dump['nchaintx'])
+        assert_equal(int(node.getnetworkinfo()['localservices'], 16) & NODE_NETWORK, 0)
+        assert_equal(node.gettxoutsetinfo()['hash_serialized_2'], self.nodes[0].gettxoutsetinfo()['hash_serialized_2'])
+
+    def run_test(self):
+        self.log.info("Mine a chain on node0 and dump its UTXO set")
+        self.nodes[0].generate(150)
+        dump = self.nodes[0].dumptxoutset('utxo.dat')
+        assert_equal(dump['base_height'], 150)
+        assert_equal(dump['hash_serialized_2'], self.nodes[0].gettxoutsetinfo()['hash_serialized_2'])
+        assert_equal(dump['nchaintx'], self.nodes[0].getchaintxstats(0)['txcount'])
+        self.nodes[0].generate(10)
+
+        commitment = "-snapshotcommitment=%d:%s:%s:%d" % (dump['base_height'], dump['base_hash'], dump['hash_serialized_2'], dump['nchaintx'])
+
+        self.log.info("Start node1 from the snapshot")
+        self.restart_node(1, [commitment, "-loadsnapshot=%s" % dump['path']])
+        connect_nodes_bi(self.nodes, 0, 1)
+        sync_blocks(self.nodes)
+        assert_equal(self.nodes[1].getblockcount(), 160)
+        self.check_snapshot_base(dump)
+
+        self.log.info("Restart node1, the snapshot base is loaded from the block index")
+        self.restart_node(1, [commitment])
+        assert_equal(self.nodes[1].getblockcount(), 160)
+        self.check_snapshot_base(dump)
+
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.nodes[0].generate(5)
+        sync_blocks(self.nodes)
+        assert_equal(self.nodes[1].getblockcount(), 165)
+        self.check_snapshot_base(dump)
+
+if __name__ == '__main__':
+    LoadSnapshotTest().main()